@@ -0,0 +1,210 @@
+// non-blocking TCP sockets for coroutines of the CoroScheduler (Linux)
+//  - co_await sock.accept() / sock.recv(buf) / sock.send(buf)
+//    first try the non-blocking system call and only suspend
+//    on EAGAIN until the epoll reactor reports readiness
+//  - the socket is registered once with the (edge-triggered) reactor
+//    of the scheduler (see epollreactor.hpp)
+//  - errors are thrown as std::system_error
+
+#ifndef INCLUDED_ASYNC_SOCKET_HPP
+#define INCLUDED_ASYNC_SOCKET_HPP
+
+#include "epollreactor.hpp"
+#include "corotask.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <memory>
+#include <span>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <system_error>
+
+class AsyncSocket {
+ private:
+  EpollReactor* reactor_ = nullptr;
+  int fd_ = -1;
+  std::unique_ptr<EpollReactor::IoState> state_;
+
+  [[noreturn]] static void throwErrno(int err, const char* what) {
+    throw std::system_error{err, std::generic_category(), what};
+  }
+
+  static sockaddr_in makeAddress(const char* ip, std::uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
+      throwErrno(EINVAL, "inet_pton()");
+    }
+    return addr;
+  }
+
+  static int newSocket() {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      throwErrno(errno, "socket()");
+    }
+    return fd;
+  }
+
+ public:
+  AsyncSocket() noexcept = default;
+
+  // take over the non-blocking socket fd and register it with the reactor
+  AsyncSocket(EpollReactor& reactor, int fd)
+   : reactor_{&reactor}, fd_{fd} {
+    try {
+      state_ = reactor.add(fd);
+    }
+    catch (...) {
+      ::close(fd);
+      throw;
+    }
+  }
+
+  AsyncSocket(AsyncSocket&& s) noexcept
+   : reactor_{s.reactor_}, fd_{std::exchange(s.fd_, -1)}, state_{std::move(s.state_)} {
+  }
+  AsyncSocket& operator=(AsyncSocket&& s) noexcept {
+    if (this != &s) {
+      close();
+      reactor_ = s.reactor_;
+      fd_ = std::exchange(s.fd_, -1);
+      state_ = std::move(s.state_);
+    }
+    return *this;
+  }
+
+  ~AsyncSocket() {
+    close();
+  }
+
+  // no coroutine may wait for the socket when it is closed
+  void close() noexcept {
+    if (fd_ >= 0) {
+      reactor_->remove(std::move(state_));
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  bool isOpen() const noexcept {
+    return fd_ >= 0;
+  }
+  int fd() const noexcept {
+    return fd_;
+  }
+
+  std::uint16_t localPort() const {
+    sockaddr_in addr{};
+    socklen_t len = sizeof(addr);
+    if (::getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &len) < 0) {
+      throwErrno(errno, "getsockname()");
+    }
+    return ntohs(addr.sin_port);
+  }
+
+  // listening socket (port 0: any free port, see localPort())
+  static AsyncSocket listen(EpollReactor& reactor, const char* ip, std::uint16_t port,
+                            int backlog = SOMAXCONN) {
+    AsyncSocket sock{reactor, newSocket()};
+    int one = 1;
+    ::setsockopt(sock.fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = makeAddress(ip, port);
+    if (::bind(sock.fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+      throwErrno(errno, "bind()");
+    }
+    if (::listen(sock.fd_, backlog) < 0) {
+      throwErrno(errno, "listen()");
+    }
+    return sock;
+  }
+
+  static CoroTask<AsyncSocket> connect(EpollReactor& reactor, const char* ip, std::uint16_t port) {
+    AsyncSocket sock{reactor, newSocket()};
+    sockaddr_in addr = makeAddress(ip, port);
+    if (::connect(sock.fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+      if (errno != EINPROGRESS) {
+        throwErrno(errno, "connect()");
+      }
+      // connected (or failed) when writable
+      // (readiness might also be reported before the connection is established):
+      while (true) {
+        co_await EpollReactor::writable(*sock.state_);
+        int err = 0;
+        socklen_t len = sizeof(err);
+        ::getsockopt(sock.fd_, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+          throwErrno(err, "connect()");
+        }
+        sockaddr_in peer{};
+        socklen_t peerLen = sizeof(peer);
+        if (::getpeername(sock.fd_, reinterpret_cast<sockaddr*>(&peer), &peerLen) == 0) {
+          break;
+        }
+      }
+    }
+    int one = 1;
+    ::setsockopt(sock.fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    co_return sock;
+  }
+
+  CoroTask<AsyncSocket> accept() {
+    while (true) {
+      int fd = ::accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd >= 0) {
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        co_return AsyncSocket{*reactor_, fd};
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        throwErrno(errno, "accept()");
+      }
+      co_await EpollReactor::readable(*state_);
+    }
+  }
+
+  // returns the number of bytes received (0 at the end of the stream)
+  CoroTask<std::size_t> recv(std::span<std::byte> buf) {
+    while (true) {
+      ssize_t n = ::recv(fd_, buf.data(), buf.size(), 0);
+      if (n >= 0) {
+        co_return static_cast<std::size_t>(n);
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        throwErrno(errno, "recv()");
+      }
+      co_await EpollReactor::readable(*state_);
+    }
+  }
+
+  // returns the number of bytes sent (may be less than buf.size())
+  CoroTask<std::size_t> send(std::span<const std::byte> buf) {
+    while (true) {
+      ssize_t n = ::send(fd_, buf.data(), buf.size(), MSG_NOSIGNAL);
+      if (n >= 0) {
+        co_return static_cast<std::size_t>(n);
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        throwErrno(errno, "send()");
+      }
+      co_await EpollReactor::writable(*state_);
+    }
+  }
+
+  // send all of buf
+  CoroTask<> sendAll(std::span<const std::byte> buf) {
+    while (!buf.empty()) {
+      std::size_t n = co_await send(buf);
+      buf = buf.subspan(n);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,139 @@
+// Chase-Lev work-stealing deque
+//  - the owning worker pushes and pops at the bottom (LIFO)
+//  - all other workers steal from the top (FIFO)
+// based on:
+//  Le, Pop, Cohen, Zappa Nardelli:
+//  Correct and Efficient Work-Stealing for Weak Memory Models (PPoPP 2013)
+
+#ifndef INCLUDED_CHASE_LEV_DEQUE_HPP
+#define INCLUDED_CHASE_LEV_DEQUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <type_traits>
+
+// T must be a pointer type; pop() and steal() return nullptr if there is nothing to take
+template <typename T>
+class ChaseLevDeque {
+  static_assert(std::is_pointer_v<T>, "ChaseLevDeque<> only holds pointers");
+ private:
+  struct Array {
+    std::int64_t mask;
+    std::unique_ptr<std::atomic<T>[]> slots;
+
+    explicit Array(std::int64_t capacity)
+     : mask{capacity - 1}, slots{new std::atomic<T>[static_cast<std::size_t>(capacity)]} {
+    }
+    std::int64_t capacity() const noexcept {
+      return mask + 1;
+    }
+    T get(std::int64_t i) const noexcept {
+      return slots[static_cast<std::size_t>(i & mask)].load(std::memory_order_relaxed);
+    }
+    void put(std::int64_t i, T x) noexcept {
+      slots[static_cast<std::size_t>(i & mask)].store(x, std::memory_order_relaxed);
+    }
+  };
+
+  alignas(64) std::atomic<std::int64_t> top_{0};
+  alignas(64) std::atomic<std::int64_t> bottom_{0};
+  std::atomic<Array*> array_;
+  // Thieves might still read from an array the owner has outgrown,
+  // so old arrays are only released with the deque itself.
+  std::vector<std::unique_ptr<Array>> arrays_;
+
+  Array* grow(Array* a, std::int64_t b, std::int64_t t) {
+    auto bigger = std::make_unique<Array>(a->capacity() * 2);
+    for (std::int64_t i = t; i < b; ++i) {
+      bigger->put(i, a->get(i));
+    }
+    Array* result = bigger.get();
+    arrays_.push_back(std::move(bigger));
+    array_.store(result, std::memory_order_release);
+    return result;
+  }
+
+ public:
+  explicit ChaseLevDeque(std::int64_t capacity = 256) {
+    arrays_.push_back(std::make_unique<Array>(capacity));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+  }
+
+  ChaseLevDeque(const ChaseLevDeque&) = delete;
+  ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+  // owner only:
+  void push(T x) {
+    std::int64_t b = bottom_.load(std::memory_order_relaxed);
+    std::int64_t t = top_.load(std::memory_order_acquire);
+    Array* a = array_.load(std::memory_order_relaxed);
+    if (b - t > a->capacity() - 1) {
+      a = grow(a, b, t);
+    }
+    a->put(b, x);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  // owner only:
+  T pop() noexcept {
+    std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      // deque was empty
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    T x = a->get(b);
+    if (t == b) {
+      // last element: race against thieves
+      if (!top_.compare_exchange_strong(t, t + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        x = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return x;
+  }
+
+  // any thread:
+  T steal() noexcept {
+    std::int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return nullptr;
+    }
+    Array* a = array_.load(std::memory_order_acquire);
+    T x = a->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1,
+                                      std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;  // lost the race against the owner or another thief
+    }
+    return x;
+  }
+
+  // any thread (only a hint while others push or pop):
+  bool empty() const noexcept {
+    std::int64_t b = bottom_.load(std::memory_order_acquire);
+    std::int64_t t = top_.load(std::memory_order_acquire);
+    return t >= b;
+  }
+
+  // any thread (only a hint while others push or pop):
+  std::size_t size() const noexcept {
+    std::int64_t b = bottom_.load(std::memory_order_acquire);
+    std::int64_t t = top_.load(std::memory_order_acquire);
+    return b > t ? static_cast<std::size_t>(b - t) : 0;
+  }
+};
+
+#endif
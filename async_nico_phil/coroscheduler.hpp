@@ -0,0 +1,744 @@
+// work-stealing scheduler for the async coro example
+//  - co_await sched.schedule() suspends the coroutine and
+//    resumes it on one of the worker threads of the pool
+//  - each worker owns a Chase-Lev deque:
+//    coroutines scheduled from a worker are pushed onto its own deque,
+//    idle workers steal from the other deques
+//  - with a CpuTopology (see cputopology.hpp), each worker is pinned
+//    to a CPU of a NUMA node and carves its coroutine frames
+//    from memory of that node (see FramePool::bindToNode());
+//    workers steal from (and wake up) workers of their own node first,
+//    so that frames tend to be resumed on the node they live on
+//  - coroutines scheduled from other threads go to a shared lock-free
+//    injection queue (see mpscqueue.hpp); schedule() needs no allocation
+//    for it (the queue node is part of the awaiter);
+//    one worker at a time takes a batch of them to its deque
+//  - defer() lets a worker run work (e.g. submitting queued I/O requests)
+//    once its own deque ran empty, so that it is done once for a batch
+//  - idle workers park on their own eventfd (elsewhere: condition variable),
+//    which is only signalled if the worker is actually parked
+//  - on Linux, an epoll reactor (see epollreactor.hpp) lets coroutines wait
+//    for I/O: it is polled between resuming coroutines and, blocking,
+//    by one idle worker (the other idle workers park);
+//    elsewhere, the reactor only serves timers (see timerreactor.hpp)
+//  - co_await sched.schedule_after(duration) / schedule_at(timePoint)
+//    resumes the coroutine on a worker once the deadline passed
+//    without holding a thread meanwhile: the awaiter is queued in the
+//    4-ary timer heap of the reactor, whose single timerfd is armed for the
+//    earliest deadline (see timerqueue.hpp); so the blocking poller sleeps
+//    until the next timer expires or the next coroutine is posted
+//    (a deadline that passed already behaves like schedule());
+//    cancelling the coroutine dequeues the timer and resumes it at once
+//    with operation_cancelled
+//  - schedule() of a cancelled coroutine (see cancellation.hpp) throws
+//    operation_cancelled: it isn't queued if cancellation was requested before;
+//    otherwise it throws when it is resumed (which happens soon anyway;
+//    entries of the Chase-Lev deques can't be removed)
+//  - the instrumentation policy (see instrumentation.hpp) is notified
+//    when coroutines are scheduled, resumed, or stolen and when workers park
+//  - the metrics policy (see schedmetrics.hpp) records per worker
+//    the resumes and the tasks completed (if they count themselves,
+//    see TaskCountingInstrumentation) and, for a sample of them,
+//    the time from schedule() to resume, the time of the resume slice
+//    (also per frame name if the instrumentation names frames, for slices
+//     that resume a coroutine from schedule() or a timer),
+//    and the queue depth;
+//    metrics() merges them while the workers keep running
+//    (NoSchedMetrics, the default, records nothing)
+
+#ifndef INCLUDED_CORO_SCHEDULER_HPP
+#define INCLUDED_CORO_SCHEDULER_HPP
+
+#include "chaselevdeque.hpp"
+#include "instrumentation.hpp"
+#ifdef __linux__
+#include "epollreactor.hpp"
+#else
+#include "timerreactor.hpp"
+#endif
+#include "mpscqueue.hpp"
+#include "cputopology.hpp"
+#include "../framepool/framepool.hpp"
+#include "../awaiter_lewis/cancellation.hpp"
+#include "../metrics/schedmetrics.hpp"
+#include <coroutine>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <ranges>
+#include <utility>
+#include <chrono>
+#include <system_error>
+#include <cerrno>
+#include <cstdint>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+
+
+template <typename Instr = NoInstrumentation, typename Metrics = NoSchedMetrics>
+class CoroScheduler {
+ private:
+  // coroutine posted by a thread that is not a worker
+  // (part of the ScheduleAwaiter, allocated by post() and postAll())
+  struct InjectNode : MpscNode {
+    std::coroutine_handle<> hdl;
+    bool allocated = false;
+  };
+
+ public:
+  // work deferred by a worker (see defer())
+  struct DeferredWork {
+    void (*run)(DeferredWork&) noexcept = nullptr;
+    DeferredWork* next = nullptr;
+  };
+
+  struct ScheduleAwaiter {
+    CoroScheduler& sched;
+
+    const cancellation_token* token = nullptr;   // of the awaiting coroutine
+    InjectNode node{};                           // if not awaited on a worker
+    [[no_unique_address]] typename Metrics::Stamp scheduledAt{};   // if sampled
+    const typename Instr::FrameData* frameData = nullptr;         // names the run slice
+
+    bool await_ready() noexcept { return false; }
+
+    template <typename Promise>
+    bool await_suspend(std::coroutine_handle<Promise> cHdl) {
+      token = cancellation_token_of(cHdl);
+      if (token != nullptr && token->is_cancellation_requested()) {
+        return false;   // don't queue a cancelled coroutine
+      }
+      Instr::onEvent(CoroEvent::schedule, frameDataOf<Instr>(cHdl), cHdl.address());
+      if constexpr (Metrics::enabled) {
+        frameData = frameDataOf<Instr>(cHdl);
+        // (always timed if not scheduled by a worker)
+        Worker* self = currentWorker_;
+        if (self == nullptr || self->owner != &sched || self->metrics->sampleWait()) {
+          scheduledAt = Metrics::now();
+        }
+      }
+      sched.post(cHdl, &node);
+      return true;
+    }
+
+    void await_resume() const {
+      if (token != nullptr && token->is_cancellation_requested()) {
+        throw operation_cancelled{};
+      }
+      if constexpr (Metrics::enabled) {
+        Worker* self = currentWorker_;
+        if (scheduledAt != typename Metrics::Stamp{} && self != nullptr && self->owner == &sched) {
+          self->metrics->recordWait(scheduledAt, self->resumedAt != typename Metrics::Stamp{}
+                                                   ? self->resumedAt : Metrics::now());
+        }
+        sched.nameSlice(frameData);
+      }
+    }
+  };
+
+  // awaiter of schedule_at() and schedule_after()
+  struct TimerAwaiter : TimerQueueNode {
+    CoroScheduler& sched;
+
+    const cancellation_token* token = nullptr;   // of the awaiting coroutine
+    std::optional<cancellation_registration> registration;
+    std::atomic<bool> cancelRequested{false};
+    InjectNode node{};                           // if posted instead of queued
+    const typename Instr::FrameData* frameData = nullptr;   // names the run slice
+
+    TimerAwaiter(CoroScheduler& s, Clock::time_point tp) noexcept
+     : sched{s} {
+      deadline = tp;
+    }
+
+    bool await_ready() noexcept { return false; }
+
+    template <typename Promise>
+    bool await_suspend(std::coroutine_handle<Promise> cHdl) {
+      token = cancellation_token_of(cHdl);
+      if (token != nullptr && token->is_cancellation_requested()) {
+        return false;   // don't queue a cancelled coroutine
+      }
+      Instr::onEvent(CoroEvent::schedule, frameDataOf<Instr>(cHdl), cHdl.address());
+      if constexpr (Metrics::enabled) {
+        frameData = frameDataOf<Instr>(cHdl);
+      }
+      if (deadline <= Clock::now()) {
+        sched.post(cHdl, &node);
+        return true;
+      }
+      hdl = cHdl;
+      if (token != nullptr) {
+        // (before queueing: if this throws, nothing is queued)
+        registration.emplace(*token, [this] { onCancel(); });
+      }
+      TimerQueue& timers = sched.reactor_.timers();
+      timers.add(*this);
+      // from now on, the timer might expire or be cancelled (and released)
+      if (cancelRequested.load() && timers.remove(*this)) {
+        return false;   // onCancel() ran before we were queued
+      }
+      // suspend unless the other release was first:
+      return !release();
+    }
+
+    void await_resume() {
+      registration.reset();   // (waits if onCancel() is just running)
+      if constexpr (Metrics::enabled) {
+        sched.nameSlice(frameData);
+      }
+      if (token != nullptr && token->is_cancellation_requested()) {
+        throw operation_cancelled{};
+      }
+    }
+
+   private:
+    void onCancel() noexcept {
+      cancelRequested.store(true);
+      if (sched.reactor_.timers().remove(*this) && release()) {
+        sched.post(hdl, &node);
+      }
+    }
+  };
+
+ private:
+  struct Worker {
+    CoroScheduler* owner;
+    unsigned index;
+    ChaseLevDeque<void*> deque;
+    unsigned sinceIoPoll = 0;   // resumed coroutines since the last I/O poll
+    DeferredWork* deferred = nullptr;   // see defer()
+    unsigned sinceDeferred = 0;         // resumed coroutines while work is deferred
+#ifdef __linux__
+    int wakeFd;                 // eventfd the worker blocks on while parked
+#else
+    std::mutex wakeMx;          // the worker waits on wakeCv for signalled while parked
+    std::condition_variable wakeCv;
+    bool signalled = false;
+#endif
+    std::atomic<bool> parked{false};
+    unsigned node = 0;                  // NUMA node (index in the CpuTopology)
+    int nodeId = -1;                    // its kernel id (-1: none, see FramePool::bindToNode())
+    int cpu = -1;                       // CPU to pin the thread to (-1: none)
+    std::atomic<bool> pinned{false};
+    std::vector<Worker*> victims;       // steal order: own node first
+    std::atomic<std::uint64_t> localSteals{0};    // from workers of the own node
+    std::atomic<std::uint64_t> remoteSteals{0};   // from workers of other nodes
+    typename Metrics::ThreadMetrics* metrics;
+    [[no_unique_address]] typename Metrics::Stamp resumedAt{};   // of the current slice if sampled
+    std::string sliceName;              // of the frame resumed by it (see nameSlice())
+    std::jthread thread;
+
+    Worker(CoroScheduler* o, unsigned idx)
+     : owner{o}, index{idx}, metrics{&o->metrics_.addThread()} {
+#ifdef __linux__
+      wakeFd = ::eventfd(0, EFD_CLOEXEC);
+      if (wakeFd < 0) {
+        throw std::system_error{errno, std::generic_category(), "eventfd()"};
+      }
+#endif
+    }
+#ifdef __linux__
+    ~Worker() {
+      ::close(wakeFd);
+    }
+#endif
+  };
+
+  Metrics metrics_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  // coroutines posted from threads that are not workers of this scheduler:
+  MpscQueue<InjectNode> injected_;
+  std::atomic<std::size_t> numInjected_{0};   // counted before they are pushed
+  static constexpr std::size_t maxInjectedShare = 64;
+
+  // parking of idle workers:
+  std::atomic<unsigned> numSleeping_{0};
+  std::atomic<std::uint64_t> epoch_{0};   // incremented for each posted coroutine
+  std::atomic<bool> stopping_{false};
+
+  // I/O readiness and timers:
+#ifdef __linux__
+  using Reactor = EpollReactor;
+#else
+  using Reactor = TimerReactor;
+#endif
+  Reactor reactor_;
+  std::atomic<bool> pollerActive_{false};    // a worker polls the reactor
+  std::atomic<bool> pollerBlocked_{false};   // it may block in epoll_wait()
+  static constexpr unsigned ioPollInterval = 61;
+  static constexpr unsigned deferInterval = 16;
+
+  static inline thread_local Worker* currentWorker_ = nullptr;
+
+ public:
+  struct WorkerInfo {
+    unsigned node;
+    int cpu;           // -1: not pinned to a CPU
+    bool pinned;       // pinning succeeded
+    std::uint64_t localSteals;
+    std::uint64_t remoteSteals;
+  };
+
+  explicit CoroScheduler(unsigned numWorkers = std::thread::hardware_concurrency()) {
+    start(numWorkers, nullptr);
+  }
+
+  // workers pinned to the CPUs of topology (numWorkers 0: one per CPU)
+  explicit CoroScheduler(const CpuTopology& topology, unsigned numWorkers = 0) {
+    start(numWorkers == 0 ? topology.numCpus() : numWorkers, &topology);
+  }
+
+  CoroScheduler(const CoroScheduler&) = delete;
+  CoroScheduler& operator=(const CoroScheduler&) = delete;
+
+  // coroutines still queued at this point (or waiting for a timer)
+  // are never resumed
+  ~CoroScheduler() {
+    stopping_.store(true);
+    for (auto& w : workers_) {
+      signal(*w);
+    }
+    reactor_.interrupt();
+    for (auto& w : workers_) {
+      w->thread.join();
+    }
+    while (InjectNode* node = injected_.pop()) {
+      if (node->allocated) {
+        delete node;
+      }
+    }
+  }
+
+  ScheduleAwaiter schedule() noexcept {
+    return ScheduleAwaiter{*this};
+  }
+
+  // resume the coroutine on one of the workers once tp has passed
+  TimerAwaiter schedule_at(TimerQueueNode::Clock::time_point tp) noexcept {
+    return TimerAwaiter{*this, tp};
+  }
+
+  // resume the coroutine on one of the workers after (at least) duration
+  template <typename Rep, typename Period>
+  TimerAwaiter schedule_after(std::chrono::duration<Rep, Period> duration) noexcept {
+    auto now = TimerQueueNode::Clock::now();
+    return TimerAwaiter{*this, now + std::chrono::ceil<TimerQueueNode::Clock::duration>(duration)};
+  }
+
+  // resume hdl on one of the workers
+  // (node: for the injection queue if called by another thread,
+  //  nullptr to allocate one)
+  void post(std::coroutine_handle<> hdl, InjectNode* node = nullptr) {
+    Worker* self = currentWorker_;
+    if (self != nullptr && self->owner == this) {
+      self->deque.push(hdl.address());
+    }
+    else {
+      if (node == nullptr) {
+        node = new InjectNode;
+        node->allocated = true;
+      }
+      node->hdl = hdl;
+      numInjected_.fetch_add(1);
+      injected_.push(*node);
+    }
+    wakeOne();
+  }
+
+  // resume all handles of the range (e.g. the waiters of an event)
+  // on the workers with one push and one round of wake-ups
+  // - the range may not access a handle after it was handed out
+  //   (the coroutine might already be running)
+  // - never throws, so that no handle gets lost: handles it can't post
+  //   (no memory for a node or a bigger deque) are resumed in the calling thread
+  template <typename Range>
+  void postAll(Range&& hdls) noexcept {
+    std::size_t num = 0;
+    auto pos = std::ranges::begin(hdls);
+    auto end = std::ranges::end(hdls);
+    Worker* self = currentWorker_;
+    if (self != nullptr && self->owner == this) {
+      try {
+        for (; pos != end; ++pos) {
+          self->deque.push((*pos).address());   // (throws before taking it)
+          ++num;
+        }
+      }
+      catch (...) {
+      }
+    }
+    else {
+      // link the nodes first, then append them at once:
+      InjectNode* first = nullptr;
+      InjectNode* last = nullptr;
+      try {
+        for (; pos != end; ++pos) {
+          auto* node = new InjectNode;
+          node->hdl = *pos;
+          node->allocated = true;
+          if (last != nullptr) {
+            last->next.store(node, std::memory_order_relaxed);
+          }
+          else {
+            first = node;
+          }
+          last = node;
+          ++num;
+        }
+      }
+      catch (...) {
+      }
+      if (num > 0) {
+        numInjected_.fetch_add(num);
+        injected_.pushChain(*first, *last);
+      }
+    }
+    if (num > 0) {
+      wakeSome(num);
+    }
+    // resume what couldn't be posted (the range never visits a posted handle again):
+    for (; pos != end; ++pos) {
+      std::coroutine_handle<> hdl = *pos;
+      hdl.resume();
+    }
+  }
+
+  // let the calling worker run work once its own deque ran empty
+  // (at the latest after deferInterval resumes), so that it can batch
+  // what the coroutines it resumes meanwhile request (e.g. see IoUringService)
+  // - other threads run it at once
+  // - the work must not be deferred again before it runs
+  void defer(DeferredWork& work) noexcept {
+    Worker* self = currentWorker_;
+    if (self == nullptr || self->owner != this) {
+      work.run(work);
+      return;
+    }
+    work.next = self->deferred;
+    self->deferred = &work;
+  }
+
+  // run the work the calling worker deferred so far (other threads: nothing to do)
+  void runDeferred() noexcept {
+    Worker* self = currentWorker_;
+    if (self != nullptr && self->owner == this) {
+      runDeferred(*self);
+    }
+  }
+
+#ifdef __linux__
+  // reactor for the file descriptors coroutines wait for (see asyncsocket.hpp)
+  EpollReactor& reactor() noexcept {
+    return reactor_;
+  }
+#endif
+
+  unsigned numWorkers() const noexcept {
+    return static_cast<unsigned>(workers_.size());
+  }
+
+  // placement and steals of each worker
+  std::vector<WorkerInfo> workerInfo() const {
+    std::vector<WorkerInfo> infos;
+    for (const auto& w : workers_) {
+      infos.push_back(WorkerInfo{w->node, w->cpu, w->pinned.load(),
+                                 w->localSteals.load(std::memory_order_relaxed),
+                                 w->remoteSteals.load(std::memory_order_relaxed)});
+    }
+    return infos;
+  }
+
+  // metrics of all workers so far (see schedmetrics.hpp)
+  SchedMetricsSnapshot metrics() const {
+    return metrics_.snapshot();
+  }
+
+ private:
+  void start(unsigned numWorkers, const CpuTopology* topology) {
+    if (numWorkers == 0) {
+      numWorkers = 1;
+    }
+    workers_.reserve(numWorkers);
+    for (unsigned i = 0; i < numWorkers; ++i) {
+      workers_.push_back(std::make_unique<Worker>(this, i));
+      if (topology != nullptr) {
+        auto [node, cpu, nodeId] = topology->placement(i);
+        workers_.back()->node = node;
+        workers_.back()->cpu = cpu;
+        workers_.back()->nodeId = nodeId;
+      }
+    }
+    // steal order: the workers of the own node, then the others,
+    // each starting with the next worker so that victims are spread
+    for (auto& w : workers_) {
+      for (bool sameNode : {true, false}) {
+        for (std::size_t i = 1; i < numWorkers; ++i) {
+          Worker* victim = workers_[(w->index + i) % numWorkers].get();
+          if ((victim->node == w->node) == sameNode) {
+            w->victims.push_back(victim);
+          }
+        }
+      }
+    }
+    // start the threads only after all deques exist (they steal from each other)
+    for (auto& w : workers_) {
+      w->thread = std::jthread{[this, w = w.get()] { run(*w); }};
+    }
+  }
+
+  // called by the coroutine a worker resumed (from its awaiter):
+  // name the run slice of the worker by the frame if the slice is sampled
+  // (a copy: the frame may be gone when the slice ends)
+  void nameSlice(const typename Instr::FrameData* data) {
+    Worker* self = currentWorker_;
+    if (self != nullptr && self->owner == this && self->resumedAt != typename Metrics::Stamp{}) {
+      self->sliceName = frameNameOf<Instr>(data);
+    }
+  }
+
+  static void bump(std::atomic<std::uint64_t>& counter) noexcept {
+    // single writer: no read-modify-write needed
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  void run(Worker& self) {
+    if (self.cpu >= 0) {
+      // before the first frame is allocated, so that they come from the node:
+      self.pinned.store(CpuTopology::pin(self.cpu));
+      FramePool::bindToNode(self.nodeId);
+    }
+    currentWorker_ = &self;
+    Metrics::bind(self.metrics);
+    while (!stopping_.load(std::memory_order_relaxed)) {
+      if (self.deferred != nullptr
+          && (self.deque.empty() || ++self.sinceDeferred >= deferInterval)) {
+        runDeferred(self);
+      }
+      // I/O and timers don't starve while there are always coroutines to resume:
+      if (++self.sinceIoPoll >= ioPollInterval) {
+        self.sinceIoPoll = 0;
+        if (reactor_.hasWaiters()) {
+          pollIo(false);
+        }
+      }
+      auto epoch = epoch_.load();
+      if (auto hdl = findWork(self)) {
+        Instr::onEvent(CoroEvent::resumeScheduled, nullptr, hdl.address());
+        self.metrics->countResume();
+        if (self.metrics->sampleRun()) {
+          self.metrics->recordQueueDepth(self.deque.size() + numInjected_.load(std::memory_order_relaxed));
+          self.resumedAt = Metrics::now();
+          hdl.resume();
+          self.metrics->recordRun(self.resumedAt, Metrics::now(), self.sliceName);
+          self.sliceName.clear();
+        }
+        else {
+          self.resumedAt = {};
+          hdl.resume();
+        }
+      }
+      else if (!pollIo(true, epoch)) {
+        park(self, epoch);
+      }
+    }
+    runDeferred(self);
+    Metrics::bind(nullptr);
+    currentWorker_ = nullptr;
+  }
+
+  static void runDeferred(Worker& self) noexcept {
+    self.sinceDeferred = 0;
+    DeferredWork* work = std::exchange(self.deferred, nullptr);
+    while (work != nullptr) {
+      DeferredWork* next = std::exchange(work->next, nullptr);   // (it may be deferred again)
+      work->run(*work);
+      work = next;
+    }
+  }
+
+  // handle of a node taken from the injection queue (which is freed if allocated)
+  static std::coroutine_handle<> take(InjectNode* node) noexcept {
+    std::coroutine_handle<> hdl = node->hdl;
+    if (node->allocated) {
+      delete node;
+    }
+    return hdl;
+  }
+
+  std::coroutine_handle<> findWork(Worker& self) {
+    if (void* p = self.deque.pop()) {
+      return std::coroutine_handle<>::from_address(p);
+    }
+    // one worker at a time takes injected coroutines (the others steal):
+    if (numInjected_.load() > 0 && injected_.tryLockConsumer()) {
+      std::coroutine_handle<> hdl;
+      if (InjectNode* node = injected_.pop()) {
+        hdl = take(node);
+        // take a share of a batch (see postAll()) to the own deque,
+        // so that the others can steal it:
+        std::size_t share = std::min(numInjected_.load() / workers_.size(), maxInjectedShare);
+        std::size_t taken = 1;
+        for (; taken <= share; ++taken) {
+          InjectNode* next = injected_.pop();
+          if (next == nullptr) {
+            break;
+          }
+          self.deque.push(take(next).address());
+        }
+        numInjected_.fetch_sub(taken);
+      }
+      injected_.unlockConsumer();
+      if (hdl) {
+        return hdl;
+      }
+    }
+    // steal, from workers of the own node first:
+    for (Worker* victim : self.victims) {
+      if (void* p = victim->deque.steal()) {
+        Instr::onEvent(CoroEvent::steal, nullptr, p);
+        bump(victim->node == self.node ? self.localSteals : self.remoteSteals);
+        return std::coroutine_handle<>::from_address(p);
+      }
+    }
+    return {};
+  }
+
+  bool hasWork() const noexcept {
+    if (numInjected_.load() > 0) {
+      return true;
+    }
+    for (auto& w : workers_) {
+      if (!w->deque.empty()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // poll the reactor unless another worker does
+  // - block: wait until I/O is ready or a coroutine is posted after epoch
+  // - returns false if another worker is polling
+  bool pollIo(bool block, std::uint64_t epoch = 0) {
+    bool expected = false;
+    if (!pollerActive_.compare_exchange_strong(expected, true)) {
+      return false;
+    }
+    if (block) {
+      pollerBlocked_.store(true);
+      // re-check after announcing that we may block, so that no post() is missed
+      // (a post() after this sees pollerBlocked_ and interrupts the poll):
+      block = epoch_.load() == epoch && !stopping_.load();
+      if (block) {
+        Instr::onEvent(CoroEvent::park, nullptr, nullptr);
+      }
+    }
+    reactor_.poll(block ? -1 : 0, [this](auto& hdls) {
+      postAll(hdls);   // to the own deque
+    });
+    pollerBlocked_.store(false);
+    pollerActive_.store(false);
+    return true;
+  }
+
+#ifdef __linux__
+  static void signal(Worker& w) noexcept {
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto ret = ::write(w.wakeFd, &one, sizeof(one));
+  }
+
+  static void waitSignal(Worker& w) noexcept {
+    std::uint64_t value;
+    while (::read(w.wakeFd, &value, sizeof(value)) < 0 && errno == EINTR) {
+    }
+  }
+#else
+  static void signal(Worker& w) noexcept {
+    {
+      std::lock_guard lock{w.wakeMx};
+      w.signalled = true;
+    }
+    w.wakeCv.notify_one();
+  }
+
+  static void waitSignal(Worker& w) noexcept {
+    std::unique_lock lock{w.wakeMx};
+    w.wakeCv.wait(lock, [&w] { return w.signalled; });
+    w.signalled = false;
+  }
+#endif
+
+  // block until a post() wakes us up (it claims us by resetting parked)
+  void park(Worker& self, std::uint64_t epoch) {
+    numSleeping_.fetch_add(1);
+    self.parked.store(true);
+    // re-check after announcing that we sleep, so that no post() is missed:
+    if (epoch_.load() == epoch && !hasWork() && !stopping_.load()) {
+      Instr::onEvent(CoroEvent::park, nullptr, nullptr);
+      waitSignal(self);
+    }
+    else if (!self.parked.exchange(false)) {
+      // a post() claimed us meanwhile: consume its signal
+      waitSignal(self);
+    }
+    numSleeping_.fetch_sub(1);
+  }
+
+  // signal up to num parked workers (returns how many)
+  // (if called by a worker: workers of its node first, they steal from it)
+  std::size_t wakeParked(std::size_t num) noexcept {
+    std::size_t woken = 0;
+    auto tryWake = [&woken](Worker& w) {
+      if (w.parked.load() && w.parked.exchange(false)) {
+        signal(w);
+        ++woken;
+      }
+    };
+    Worker* self = currentWorker_;
+    if (self != nullptr && self->owner == this) {
+      for (Worker* w : self->victims) {
+        tryWake(*w);
+        if (woken == num) {
+          break;
+        }
+      }
+    }
+    else {
+      for (auto& w : workers_) {
+        tryWake(*w);
+        if (woken == num) {
+          break;
+        }
+      }
+    }
+    return woken;
+  }
+
+  void wakeOne() {
+    wakeSome(1);
+  }
+
+  // wake up to num sleeping workers
+  // (or the worker blocked in the reactor if none is parked)
+  void wakeSome(std::size_t num) {
+    epoch_.fetch_add(1);
+    if (numSleeping_.load() > 0 && wakeParked(num) > 0) {
+      return;
+    }
+    if (pollerBlocked_.load()) {
+      reactor_.interrupt();
+    }
+  }
+};
+
+#endif
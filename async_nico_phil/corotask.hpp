@@ -0,0 +1,247 @@
+// CoroTask<T> for the async coro example
+//  - lazily started task that yields a value of type T (or void)
+//  - uses symmetric transfer, so that long chains of co_await
+//    don't grow the native stack:
+//     https://lewissbaker.github.io/2020/05/11/understanding_symmetric_transfer
+//  - exceptions are rethrown in the awaiting coroutine
+//  - the instrumentation policy (see instrumentation.hpp) decides
+//    whether frames carry a name and what happens on each event
+//  - instead of a continuation, a task may notify an observer when it is done
+//    (used by when_all()/when_any(), see whenall.hpp)
+//  - a task may carry a cancellation token (see cancellation.hpp),
+//    which is passed on to the tasks it awaits that have none of their own;
+//    awaiters that support cancellation (schedule(), events) get it
+//    from the promise of the awaiting coroutine
+//  - a coroutine called with (std::allocator_arg, FrameArena&, ...)
+//    gets its frame from that arena (see framearena.hpp);
+//    pass the arena on to the children to keep the whole tree in it
+//  - tasks completing on a worker of a scheduler with SchedMetrics
+//    are counted there if the instrumentation policy does so
+//    (see TaskCountingInstrumentation)
+
+#ifndef INCLUDED_CORO_TASK_HPP
+#define INCLUDED_CORO_TASK_HPP
+
+#include "instrumentation.hpp"
+#include "../framepool/framepool.hpp"
+#include "../framepool/framearena.hpp"
+#include "../awaiter_lewis/cancellation.hpp"
+#include <coroutine>
+#include <exception>   // for std::exception_ptr
+#include <utility>     // for std::exchange()
+#include <memory>      // for std::allocator_arg_t
+#include <optional>
+#include <string_view>
+
+// return_value()/return_void() part of the promise
+template <typename T>
+struct CoroTaskResult {
+  std::exception_ptr exception;
+  std::optional<T> value;
+
+  template <typename U = T>
+  void return_value(U&& v) {
+    value.emplace(std::forward<U>(v));
+  }
+  T result() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+    return std::move(*value);
+  }
+};
+
+template <>
+struct CoroTaskResult<void> {
+  std::exception_ptr exception;
+
+  void return_void() noexcept {
+  }
+  void result() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+};
+
+
+// gets notified (instead of resuming a continuation) when a task is done
+// - taskDone() is called at the final suspend point of the task
+//   and returns the coroutine to continue with (std::noop_coroutine() for none)
+class CoroTaskObserver {
+ public:
+  virtual std::coroutine_handle<> taskDone(void* taskAddress) noexcept = 0;
+ protected:
+  ~CoroTaskObserver() = default;
+};
+
+
+template <typename T = void, typename Instr = NoInstrumentation>
+class CoroTask {
+ public:
+  // initialize members for state and customization:
+  struct promise_type;
+  using CoroHdl = std::coroutine_handle<promise_type>;
+ private:
+  CoroHdl hdl;                       // native coroutine handle
+ public:
+  struct promise_type : CoroTaskResult<T> {
+    [[no_unique_address]] typename Instr::FrameData frameData;
+    cancellation_token cancelToken;   // default: can't be cancelled
+
+    // allocate the coroutine frames from the thread-local frame pool:
+    static void* operator new(std::size_t sz) {
+      return FramePool::allocate(sz);
+    }
+    // or from the arena passed as (std::allocator_arg, arena, ...)
+    // (also as first arguments after the object of a member function):
+    template <typename... Args>
+    static void* operator new(std::size_t sz, std::allocator_arg_t, FrameArena& arena, Args&...) {
+      return arena.allocate(sz);
+    }
+    template <typename Class, typename... Args>
+    static void* operator new(std::size_t sz, Class&, std::allocator_arg_t, FrameArena& arena,
+                              Args&...) {
+      return arena.allocate(sz);
+    }
+    // (frames of an arena are handed back to it)
+    static void operator delete(void* p) noexcept {
+      FramePool::deallocate(p);
+    }
+
+    auto get_return_object() noexcept {
+      auto h = CoroHdl::from_promise(*this);
+      Instr::onEvent(CoroEvent::create, nullptr, h.address());
+      return CoroTask{h};  // CoroTask{...} necessary here
+    }
+    auto initial_suspend() noexcept {
+      Instr::onEvent(CoroEvent::initialSuspend, &frameData,
+                     CoroHdl::from_promise(*this).address());
+      return std::suspend_always{};
+    }
+    // store the exception so that the awaiting coroutine gets it rethrown
+    void unhandled_exception() noexcept {
+      this->exception = std::current_exception();
+    }
+
+    // Finally, when the coroutine execution reaches the closing curly brace,
+    // we want the coroutine to suspend at the final-suspend point
+    // and then resume its continuation (i.e., the coroutine that is
+    // awaiting the completion of this coroutine).
+    // It's important to note that the coroutine is not yet in a suspended state
+    // when the final_suspend() method is invoked. We need to wait until
+    // the await_suspend() method on the returned awaitable is called
+    // before the coroutine is suspended.
+    // Calling continuation.resume() inside await_suspend() would nest
+    // the continuation on the native stack. Instead, await_suspend() returns
+    // the handle, so that the compiler jumps to it (symmetric transfer).
+    std::coroutine_handle<> continuation;
+    CoroTaskObserver* observer = nullptr;
+    struct FinalAwaiter {
+      bool await_ready() noexcept {
+        return false;
+      }
+      std::coroutine_handle<> await_suspend(CoroHdl h) noexcept {
+        Instr::onEvent(CoroEvent::finalSuspend, &h.promise().frameData, h.address());
+        // The coroutine is now suspended at the final-suspend point.
+        // Continue with its continuation (if there is none, return to the resumer).
+        if (auto* obs = h.promise().observer) {
+          return obs->taskDone(h.address());
+        }
+        if (auto cont = h.promise().continuation) {
+          return cont;
+        }
+        return std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+    auto final_suspend() noexcept {
+      return FinalAwaiter{};
+    }
+  };
+
+  CoroTask(CoroTask&& t) noexcept
+  : hdl(std::exchange(t.hdl, {}))
+  {}
+
+  ~CoroTask() {
+    if (hdl)
+      hdl.destroy();
+  }
+
+  // When evaluating a co_await expression,
+  // the compiler will generate a call to operator co_await().
+  // For co_await task
+  // we want the awaiting coroutine to always suspend
+  // and then, once it has suspended,
+  //  store the awaiting coroutine's handle in the promise
+  //  of the coroutine we are about to resume
+  // and then transfer to the task's std::coroutine_handle
+  //  to start executing the task.
+  class CoroTaskAwaiter {
+    friend CoroTask;
+   private:
+    CoroHdl waitingHdl;
+
+    explicit CoroTaskAwaiter(CoroHdl h) noexcept
+     : waitingHdl(h) {
+    }
+   public:
+    bool await_ready() noexcept {
+      return false;
+    }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> hdl) noexcept {
+      Instr::onEvent(CoroEvent::awaitSuspend, frameDataOf<Instr>(hdl), hdl.address());
+      // Store the continuation in the task's promise so that the final_suspend()
+      // knows to resume this coroutine when the task completes.
+      waitingHdl.promise().continuation = hdl;
+      // Pass on the cancellation token of the awaiting coroutine.
+      inheritCancellation(hdl);
+
+      // Then we transfer to the task's coroutine, which is currently suspended
+      // at the initial-suspend-point (ie. at the open curly brace).
+      Instr::onEvent(CoroEvent::resume, &waitingHdl.promise().frameData, waitingHdl.address());
+      return waitingHdl;
+    }
+
+    T await_resume() {
+      return waitingHdl.promise().result();
+    }
+
+    template <typename Promise>
+    void inheritCancellation(std::coroutine_handle<Promise> hdl) noexcept {
+      if (const cancellation_token* token = cancellation_token_of(hdl)) {
+        auto& own = waitingHdl.promise().cancelToken;
+        if (!own.can_be_cancelled()) {
+          own = *token;
+        }
+      }
+    }
+  };
+
+  auto operator co_await() && noexcept {
+    Instr::onEvent(CoroEvent::coAwait, &hdl.promise().frameData, hdl.address());
+    return CoroTaskAwaiter{hdl};
+  }
+
+  // cancel the task (and the tasks it awaits) with the source of the token
+  void setCancellationToken(cancellation_token token) noexcept {
+    hdl.promise().cancelToken = std::move(token);
+  }
+
+  void setName(std::string_view id) {
+    Instr::setName(hdl.promise().frameData, id);
+  }
+  auto getHandle() const {
+    return hdl;
+  }
+
+private:
+  explicit CoroTask(CoroHdl h) noexcept
+  : hdl{h}
+  {}
+};
+
+#endif
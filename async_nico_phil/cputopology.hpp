@@ -0,0 +1,199 @@
+// CPU topology for placing scheduler workers
+//  - NUMA nodes and their CPUs, restricted to the CPUs this process may run on
+//    (without Linux: one node with hardware_concurrency() CPUs)
+//  - detect(): from /sys/devices/system/node (one node if there is no such info);
+//    nodes without CPUs we may run on are skipped, so the nodes are numbered
+//    densely and nodeId() tells the id of the kernel (for mbind())
+//  - simulate(): any number of nodes with any number of CPUs each,
+//    mapped round-robin onto the CPUs we may run on
+//    (to try NUMA-aware placement on a single-socket machine)
+//  - placement(i): node (and its kernel id) and CPU of worker i
+//    (workers are spread over the nodes round-robin)
+//  - pin(cpu): bind the calling thread to a CPU (only on Linux)
+
+#ifndef INCLUDED_CPU_TOPOLOGY_HPP
+#define INCLUDED_CPU_TOPOLOGY_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <exception>
+#include <ostream>
+#include <cstddef>
+#ifdef __linux__
+#include <sched.h>
+#else
+#include <thread>
+#endif
+
+class CpuTopology {
+ public:
+  struct Placement {
+    unsigned node;
+    int cpu;
+    int nodeId;   // of the kernel (-1: none, simulated)
+  };
+
+ private:
+  std::vector<std::vector<int>> nodes_;   // CPUs of each node
+  std::vector<int> nodeIds_;              // kernel id of each node (-1: none)
+  bool simulated_ = false;
+
+  // CPUs this process may run on
+  static std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+      for (int c = 0; c < CPU_SETSIZE; ++c) {
+        if (CPU_ISSET(c, &set)) {
+          cpus.push_back(c);
+        }
+      }
+    }
+#else
+    for (unsigned c = 0; c < std::thread::hardware_concurrency(); ++c) {
+      cpus.push_back(static_cast<int>(c));
+    }
+#endif
+    if (cpus.empty()) {
+      cpus.push_back(0);
+    }
+    return cpus;
+  }
+
+  // parse a CPU list like "0-3,8-11"
+  static std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream strm{list};
+    std::string range;
+    while (std::getline(strm, range, ',')) {
+      auto dash = range.find('-');
+      try {
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int c = first; c <= last; ++c) {
+          cpus.push_back(c);
+        }
+      }
+      catch (const std::exception&) {
+        // (empty or malformed entry)
+      }
+    }
+    return cpus;
+  }
+
+  static bool contains(const std::vector<int>& cpus, int cpu) {
+    for (int c : cpus) {
+      if (c == cpu) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ public:
+  static CpuTopology detect() {
+    CpuTopology topo;
+    std::vector<int> allowed = allowedCpus();
+    for (int n = 0; ; ++n) {
+      std::ifstream file{"/sys/devices/system/node/node" + std::to_string(n) + "/cpulist"};
+      if (!file) {
+        break;
+      }
+      std::string list;
+      std::getline(file, list);
+      std::vector<int> cpus;
+      for (int c : parseCpuList(list)) {
+        if (contains(allowed, c)) {
+          cpus.push_back(c);
+        }
+      }
+      if (!cpus.empty()) {   // (nodes without usable CPUs don't get workers)
+        topo.nodes_.push_back(std::move(cpus));
+        topo.nodeIds_.push_back(n);
+      }
+    }
+    if (topo.nodes_.empty()) {
+      topo.nodes_.push_back(std::move(allowed));
+      topo.nodeIds_.push_back(-1);   // (no NUMA info: don't bind memory)
+    }
+    return topo;
+  }
+
+  static CpuTopology simulate(unsigned numNodes, unsigned cpusPerNode) {
+    CpuTopology topo;
+    topo.simulated_ = true;
+    std::vector<int> allowed = allowedCpus();
+    std::size_t next = 0;
+    topo.nodes_.resize(numNodes == 0 ? 1 : numNodes);
+    topo.nodeIds_.assign(topo.nodes_.size(), -1);
+    for (auto& cpus : topo.nodes_) {
+      for (unsigned i = 0; i < (cpusPerNode == 0 ? 1 : cpusPerNode); ++i) {
+        cpus.push_back(allowed[next++ % allowed.size()]);
+      }
+    }
+    return topo;
+  }
+
+  unsigned numNodes() const noexcept {
+    return static_cast<unsigned>(nodes_.size());
+  }
+  unsigned numCpus() const noexcept {
+    std::size_t num = 0;
+    for (const auto& cpus : nodes_) {
+      num += cpus.size();
+    }
+    return static_cast<unsigned>(num);
+  }
+  const std::vector<int>& cpusOf(unsigned node) const {
+    return nodes_[node];
+  }
+  // id of node for the kernel (-1: none, e.g. simulated)
+  int nodeId(unsigned node) const {
+    return nodeIds_[node];
+  }
+  bool simulated() const noexcept {
+    return simulated_;
+  }
+
+  // where worker i runs: the nodes take turns, and so do the CPUs of a node
+  Placement placement(unsigned worker) const {
+    unsigned node = worker % numNodes();
+    const auto& cpus = nodes_[node];
+    return Placement{node, cpus[(worker / numNodes()) % cpus.size()], nodeIds_[node]};
+  }
+
+  // bind the calling thread to cpu (false if that is not possible)
+  static bool pin([[maybe_unused]] int cpu) noexcept {
+#ifdef __linux__
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(static_cast<std::size_t>(cpu), &set);
+    return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+  }
+
+  void print(std::ostream& strm) const {
+    for (unsigned n = 0; n < numNodes(); ++n) {
+      strm << "node " << n << (simulated_ ? " (simulated)" : "");
+      if (nodeIds_[n] >= 0 && nodeIds_[n] != static_cast<int>(n)) {
+        strm << " (kernel node " << nodeIds_[n] << ')';
+      }
+      strm << ": CPUs";
+      for (int c : nodes_[n]) {
+        strm << ' ' << c;
+      }
+      strm << '\n';
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,116 @@
+// loopback echo benchmark for the epoll reactor of the CoroScheduler
+//  - an echo server coroutine per connection and a client coroutine
+//    per connection sending requests one after the other
+//  - all of them run on the workers of one scheduler
+//    (by default one worker serves all connections)
+// usage: echobench [numConnections [requestsPerConnection [msgSize [numWorkers]]]]
+
+#include "coroscheduler.hpp"
+#include "asyncsocket.hpp"
+#include "../bench/benchfixture.hpp"
+#include <iostream>
+#include <coroutine>
+#include <exception>
+#include <chrono>
+#include <latch>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include <sys/resource.h>
+
+using Clock = std::chrono::steady_clock;
+using Sched = CoroScheduler<>;
+
+DetachedTask session(AsyncSocket sock, std::size_t msgSize, std::latch& done)
+{
+  std::vector<std::byte> buf(msgSize);
+  while (true) {
+    std::size_t n = co_await sock.recv(buf);
+    if (n == 0) {
+      break;
+    }
+    co_await sock.sendAll(std::span{buf}.first(n));
+  }
+  sock.close();
+  done.count_down();
+}
+
+DetachedTask acceptor(Sched& sched, AsyncSocket& listener, unsigned numConnections,
+                      std::size_t msgSize, std::latch& done)
+{
+  co_await sched.schedule();
+  for (unsigned i = 0; i < numConnections; ++i) {
+    session(co_await listener.accept(), msgSize, done);
+  }
+}
+
+DetachedTask client(Sched& sched, std::uint16_t port, unsigned numRequests,
+                    std::size_t msgSize, std::vector<double>& latencyUs, std::latch& done)
+{
+  co_await sched.schedule();
+  AsyncSocket sock = co_await AsyncSocket::connect(sched.reactor(), "127.0.0.1", port);
+  std::vector<std::byte> request(msgSize, std::byte{'x'});
+  std::vector<std::byte> response(msgSize);
+  latencyUs.reserve(numRequests);
+  for (unsigned r = 0; r < numRequests; ++r) {
+    auto start = Clock::now();
+    co_await sock.sendAll(request);
+    std::size_t received = 0;
+    while (received < msgSize) {
+      std::size_t n = co_await sock.recv(std::span{response}.subspan(received));
+      if (n == 0) {
+        std::terminate();   // server closed the connection
+      }
+      received += n;
+    }
+    std::chrono::duration<double, std::micro> us = Clock::now() - start;
+    latencyUs.push_back(us.count());
+  }
+  sock.close();
+  done.count_down();
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned numConnections = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 1'000;
+  unsigned numRequests = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 100;
+  std::size_t msgSize = argc > 3 ? std::stoul(argv[3]) : 64;
+  unsigned numWorkers = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : 1;
+
+  // two sockets per connection on each side:
+  rlimit lim{};
+  ::getrlimit(RLIMIT_NOFILE, &lim);
+  lim.rlim_cur = lim.rlim_max;
+  ::setrlimit(RLIMIT_NOFILE, &lim);
+
+  std::vector<std::vector<double>> latencyUs(numConnections);
+  std::chrono::duration<double> secs{};
+  {
+    Sched sched{numWorkers};
+    AsyncSocket listener = AsyncSocket::listen(sched.reactor(), "127.0.0.1", 0);
+    std::latch serverDone{static_cast<std::ptrdiff_t>(numConnections)};
+    std::latch clientsDone{static_cast<std::ptrdiff_t>(numConnections)};
+
+    auto start = Clock::now();
+    acceptor(sched, listener, numConnections, msgSize, serverDone);
+    for (unsigned c = 0; c < numConnections; ++c) {
+      client(sched, listener.localPort(), numRequests, msgSize, latencyUs[c], clientsDone);
+    }
+    clientsDone.wait();
+    secs = Clock::now() - start;
+    serverDone.wait();
+  }
+
+  std::vector<double> all;
+  for (auto& l : latencyUs) {
+    all.insert(all.end(), l.begin(), l.end());
+  }
+  std::sort(all.begin(), all.end());
+  std::cout << numConnections << " connections, " << numRequests << " requests of "
+            << msgSize << " bytes each, " << numWorkers << " worker(s):\n"
+            << "  " << static_cast<std::uint64_t>(static_cast<double>(all.size()) / secs.count())
+            << " requests/s, latency p50 " << all[all.size() / 2]
+            << " us, p99 " << all[all.size() * 99 / 100]
+            << " us, max " << all.back() << " us\n";
+}
@@ -0,0 +1,253 @@
+// edge-triggered epoll reactor for the CoroScheduler (Linux)
+//  - each registered file descriptor has an IoState with one slot
+//    for a coroutine waiting until it is readable and one for writable
+//  - file descriptors are registered once (EPOLLET) for both directions,
+//    so waiting needs no epoll_ctl() calls
+//  - one coroutine at a time may wait per slot (see ReadinessAwaiter)
+//  - readiness reported while nobody waits is remembered in the slot,
+//    so that an edge between EAGAIN and suspending isn't lost
+//  - poll() is called by the scheduler: non-blocking between resuming
+//    coroutines and blocking by a worker that has nothing else to do;
+//    interrupt() wakes a blocked poll() up (eventfd)
+//  - timers() (see timerqueue.hpp): its timerfd is polled like a socket,
+//    poll() also passes the coroutines whose timers expired
+// see asyncsocket.hpp for the socket awaitables
+
+#ifndef INCLUDED_EPOLL_REACTOR_HPP
+#define INCLUDED_EPOLL_REACTOR_HPP
+
+#include "timerqueue.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <coroutine>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+class EpollReactor {
+ public:
+  // per file descriptor state (address is the epoll data)
+  struct IoState {
+    int fd = -1;
+    // nullptr: nobody waits, readyTag(): ready, otherwise: waiting coroutine
+    std::atomic<void*> reader{nullptr};
+    std::atomic<void*> writer{nullptr};
+  };
+
+  // awaiter that suspends until the slot becomes ready
+  // (resumes immediately if the slot is already marked ready)
+  // - one coroutine at a time per direction: a second one throws
+  //   std::logic_error (instead of replacing the one that waits)
+  struct ReadinessAwaiter {
+    std::atomic<void*>& slot;
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> hdl) {
+      void* old = slot.load(std::memory_order_acquire);
+      while (true) {
+        if (old == nullptr) {
+          if (slot.compare_exchange_weak(old, hdl.address(), std::memory_order_acq_rel)) {
+            return true;
+          }
+        }
+        else if (old == readyTag()) {
+          // readiness was reported in the meantime: consume it and retry
+          if (slot.compare_exchange_weak(old, nullptr, std::memory_order_acq_rel)) {
+            return false;
+          }
+        }
+        else {
+          throw std::logic_error{"EpollReactor: another coroutine already waits for this readiness"};
+        }
+      }
+    }
+
+    void await_resume() noexcept {}
+  };
+
+  static void* readyTag() noexcept {
+    static char tag;
+    return &tag;
+  }
+
+  // epoll data of the timerfd
+  static void* timerTag() noexcept {
+    static char tag;
+    return &tag;
+  }
+
+ private:
+  int epfd_ = -1;
+  int wakeFd_ = -1;
+  std::atomic<std::size_t> numRegistered_{0};
+  TimerQueue timers_;
+
+  // states of removed file descriptors, freed by the next poll()
+  // (the poll() running while they are removed might still report them)
+  std::mutex retiredMx_;
+  std::vector<std::unique_ptr<IoState>> retired_;
+
+  [[noreturn]] static void throwErrno(const char* what) {
+    throw std::system_error{errno, std::generic_category(), what};
+  }
+
+  // mark slot ready and return the waiting coroutine (if any)
+  static void* signal(std::atomic<void*>& slot) noexcept {
+    void* old = slot.load(std::memory_order_acquire);
+    while (true) {
+      if (old == nullptr || old == readyTag()) {
+        if (slot.compare_exchange_weak(old, readyTag(), std::memory_order_acq_rel)) {
+          return nullptr;
+        }
+      }
+      else if (slot.compare_exchange_weak(old, nullptr, std::memory_order_acq_rel)) {
+        return old;
+      }
+    }
+  }
+
+ public:
+  EpollReactor() {
+    epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0) {
+      throwErrno("epoll_create1()");
+    }
+    wakeFd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd_ < 0) {
+      ::close(epfd_);
+      throwErrno("eventfd()");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;    // the wake-up fd
+    epoll_event timerEv{};
+    timerEv.events = EPOLLIN;
+    timerEv.data.ptr = timerTag();
+    if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, wakeFd_, &ev) < 0
+        || ::epoll_ctl(epfd_, EPOLL_CTL_ADD, timers_.fd(), &timerEv) < 0) {
+      ::close(wakeFd_);
+      ::close(epfd_);
+      throwErrno("epoll_ctl()");
+    }
+  }
+
+  EpollReactor(const EpollReactor&) = delete;
+  EpollReactor& operator=(const EpollReactor&) = delete;
+
+  ~EpollReactor() {
+    ::close(wakeFd_);
+    ::close(epfd_);
+  }
+
+  // register a (non-blocking) file descriptor for both directions
+  std::unique_ptr<IoState> add(int fd) {
+    auto state = std::make_unique<IoState>();
+    state->fd = fd;
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = state.get();
+    if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      throwErrno("epoll_ctl(ADD)");
+    }
+    numRegistered_.fetch_add(1);
+    return state;
+  }
+
+  // deregister (before the file descriptor is closed)
+  void remove(std::unique_ptr<IoState> state) noexcept {
+    ::epoll_ctl(epfd_, EPOLL_CTL_DEL, state->fd, nullptr);
+    numRegistered_.fetch_sub(1);
+    std::lock_guard lock{retiredMx_};
+    retired_.push_back(std::move(state));
+  }
+
+  std::size_t numRegistered() const noexcept {
+    return numRegistered_.load(std::memory_order_relaxed);
+  }
+
+  // coroutines waiting for a deadline (see timerqueue.hpp)
+  TimerQueue& timers() noexcept {
+    return timers_;
+  }
+
+  // something to poll for: registered file descriptors or queued timers
+  bool hasWaiters() const noexcept {
+    return numRegistered() > 0 || timers_.size() > 0;
+  }
+
+  static ReadinessAwaiter readable(IoState& state) noexcept {
+    return ReadinessAwaiter{state.reader};
+  }
+  static ReadinessAwaiter writable(IoState& state) noexcept {
+    return ReadinessAwaiter{state.writer};
+  }
+
+  // wait up to timeoutMs (-1: forever) for readiness or the next timer
+  // and pass the handles of the coroutines that can continue
+  // to onReady(vector of handles)
+  // - only one thread may poll at a time
+  // - returns the number of coroutines passed
+  template <typename FN>
+  std::size_t poll(int timeoutMs, FN onReady) {
+    {
+      std::lock_guard lock{retiredMx_};
+      retired_.clear();
+    }
+    epoll_event events[256];
+    int num = ::epoll_wait(epfd_, events, 256, timeoutMs);
+    if (num < 0) {
+      if (errno == EINTR) {
+        return 0;
+      }
+      throwErrno("epoll_wait()");
+    }
+    static thread_local std::vector<std::coroutine_handle<>> ready;
+    ready.clear();
+    for (int i = 0; i < num; ++i) {
+      const epoll_event& ev = events[i];
+      if (ev.data.ptr == nullptr) {
+        std::uint64_t value;
+        while (::read(wakeFd_, &value, sizeof(value)) > 0) {
+        }
+        continue;
+      }
+      if (ev.data.ptr == timerTag()) {
+        timers_.expire([](std::coroutine_handle<> hdl) {
+          ready.push_back(hdl);
+        });
+        continue;
+      }
+      auto* state = static_cast<IoState*>(ev.data.ptr);
+      std::uint32_t errors = EPOLLERR | EPOLLHUP;
+      if (ev.events & (EPOLLIN | EPOLLRDHUP | errors)) {
+        if (void* p = signal(state->reader)) {
+          ready.push_back(std::coroutine_handle<>::from_address(p));
+        }
+      }
+      if (ev.events & (EPOLLOUT | errors)) {
+        if (void* p = signal(state->writer)) {
+          ready.push_back(std::coroutine_handle<>::from_address(p));
+        }
+      }
+    }
+    if (!ready.empty()) {
+      onReady(ready);
+    }
+    return ready.size();
+  }
+
+  // wake up a blocking poll()
+  void interrupt() noexcept {
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto ret = ::write(wakeFd_, &one, sizeof(one));
+  }
+};
+
+#endif
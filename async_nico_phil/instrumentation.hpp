@@ -0,0 +1,151 @@
+// instrumentation policies for CoroTask<> and CoroScheduler<>
+//  - a policy provides:
+//    - FrameData: stored in each coroutine frame (empty => no storage);
+//      if it has a name, the scheduler metrics record the run time
+//      of each name (see frameNameOf())
+//    - setName(FrameData&, name)
+//    - onEvent(event, FrameData* or nullptr, coroutine address)
+//  - NoInstrumentation:       compiles to nothing (default)
+//  - NarratingInstrumentation: names frames and prints each event
+//  - CountingInstrumentation:  counts the events (thread-safe)
+//  - TaskCountingInstrumentation<Metrics, Instr>: Instr, and tasks completing
+//    on a thread bound to scheduler metrics are counted there
+//    (Metrics::taskCompleted(), see schedmetrics.hpp)
+
+#ifndef INCLUDED_INSTRUMENTATION_HPP
+#define INCLUDED_INSTRUMENTATION_HPP
+
+#include <iostream>
+#include <syncstream>
+#include <coroutine>
+#include <concepts>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+inline auto coutSync() {
+  return std::osyncstream{std::cout};
+}
+
+enum class CoroEvent {
+  create,            // get_return_object() of a task
+  initialSuspend,    // task suspends at its initial suspend point
+  coAwait,           // task is co_await'ed
+  awaitSuspend,      // awaiting coroutine suspends
+  resume,            // transfer into the awaited task
+  finalSuspend,      // task reaches its final suspend point
+  schedule,          // coroutine is passed to the scheduler
+  resumeScheduled,   // scheduler resumes a coroutine
+  steal,             // worker stole a coroutine from another worker
+  park,              // idle worker goes to sleep
+  numEvents
+};
+
+inline const char* eventName(CoroEvent ev) noexcept
+{
+  switch (ev) {
+    case CoroEvent::create:          return "CoroTaskPromise: get_return_object()";
+    case CoroEvent::initialSuspend:  return "CoroTaskPromise: initial_suspend()";
+    case CoroEvent::coAwait:         return "CoroTask: op co_await()";
+    case CoroEvent::awaitSuspend:    return "   CoroTaskAwaiter(): await_suspend()";
+    case CoroEvent::resume:          return "   CoroTaskAwaiter(): resume";
+    case CoroEvent::finalSuspend:    return "CoroTaskPromise: final await_suspend()";
+    case CoroEvent::schedule:        return "ScheduleAwaiter: await_suspend()";
+    case CoroEvent::resumeScheduled: return "CoroScheduler: >>> resume()";
+    case CoroEvent::steal:           return "CoroScheduler: steal";
+    case CoroEvent::park:            return "CoroScheduler: park";
+    default:                         return "?";
+  }
+}
+
+// frame data of the promise behind h if it uses the instrumentation Instr
+template <typename Instr, typename Promise>
+const typename Instr::FrameData* frameDataOf(std::coroutine_handle<Promise> h) noexcept
+{
+  if constexpr (requires { { h.promise().frameData } -> std::same_as<typename Instr::FrameData&>; }) {
+    return &h.promise().frameData;
+  }
+  else {
+    return nullptr;
+  }
+}
+
+// name of the frame with data (empty if there is none or the policy doesn't name frames)
+template <typename Instr>
+std::string_view frameNameOf(const typename Instr::FrameData* data) noexcept
+{
+  if constexpr (requires { std::string_view{data->name}; }) {
+    return data != nullptr ? std::string_view{data->name} : std::string_view{};
+  }
+  else {
+    return {};
+  }
+}
+
+
+struct NoInstrumentation {
+  struct FrameData {};
+  static void setName(FrameData&, std::string_view) noexcept {
+  }
+  static void onEvent(CoroEvent, const FrameData*, void*) noexcept {
+  }
+};
+
+
+struct NarratingInstrumentation {
+  struct FrameData {
+    std::string name = "CoroTask::promise_type ?????";
+  };
+  static void setName(FrameData& data, std::string_view name) {
+    data.name = name;
+  }
+  static void onEvent(CoroEvent ev, const FrameData* data, void* addr) {
+    auto out = coutSync();
+    out << eventName(ev);
+    if (data != nullptr) {
+      out << " for " << data->name;
+    }
+    else if (addr != nullptr) {
+      out << " for " << addr;
+    }
+    out << '\n';
+  }
+};
+
+
+struct CountingInstrumentation {
+  struct FrameData {};
+  static inline std::atomic<std::uint64_t> counts[static_cast<std::size_t>(CoroEvent::numEvents)];
+
+  static void setName(FrameData&, std::string_view) noexcept {
+  }
+  static void onEvent(CoroEvent ev, const FrameData*, void*) noexcept {
+    counts[static_cast<std::size_t>(ev)].fetch_add(1, std::memory_order_relaxed);
+  }
+  static std::uint64_t count(CoroEvent ev) noexcept {
+    return counts[static_cast<std::size_t>(ev)].load(std::memory_order_relaxed);
+  }
+  static void reset() noexcept {
+    for (auto& c : counts) {
+      c.store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+
+// e.g. CoroTask<T, TaskCountingInstrumentation<SchedMetrics>>
+// for tasks of a CoroScheduler<NoInstrumentation, SchedMetrics>
+// (same FrameData as Instr, so the scheduler may use Instr)
+template <typename Metrics, typename Instr = NoInstrumentation>
+struct TaskCountingInstrumentation : Instr {
+  static void onEvent(CoroEvent ev, const typename Instr::FrameData* data, void* addr) {
+    if (ev == CoroEvent::finalSuspend) {
+      Metrics::taskCompleted();
+    }
+    Instr::onEvent(ev, data, addr);
+  }
+};
+
+#endif
@@ -0,0 +1,560 @@
+// io_uring based file I/O for coroutines of the CoroScheduler (Linux)
+//  - co_await file.read(buf, offset) / file.write(buf, offset)
+//    submit a request to the io_uring of an IoUringService and
+//    suspend the coroutine without blocking the worker thread
+//  - the reaper thread of the service waits for completions,
+//    reaps them in batches, and hands the waiting coroutines
+//    to the scheduler in one batch (see CoroScheduler::postAll())
+//  - registered buffers (readFixed()/writeFixed()) and registered files
+//    avoid mapping the buffer and looking up the file for each request
+//  - uses the raw system calls (no liburing)
+//
+// adaptation: the ring is owned by an IoUringService next to the scheduler
+// (not by each worker), so that the workers can still park on their
+// condition variable and steal from each other
+
+#ifndef INCLUDED_IO_URING_HPP
+#define INCLUDED_IO_URING_HPP
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <coroutine>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <span>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <ranges>
+#include <utility>
+#include <cerrno>
+#include <system_error>
+
+[[noreturn]] inline void throwIoError(int err, const char* what)
+{
+  throw std::system_error{err, std::generic_category(), what};
+}
+
+// minimal io_uring: the mapped submission and completion rings
+// - not thread-safe: one submitter and one reaper at a time
+class IoUring {
+ private:
+  int fd_ = -1;
+  io_uring_params params_{};
+
+  void* sqRing_ = nullptr;
+  std::size_t sqRingSize_ = 0;
+  void* cqRing_ = nullptr;
+  std::size_t cqRingSize_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  std::size_t sqesSize_ = 0;
+
+  // submission ring:
+  unsigned* sqHead_ = nullptr;
+  unsigned* sqTail_ = nullptr;
+  unsigned sqMask_ = 0;
+  unsigned* sqArray_ = nullptr;
+  unsigned sqLocalTail_ = 0;     // SQEs prepared so far
+  unsigned sqSubmitted_ = 0;     // SQEs passed to the kernel so far
+
+  // completion ring:
+  unsigned* cqHead_ = nullptr;
+  unsigned* cqTail_ = nullptr;
+  unsigned cqMask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+
+  static std::atomic_ref<unsigned> atomicRef(unsigned* p) noexcept {
+    return std::atomic_ref<unsigned>{*p};
+  }
+
+  static void* map(std::size_t size, int fd, off_t offset) {
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (p == MAP_FAILED) {
+      throwIoError(errno, "mmap(io_uring)");
+    }
+    return p;
+  }
+
+  void unmapAll() noexcept {
+    if (sqes_ != nullptr) {
+      ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != nullptr && cqRing_ != sqRing_) {
+      ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != nullptr) {
+      ::munmap(sqRing_, sqRingSize_);
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+ public:
+  explicit IoUring(unsigned entries = 256) {
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params_));
+    if (fd_ < 0) {
+      throwIoError(errno, "io_uring_setup()");
+    }
+    try {
+      sqRingSize_ = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+      cqRingSize_ = params_.cq_off.cqes + params_.cq_entries * sizeof(io_uring_cqe);
+      if (params_.features & IORING_FEAT_SINGLE_MMAP) {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+      }
+      sqRing_ = map(sqRingSize_, fd_, IORING_OFF_SQ_RING);
+      cqRing_ = (params_.features & IORING_FEAT_SINGLE_MMAP)
+                  ? sqRing_
+                  : map(cqRingSize_, fd_, IORING_OFF_CQ_RING);
+      sqesSize_ = params_.sq_entries * sizeof(io_uring_sqe);
+      sqes_ = static_cast<io_uring_sqe*>(map(sqesSize_, fd_, IORING_OFF_SQES));
+    }
+    catch (...) {
+      unmapAll();
+      throw;
+    }
+
+    auto* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params_.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params_.sq_off.array);
+    sqLocalTail_ = sqSubmitted_ = *sqTail_;
+
+    auto* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params_.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params_.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params_.cq_off.cqes);
+  }
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+  ~IoUring() {
+    unmapAll();
+  }
+
+  int fd() const noexcept {
+    return fd_;
+  }
+  unsigned sqEntries() const noexcept {
+    return params_.sq_entries;
+  }
+  unsigned cqEntries() const noexcept {
+    return params_.cq_entries;
+  }
+
+  // SQEs that can be prepared before the next submit()
+  unsigned sqSpace() const noexcept {
+    unsigned head = atomicRef(sqHead_).load(std::memory_order_acquire);
+    return params_.sq_entries - (sqLocalTail_ - head);
+  }
+
+  // next free SQE (cleared), nullptr if the submission ring is full
+  io_uring_sqe* getSqe() noexcept {
+    if (sqSpace() == 0) {
+      return nullptr;
+    }
+    unsigned idx = sqLocalTail_ & sqMask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[idx] = idx;
+    ++sqLocalTail_;
+    return sqe;
+  }
+
+  // pass all prepared SQEs to the kernel
+  // - returns 0 or the error of io_uring_enter() (EINTR is retried);
+  //   then the SQEs it didn't consume are taken back, and the first
+  //   numConsumed of the SQEs prepared since the last submit() were submitted
+  //   (without SQPOLL, the kernel reads the tail only in io_uring_enter())
+  int submit(unsigned& numConsumed) noexcept {
+    unsigned start = sqSubmitted_;
+    atomicRef(sqTail_).store(sqLocalTail_, std::memory_order_release);
+    int err = 0;
+    while (sqSubmitted_ != sqLocalTail_) {
+      long ret = ::syscall(__NR_io_uring_enter, fd_, sqLocalTail_ - sqSubmitted_, 0, 0,
+                           nullptr, 0);
+      if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        err = errno;
+        sqLocalTail_ = sqSubmitted_;
+        atomicRef(sqTail_).store(sqLocalTail_, std::memory_order_release);
+        break;
+      }
+      sqSubmitted_ += static_cast<unsigned>(ret);
+    }
+    numConsumed = sqSubmitted_ - start;
+    return err;
+  }
+
+  // call fn(const io_uring_cqe&) for all available completions
+  // returns the number of completions reaped
+  template <typename FN>
+  unsigned reap(FN fn) {
+    unsigned head = *cqHead_;
+    unsigned tail = atomicRef(cqTail_).load(std::memory_order_acquire);
+    unsigned num = tail - head;
+    for (; head != tail; ++head) {
+      fn(cqes_[head & cqMask_]);
+    }
+    atomicRef(cqHead_).store(head, std::memory_order_release);
+    return num;
+  }
+
+  void registerBuffers(std::span<const iovec> bufs) {
+    if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+                  bufs.data(), static_cast<unsigned>(bufs.size())) < 0) {
+      throwIoError(errno, "io_uring_register(buffers)");
+    }
+  }
+
+  void registerFiles(std::span<const int> fds) {
+    if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_FILES,
+                  fds.data(), static_cast<unsigned>(fds.size())) < 0) {
+      throwIoError(errno, "io_uring_register(files)");
+    }
+  }
+};
+
+
+// io_uring with a reaper thread resuming the coroutines on a scheduler
+// - submit() only queues the request: a worker submits all requests
+//   queued meanwhile with one io_uring_enter() once it ran out of
+//   coroutines to resume (see CoroScheduler::defer()), other threads at once
+// - the requests in flight are bounded by the completion ring, so that
+//   no completion overflows: requests beyond that stay queued until
+//   the reaper reaped completions (backpressure instead of spinning)
+// - all requests must be complete before the service is destroyed
+template <typename Sched>
+class IoUringService {
+ public:
+  // a request of a suspended coroutine
+  struct Operation {
+    std::coroutine_handle<> hdl;
+    int result = 0;
+    // prepared request, copied into the ring by flush()
+    // (bytes: io_uring_sqe ends with a flexible array member)
+    alignas(io_uring_sqe) unsigned char sqe[sizeof(io_uring_sqe)];
+    Operation* next = nullptr;        // in the queue of requests not submitted yet
+  };
+
+ private:
+  Sched& sched_;
+  IoUring ring_;
+  std::mutex queueMx_;                // guards the queue and flushDeferred_
+  Operation* queueHead_ = nullptr;    // requests not submitted yet (FIFO)
+  Operation* queueTail_ = nullptr;
+  bool flushDeferred_ = false;        // flushWork_ is deferred on a worker
+  std::mutex submitMx_;               // the submission ring has one producer at a time
+  std::vector<Operation*> batch_;     // requests copied into the ring (with submitMx_)
+  std::atomic<unsigned> inFlight_{0}; // submitted and not reaped yet
+  struct FlushWork : Sched::DeferredWork {
+    IoUringService* service = nullptr;
+  };
+  FlushWork flushWork_;
+  Operation stopOp_;                  // NOP that stops the reaper
+  std::atomic<bool> stopping_{false};
+  std::atomic<std::uint64_t> numSubmitted_{0};
+  std::atomic<std::uint64_t> numEnters_{0};
+  std::atomic<std::uint64_t> numBatches_{0};
+  std::atomic<std::uint64_t> numCompleted_{0};
+  std::jthread reaper_;
+
+  template <typename PREP>
+  static void prepare(Operation* op, PREP prep) {
+    io_uring_sqe sqe{};
+    prep(sqe);
+    sqe.user_data = reinterpret_cast<std::uintptr_t>(op);
+    std::memcpy(op->sqe, &sqe, sizeof(sqe));
+  }
+
+  void queue(Operation* op) noexcept {
+    op->next = nullptr;
+    if (queueTail_ == nullptr) {
+      queueHead_ = op;
+    }
+    else {
+      queueTail_->next = op;
+    }
+    queueTail_ = op;
+  }
+
+  bool hasQueued() {
+    std::lock_guard lock{queueMx_};
+    return queueHead_ != nullptr;
+  }
+
+  // submit the queued requests in batches, as many as the rings take
+  void flush() noexcept {
+    std::lock_guard submitLock{submitMx_};
+    while (true) {
+      unsigned room = std::min(ring_.sqSpace(),
+                               ring_.cqEntries() - inFlight_.load(std::memory_order_acquire));
+      batch_.clear();
+      {
+        std::lock_guard lock{queueMx_};
+        flushDeferred_ = false;   // requests queued from now on defer another flush
+        while (batch_.size() < room && queueHead_ != nullptr) {
+          batch_.push_back(queueHead_);   // (no allocation: capacity of sq entries)
+          queueHead_ = queueHead_->next;
+        }
+        if (queueHead_ == nullptr) {
+          queueTail_ = nullptr;
+        }
+      }
+      if (batch_.empty()) {
+        return;
+      }
+      for (Operation* op : batch_) {
+        std::memcpy(ring_.getSqe(), op->sqe, sizeof(io_uring_sqe));
+      }
+      // from here on, the coroutines may be resumed on a worker at any time:
+      auto num = static_cast<unsigned>(batch_.size());
+      inFlight_.fetch_add(num, std::memory_order_relaxed);
+      unsigned numConsumed = 0;
+      int err = ring_.submit(numConsumed);
+      numSubmitted_.fetch_add(numConsumed, std::memory_order_relaxed);
+      numEnters_.fetch_add(1, std::memory_order_relaxed);
+      if (err != 0) {
+        // the kernel didn't take the rest (e.g. EAGAIN: out of memory):
+        // resume them with the error
+        inFlight_.fetch_sub(num - numConsumed, std::memory_order_relaxed);
+        auto failed = batch_ | std::views::drop(numConsumed)
+                             | std::views::transform([err](Operation* op) {
+                                 op->result = -err;
+                                 return op->hdl;
+                               });
+        sched_.postAll(failed);
+      }
+    }
+  }
+
+  void reap() {
+    // completions reaped at once are resumed in one batch:
+    std::vector<std::coroutine_handle<>> ready;
+    ready.reserve(ring_.cqEntries());
+    while (true) {
+      {
+        // wait for at least one completion
+        // (io_uring_enter() with nothing to submit doesn't touch the submission ring)
+        long ret = ::syscall(__NR_io_uring_enter, ring_.fd(), 0, 1,
+                             IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret < 0 && errno != EINTR) {
+          throwIoError(errno, "io_uring_enter()");
+        }
+      }
+      bool stop = false;
+      unsigned num = ring_.reap([&](const io_uring_cqe& cqe) {
+        auto* op = reinterpret_cast<Operation*>(static_cast<std::uintptr_t>(cqe.user_data));
+        if (op == &stopOp_) {
+          stop = true;
+          return;
+        }
+        op->result = cqe.res;
+        ready.push_back(op->hdl);
+      });
+      inFlight_.fetch_sub(num, std::memory_order_release);
+      if (!ready.empty()) {
+        numCompleted_.fetch_add(ready.size(), std::memory_order_relaxed);
+        numBatches_.fetch_add(1, std::memory_order_relaxed);
+        sched_.postAll(ready);
+        ready.clear();
+      }
+      if (stop && stopping_.load()) {
+        return;
+      }
+      // requests waiting for room in the rings:
+      if (num > 0 && hasQueued()) {
+        flush();
+      }
+    }
+  }
+
+ public:
+  explicit IoUringService(Sched& sched, unsigned entries = 256)
+   : sched_{sched}, ring_{entries} {
+    batch_.reserve(ring_.sqEntries());
+    flushWork_.service = this;
+    flushWork_.run = [](typename Sched::DeferredWork& work) noexcept {
+      static_cast<FlushWork&>(work).service->flush();
+    };
+    reaper_ = std::jthread{[this] { reap(); }};
+  }
+
+  IoUringService(const IoUringService&) = delete;
+  IoUringService& operator=(const IoUringService&) = delete;
+
+  ~IoUringService() {
+    // a flush deferred on a worker has to run before the service is gone:
+    sched_.runDeferred();
+    while (true) {
+      std::lock_guard lock{queueMx_};
+      if (!flushDeferred_) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    stopping_.store(true);
+    prepare(&stopOp_, [](io_uring_sqe& sqe) {
+      sqe.opcode = IORING_OP_NOP;
+    });
+    {
+      std::lock_guard lock{queueMx_};
+      queue(&stopOp_);
+    }
+    flush();
+    reaper_.join();
+  }
+
+  // register buffers for readFixed()/writeFixed() (index = position in bufs)
+  void registerBuffers(std::span<const iovec> bufs) {
+    ring_.registerBuffers(bufs);
+  }
+  // register files for UringFile (index = position in fds)
+  void registerFiles(std::span<const int> fds) {
+    ring_.registerFiles(fds);
+  }
+
+  // prepare the SQE of op with prep(io_uring_sqe&) and queue it for submission
+  // - op->hdl may be resumed before submit() returns
+  // - a failed submission resumes op->hdl with result -errno
+  template <typename PREP>
+  void submit(Operation* op, PREP prep) {
+    prepare(op, prep);
+    bool deferFlush = false;
+    {
+      std::lock_guard lock{queueMx_};
+      queue(op);
+      deferFlush = !std::exchange(flushDeferred_, true);
+    }
+    if (deferFlush) {
+      sched_.defer(flushWork_);
+    }
+  }
+
+  std::uint64_t numSubmitted() const noexcept {
+    return numSubmitted_.load();
+  }
+  std::uint64_t numCompleted() const noexcept {
+    return numCompleted_.load();
+  }
+  // average number of requests submitted with one io_uring_enter()
+  double averageSubmitBatch() const noexcept {
+    auto enters = numEnters_.load();
+    return enters == 0 ? 0.0 : static_cast<double>(numSubmitted_.load())
+                                 / static_cast<double>(enters);
+  }
+  // average number of completions handed to the scheduler at once
+  double averageBatch() const noexcept {
+    auto batches = numBatches_.load();
+    return batches == 0 ? 0.0 : static_cast<double>(numCompleted_.load())
+                                  / static_cast<double>(batches);
+  }
+};
+
+
+// file (descriptor) with awaitable reads and writes
+// - the file descriptor is not owned (closing it is up to the caller)
+// - with fixedIndex >= 0 the file registered at this index is used
+// - the awaiters return the number of bytes transferred
+//   or throw std::system_error
+template <typename Sched>
+class UringFile {
+ public:
+  using Service = IoUringService<Sched>;
+
+  class IoAwaiter {
+   private:
+    Service& service;
+    typename Service::Operation op;
+    std::uint8_t opcode;
+    int fd;
+    bool fixedFile;
+    const void* addr;
+    unsigned len;
+    std::uint64_t offset;
+    int bufIndex;    // registered buffer or -1
+
+   public:
+    IoAwaiter(Service& s, std::uint8_t opc, int f, bool fixed,
+              const void* a, std::size_t l, std::uint64_t off, int bufIdx) noexcept
+     : service{s}, opcode{opc}, fd{f}, fixedFile{fixed},
+       addr{a}, len{static_cast<unsigned>(l)}, offset{off}, bufIndex{bufIdx} {
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> hdl) {
+      op.hdl = hdl;
+      // from here on, the coroutine may be resumed on a worker at any time:
+      service.submit(&op, [this](io_uring_sqe& sqe) {
+        sqe.opcode = opcode;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(addr);
+        sqe.len = len;
+        sqe.off = offset;
+        if (fixedFile) {
+          sqe.flags |= IOSQE_FIXED_FILE;
+        }
+        if (bufIndex >= 0) {
+          sqe.buf_index = static_cast<std::uint16_t>(bufIndex);
+        }
+      });
+    }
+
+    std::size_t await_resume() const {
+      if (op.result < 0) {
+        throwIoError(-op.result, opcode == IORING_OP_READ || opcode == IORING_OP_READ_FIXED
+                                   ? "io_uring read" : "io_uring write");
+      }
+      return static_cast<std::size_t>(op.result);
+    }
+  };
+
+ private:
+  Service& service_;
+  int fd_;            // file descriptor or index of the registered file
+  bool fixedFile_;
+
+ public:
+  // plain file descriptor
+  UringFile(Service& service, int fd) noexcept
+   : service_{service}, fd_{fd}, fixedFile_{false} {
+  }
+  // file registered at index fixedIndex (see IoUringService::registerFiles())
+  UringFile(Service& service, int fd, int fixedIndex) noexcept
+   : service_{service}, fd_{fixedIndex >= 0 ? fixedIndex : fd}, fixedFile_{fixedIndex >= 0} {
+  }
+
+  IoAwaiter read(std::span<std::byte> buf, std::uint64_t offset) noexcept {
+    return IoAwaiter{service_, IORING_OP_READ, fd_, fixedFile_,
+                     buf.data(), buf.size(), offset, -1};
+  }
+  IoAwaiter write(std::span<const std::byte> buf, std::uint64_t offset) noexcept {
+    return IoAwaiter{service_, IORING_OP_WRITE, fd_, fixedFile_,
+                     buf.data(), buf.size(), offset, -1};
+  }
+
+  // buf has to be part of the buffer registered at bufIndex
+  IoAwaiter readFixed(std::span<std::byte> buf, int bufIndex, std::uint64_t offset) noexcept {
+    return IoAwaiter{service_, IORING_OP_READ_FIXED, fd_, fixedFile_,
+                     buf.data(), buf.size(), offset, bufIndex};
+  }
+  IoAwaiter writeFixed(std::span<const std::byte> buf, int bufIndex, std::uint64_t offset) noexcept {
+    return IoAwaiter{service_, IORING_OP_WRITE_FIXED, fd_, fixedFile_,
+                     buf.data(), buf.size(), offset, bufIndex};
+  }
+};
+
+#endif
@@ -0,0 +1,94 @@
+// intrusive lock-free multi-producer single-consumer queue
+//  - push() is one exchange() and one store, from any number of threads,
+//    pushChain() appends a linked batch with the same cost
+//  - pop() may only be called by one thread at a time
+//    (the consumer; see tryLockConsumer())
+//  - nodes are owned by the caller (T derives from MpscNode)
+//    and may be reused/freed as soon as pop() returned them
+//  - pop() returns nullptr while a producer is between its exchange()
+//    and its store (the queue then looks empty for an instant)
+// based on Dmitry Vyukov's intrusive MPSC node-based queue:
+//  https://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+
+#ifndef INCLUDED_MPSC_QUEUE_HPP
+#define INCLUDED_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <type_traits>
+
+// hook for elements of an MpscQueue
+struct MpscNode {
+  std::atomic<MpscNode*> next{nullptr};
+};
+
+template <typename T>
+class MpscQueue {
+ private:
+  alignas(64) std::atomic<MpscNode*> head_;   // last pushed (producers)
+  alignas(64) MpscNode* tail_;                // next to pop (consumer)
+  std::atomic<bool> consumerBusy_{false};
+  MpscNode stub_;
+
+  void pushNodes(MpscNode* first, MpscNode* last) noexcept {
+    last->next.store(nullptr, std::memory_order_relaxed);
+    MpscNode* prev = head_.exchange(last, std::memory_order_acq_rel);
+    prev->next.store(first, std::memory_order_release);
+  }
+
+ public:
+  MpscQueue() noexcept
+   : head_{&stub_}, tail_{&stub_} {
+    static_assert(std::is_base_of_v<MpscNode, T>, "T has to derive from MpscNode");
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  void push(T& t) noexcept {
+    pushNodes(&t, &t);
+  }
+
+  // append first...last, already linked with next
+  void pushChain(T& first, T& last) noexcept {
+    pushNodes(&first, &last);
+  }
+
+  // consumer only:
+  T* pop() noexcept {
+    MpscNode* tail = tail_;
+    MpscNode* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      tail_ = tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+      tail_ = next;
+      return static_cast<T*>(tail);
+    }
+    if (tail != head_.load(std::memory_order_acquire)) {
+      return nullptr;   // a producer is just linking its node
+    }
+    // tail is the last node: put the stub behind it, so that it can be taken
+    pushNodes(&stub_, &stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      tail_ = next;
+      return static_cast<T*>(tail);
+    }
+    return nullptr;
+  }
+
+  // become the consumer (false if another thread is)
+  bool tryLockConsumer() noexcept {
+    return !consumerBusy_.load(std::memory_order_relaxed)
+           && !consumerBusy_.exchange(true, std::memory_order_acquire);
+  }
+  void unlockConsumer() noexcept {
+    consumerBusy_.store(false, std::memory_order_release);
+  }
+};
+
+#endif
@@ -0,0 +1,131 @@
+// NUMA-aware placement of the CoroScheduler workers (see cputopology.hpp)
+//  - runs the same fan-out on a scheduler with workers pinned to the CPUs
+//    of a topology and on one without placement
+//  - each child hops several times and works on a buffer in its frame,
+//    so that resuming it on another node would touch remote memory
+//  - prints where the workers run, how many steals crossed nodes,
+//    and how many frames came from node-local slabs
+//  - on a single-socket machine, pass a number of nodes to simulate them
+// usage: numabench [numNodes [cpusPerNode [numChildren [rounds]]]]
+//  - numNodes 0: detect the topology (default)
+
+#include "corotask.hpp"
+#include "coroscheduler.hpp"
+#include "cputopology.hpp"
+#include "syncwait.hpp"
+#include "whenall.hpp"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+using Sched = CoroScheduler<>;
+
+constexpr unsigned numHops = 8;
+
+CoroTask<std::uint64_t> child(Sched& sched, std::uint64_t id)
+{
+  std::uint64_t buffer[64];   // part of the frame
+  std::uint64_t sum = 0;
+  for (unsigned h = 0; h < numHops; ++h) {
+    co_await sched.schedule();
+    for (std::uint64_t& x : buffer) {
+      x = id + h;
+      sum += x;
+    }
+  }
+  co_return sum;
+}
+
+CoroTask<std::uint64_t> fanOut(Sched& sched, unsigned num)
+{
+  co_await sched.schedule();   // the children's frames come from a worker
+  std::vector<CoroTask<std::uint64_t>> children;
+  children.reserve(num);
+  for (unsigned i = 0; i < num; ++i) {
+    children.push_back(child(sched, i));
+  }
+  std::vector<std::uint64_t> results = co_await when_all(sched, std::move(children));
+  std::uint64_t sum = 0;
+  for (std::uint64_t r : results) {
+    sum += r;
+  }
+  co_return sum;
+}
+
+std::uint64_t expected(unsigned num)
+{
+  std::uint64_t sum = 0;
+  for (std::uint64_t id = 0; id < num; ++id) {
+    for (unsigned h = 0; h < numHops; ++h) {
+      sum += 64 * (id + h);
+    }
+  }
+  return sum;
+}
+
+// ns per child, or 0 if a result was wrong
+double run(Sched& sched, unsigned numChildren, unsigned rounds)
+{
+  auto start = Clock::now();
+  for (unsigned r = 0; r < rounds; ++r) {
+    if (sync_wait(fanOut(sched, numChildren)) != expected(numChildren)) {
+      return 0;
+    }
+  }
+  std::chrono::duration<double, std::nano> ns = Clock::now() - start;
+  return ns.count() / (static_cast<double>(numChildren) * rounds);
+}
+
+void report(const Sched& sched)
+{
+  std::uint64_t local = 0, remote = 0;
+  unsigned index = 0;
+  for (const auto& w : sched.workerInfo()) {
+    std::cout << "    worker " << index++ << ": node " << w.node;
+    if (w.cpu >= 0) {
+      std::cout << ", CPU " << w.cpu << (w.pinned ? "" : " (pinning failed)");
+    }
+    std::cout << ", steals: " << w.localSteals << " same node, " << w.remoteSteals << " other node\n";
+    local += w.localSteals;
+    remote += w.remoteSteals;
+  }
+  std::cout << "    steals across nodes: " << remote << " of " << local + remote << '\n';
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned numNodes = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 0;
+  unsigned cpusPerNode = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 2;
+  unsigned numChildren = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 256;
+  unsigned rounds = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : 200;
+
+  CpuTopology topo = numNodes == 0 ? CpuTopology::detect()
+                                   : CpuTopology::simulate(numNodes, cpusPerNode);
+  topo.print(std::cout);
+  bool ok = true;
+
+  // first, so that the workers' frame pools start empty:
+  {
+    Sched sched{topo};
+    double ns = run(sched, numChildren, rounds);
+    ok = ok && ns > 0;
+    std::cout << "pinned workers: " << ns << " ns per child\n";
+    report(sched);
+  }
+  auto stats = FramePool::totalStats();
+  std::cout << "    frames from node slabs: " << stats.nodeFrames
+            << " (frame pool misses: " << stats.misses << ")\n";
+  {
+    Sched sched{topo.numCpus()};
+    double ns = run(sched, numChildren, rounds);
+    ok = ok && ns > 0;
+    std::cout << "no placement:   " << ns << " ns per child\n";
+    report(sched);
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,71 @@
+// throughput benchmark for the work-stealing CoroScheduler
+//  one root coroutine fans out CPU-bound tasks from a worker,
+//  the other workers have to steal them
+// usage: schedbench [maxWorkers [numTasks [spinsPerTask]]]
+
+#include "coroscheduler.hpp"
+#include "../bench/benchfixture.hpp"
+#include <iostream>
+#include <coroutine>
+#include <exception>
+#include <chrono>
+#include <latch>
+#include <string>
+#include <cstdint>
+
+std::uint64_t burn(unsigned spins)
+{
+  std::uint64_t x = spins;
+  for (unsigned i = 0; i < spins; ++i) {
+    x = x * 6364136223846793005u + 1442695040888963407u;
+  }
+  return x;
+}
+
+std::atomic<std::uint64_t> sink{0};
+
+DetachedTask work(CoroScheduler<>& sched, std::latch& done, unsigned spins)
+{
+  co_await sched.schedule();
+  sink.fetch_add(burn(spins), std::memory_order_relaxed);
+  done.count_down();
+}
+
+DetachedTask fanOut(CoroScheduler<>& sched, std::latch& done,
+                    unsigned numTasks, unsigned spins)
+{
+  co_await sched.schedule();   // now on a worker: children go to its deque
+  for (unsigned i = 0; i < numTasks; ++i) {
+    work(sched, done, spins);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned maxWorkers = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1]))
+                                 : std::thread::hardware_concurrency();
+  unsigned numTasks = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 200'000;
+  unsigned spins = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 2'000;
+  if (maxWorkers == 0) {
+    maxWorkers = 1;
+  }
+
+  std::cout << "workers  tasks/s      speedup\n";
+  double base = 0;
+  for (unsigned numWorkers = 1; numWorkers <= maxWorkers; ++numWorkers) {
+    CoroScheduler<> sched{numWorkers};
+    std::latch done{static_cast<std::ptrdiff_t>(numTasks)};
+
+    auto start = std::chrono::steady_clock::now();
+    fanOut(sched, done, numTasks, spins);
+    done.wait();
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+
+    double rate = numTasks / secs.count();
+    if (numWorkers == 1) {
+      base = rate;
+    }
+    std::cout << numWorkers << "\t " << static_cast<std::uint64_t>(rate)
+              << "\t " << rate / base << '\n';
+  }
+}
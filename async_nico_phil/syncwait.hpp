@@ -0,0 +1,121 @@
+// sync_wait() for the async coro example
+//  - starts a task on the calling thread,
+//    blocks the thread (without spinning) until the task is done,
+//    and returns the result of the task or rethrows its exception
+//  - the calling thread is woken by the final awaiter of the wrapping coroutine,
+//    which may run on any thread (e.g., a worker of the CoroScheduler)
+
+#ifndef INCLUDED_SYNC_WAIT_HPP
+#define INCLUDED_SYNC_WAIT_HPP
+
+#include <coroutine>
+#include <exception>
+#include <utility>     // for std::exchange(), std::declval()
+#include <optional>
+#include <type_traits>
+#include <mutex>
+#include <condition_variable>
+
+// event the calling thread blocks on
+class SyncWaitEvent {
+ private:
+  std::mutex mx;
+  std::condition_variable cv;
+  bool isSet = false;
+ public:
+  void set() noexcept {
+    // notify while holding the lock:
+    // the waiting thread can't return (and destroy the event) before we are done
+    std::lock_guard lock{mx};
+    isSet = true;
+    cv.notify_one();
+  }
+  void wait() {
+    std::unique_lock lock{mx};
+    cv.wait(lock, [&] { return isSet; });
+  }
+};
+
+// coroutine that awaits the task and signals the event when done
+class SyncWaitTask {
+ public:
+  struct promise_type {
+    SyncWaitEvent* event = nullptr;
+    std::exception_ptr exception;
+
+    SyncWaitTask get_return_object() noexcept {
+      return SyncWaitTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      void await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+        // the coroutine is suspended now, so the waiting thread may destroy it
+        h.promise().event->set();
+      }
+      void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept {
+      exception = std::current_exception();
+    }
+  };
+
+ private:
+  std::coroutine_handle<promise_type> hdl;
+
+  explicit SyncWaitTask(std::coroutine_handle<promise_type> h) noexcept
+   : hdl{h} {
+  }
+
+ public:
+  SyncWaitTask(SyncWaitTask&& t) noexcept
+   : hdl{std::exchange(t.hdl, {})} {
+  }
+  ~SyncWaitTask() {
+    if (hdl) hdl.destroy();
+  }
+
+  void run(SyncWaitEvent& event) {
+    hdl.promise().event = &event;
+    hdl.resume();
+    event.wait();
+    if (hdl.promise().exception) {
+      std::rethrow_exception(hdl.promise().exception);
+    }
+  }
+};
+
+// type of the value co_await yields for a task
+template <typename Task>
+using AwaitResult = decltype(std::declval<Task>().operator co_await().await_resume());
+
+template <typename Task, typename Result>
+SyncWaitTask makeSyncWaitTask(Task& task, Result& result)
+{
+  if constexpr (std::is_void_v<AwaitResult<Task>>) {
+    co_await std::move(task);
+  }
+  else {
+    result.emplace(co_await std::move(task));
+  }
+}
+
+template <typename Task>
+auto sync_wait(Task&& task) -> AwaitResult<Task>
+{
+  using R = AwaitResult<Task>;
+  static_assert(std::is_void_v<R> || std::is_object_v<R>,
+                "sync_wait() requires void or a value type as result");
+  std::optional<std::conditional_t<std::is_void_v<R>, int, R>> result;
+
+  SyncWaitEvent event;
+  makeSyncWaitTask(task, result).run(event);
+
+  if constexpr (!std::is_void_v<R>) {
+    return std::move(*result);
+  }
+}
+
+#endif
@@ -0,0 +1,174 @@
+// timers of the CoroScheduler (see timerqueue.hpp)
+//  - numTasks coroutines each wait up to delayMs on numWorkers workers:
+//    with co_await sched.schedule_after() the waits overlap,
+//    with std::this_thread::sleep_for() each one blocks a worker
+//  - lateness: from the deadline to the resume (p50, p99, max)
+//  - checks: no timer resumes early, a deadline that passed resumes at once,
+//    cancellation dequeues a timer and resumes it with operation_cancelled
+// usage: timerbench [numWorkers [numTasks [delayMs]]]
+
+#include "corotask.hpp"
+#include "coroscheduler.hpp"
+#include "syncwait.hpp"
+#include "whenall.hpp"
+#include "../awaiter_lewis/cancellation.hpp"
+#include "../bench/benchfixture.hpp"
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace std::literals;
+using Clock = std::chrono::steady_clock;
+using Sched = CoroScheduler<>;
+
+std::int64_t nsSince(Clock::time_point tp)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - tp).count();
+}
+
+// lateness in ns (-1: cancelled)
+CoroTask<std::int64_t> sleeper(Sched& sched, std::chrono::microseconds delay)
+{
+  Clock::time_point deadline;
+  try {
+    co_await sched.schedule();
+    deadline = Clock::now() + delay;
+    co_await sched.schedule_at(deadline);
+  }
+  catch (const operation_cancelled&) {
+    co_return -1;
+  }
+  co_return nsSince(deadline);
+}
+
+CoroTask<std::int64_t> blockingSleeper(Sched& sched, std::chrono::microseconds delay)
+{
+  co_await sched.schedule();
+  auto deadline = Clock::now() + delay;
+  std::this_thread::sleep_for(delay);
+  co_return nsSince(deadline);
+}
+
+CoroTask<std::vector<std::int64_t>> fanOut(Sched& sched, std::vector<CoroTask<std::int64_t>> tasks)
+{
+  co_await sched.schedule();
+  co_return co_await when_all(sched, std::move(tasks));
+}
+
+// delays spread over (0, delay]
+std::chrono::microseconds delayOf(unsigned i, std::chrono::milliseconds delay)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(delay) * (i % 8 + 1) / 8;
+}
+
+template <typename SLEEPER>
+std::vector<std::int64_t> run(const char* name, Sched& sched, unsigned numTasks,
+                              std::chrono::milliseconds delay, SLEEPER sleeper)
+{
+  std::vector<CoroTask<std::int64_t>> tasks;
+  for (unsigned i = 0; i < numTasks; ++i) {
+    tasks.push_back(sleeper(sched, delayOf(i, delay)));
+  }
+  auto start = Clock::now();
+  std::vector<std::int64_t> lateness = sync_wait(fanOut(sched, std::move(tasks)));
+  auto ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  std::sort(lateness.begin(), lateness.end());
+  auto us = [&lateness](double p) {
+    return static_cast<double>(lateness[static_cast<std::size_t>(p * static_cast<double>(lateness.size() - 1))]) / 1000.0;
+  };
+  std::cout << "  " << name << ms << " ms for all, lateness p50 " << us(0.5) << " us, p99 "
+            << us(0.99) << " us, max " << us(1.0) << " us\n";
+  return lateness;
+}
+
+CoroTask<int> longSleep(Sched& sched, std::chrono::seconds delay)
+{
+  try {
+    co_await sched.schedule_after(delay);
+  }
+  catch (const operation_cancelled&) {
+    co_return -1;
+  }
+  co_return 1;
+}
+
+void checks(Sched& sched, std::chrono::milliseconds delay)
+{
+  std::cout << "checks:\n";
+  {
+    auto start = Clock::now();
+    auto passed = [](Sched& sched) -> CoroTask<std::thread::id> {
+      co_await sched.schedule_at(Clock::now() - 1s);
+      co_return std::this_thread::get_id();
+    };
+    std::thread::id id = sync_wait(passed(sched));
+    check(id != std::this_thread::get_id() && Clock::now() - start < 100ms,
+          "a deadline that passed resumes at once on a worker");
+  }
+  {
+    cancellation_source source;
+    auto task = longSleep(sched, 10s);
+    task.setCancellationToken(source.token());
+    auto start = Clock::now();
+    std::jthread canceller{[&source, delay] {
+      std::this_thread::sleep_for(delay);
+      source.request_cancellation();
+    }};
+    int result = sync_wait(std::move(task));
+    check(result == -1 && Clock::now() - start < 5s, "cancellation ends a 10s wait early");
+  }
+  {
+    cancellation_source source;
+    source.request_cancellation();
+    auto task = longSleep(sched, 10s);
+    task.setCancellationToken(source.token());
+    check(sync_wait(std::move(task)) == -1, "a cancelled coroutine doesn't wait");
+  }
+  {
+    // cancel half of many timers while they are queued (removal from the heap):
+    cancellation_source sources[2];
+    std::vector<CoroTask<std::int64_t>> tasks;
+    for (unsigned i = 0; i < 2000; ++i) {
+      tasks.push_back(sleeper(sched, delayOf(i, delay) + 1ms));
+      tasks.back().setCancellationToken(sources[i % 2].token());
+    }
+    std::jthread canceller{[&sources, delay] {
+      std::this_thread::sleep_for(delay / 2);
+      sources[0].request_cancellation();
+    }};
+    std::vector<std::int64_t> results = sync_wait(fanOut(sched, std::move(tasks)));
+    std::size_t cancelled = 0;
+    bool ok = true;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      if (results[i] < 0) {
+        ++cancelled;
+        ok = ok && i % 2 == 0;
+      }
+    }
+    check(ok && cancelled > 0, "cancellation only ends the timers of its source early ("
+                               + std::to_string(cancelled) + " of 1000 cancelled)");
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned numWorkers = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 2;
+  unsigned numTasks = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 200;
+  std::chrono::milliseconds delay{argc > 3 ? std::stol(argv[3]) : 20};
+
+  Sched sched{numWorkers};
+  std::cout << numTasks << " coroutines waiting up to " << delay.count() << " ms on "
+            << sched.numWorkers() << " workers:\n";
+  auto timed = run("schedule_after(): ", sched, numTasks, delay, sleeper);
+  check(timed.front() >= 0, "no timer resumes before its deadline");
+  run("sleep_for():       ", sched, numTasks, delay, blockingSleeper);
+
+  checks(sched, delay);
+
+  return checksOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
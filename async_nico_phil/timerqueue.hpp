@@ -0,0 +1,298 @@
+// timers for the CoroScheduler
+//  - TimerQueueNode: hook with the deadline and the coroutine to resume,
+//    part of the awaiter in the coroutine frame (no allocation)
+//  - TimerHeap: 4-ary min-heap of the nodes ordered by deadline
+//    (half as deep as a binary heap and the children of a node are
+//     adjacent, so a sift touches fewer cache lines);
+//    each node knows its position, so any node can be removed (cancellation)
+//  - TimerQueue: the heap and one timerfd, which is always armed
+//    for the earliest deadline (CLOCK_MONOTONIC: the clock of steady_clock);
+//    the epoll reactor polls the timerfd with the sockets, so a blocked
+//    poller sleeps exactly until the next timer expires or it is interrupted
+//    (without Linux: no timerfd, the poller waits on a condition variable
+//     for the armed deadline, see wait() and timerreactor.hpp)
+//  - add() and remove() from any thread, expire() by the polling thread
+//  - a node is released twice: by the queue (expired or removed)
+//    and by the awaiter (done suspending); who releases last resumes
+//    the coroutine (see release())
+
+#ifndef INCLUDED_TIMER_QUEUE_HPP
+#define INCLUDED_TIMER_QUEUE_HPP
+
+#include <coroutine>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <cerrno>
+#include <system_error>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#endif
+
+// hook for coroutines waiting in a TimerQueue
+struct TimerQueueNode {
+  using Clock = std::chrono::steady_clock;
+  static constexpr std::size_t notQueued = std::numeric_limits<std::size_t>::max();
+
+  Clock::time_point deadline{};
+  std::coroutine_handle<> hdl;
+  std::size_t heapIndex = notQueued;        // position in the TimerHeap
+  std::atomic<unsigned> unreleased{2};      // queue and awaiter
+
+  // true for the last of the two releases (it has to resume hdl)
+  bool release() noexcept {
+    return unreleased.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+};
+
+class TimerHeap {
+ private:
+  static constexpr std::size_t arity = 4;
+
+  struct Entry {
+    TimerQueueNode::Clock::time_point deadline;   // (copy, so that sifts don't visit the nodes)
+    TimerQueueNode* node;
+  };
+  std::vector<Entry> heap_;
+
+  void place(std::size_t i, const Entry& e) noexcept {
+    heap_[i] = e;
+    e.node->heapIndex = i;
+  }
+
+  void siftUp(std::size_t i) noexcept {
+    Entry e = heap_[i];
+    while (i > 0) {
+      std::size_t parent = (i - 1) / arity;
+      if (!(e.deadline < heap_[parent].deadline)) {
+        break;
+      }
+      place(i, heap_[parent]);
+      i = parent;
+    }
+    place(i, e);
+  }
+
+  void siftDown(std::size_t i) noexcept {
+    Entry e = heap_[i];
+    std::size_t n = heap_.size();
+    while (true) {
+      std::size_t first = arity * i + 1;
+      if (first >= n) {
+        break;
+      }
+      std::size_t min = first;
+      std::size_t end = first + arity < n ? first + arity : n;
+      for (std::size_t c = first + 1; c < end; ++c) {
+        if (heap_[c].deadline < heap_[min].deadline) {
+          min = c;
+        }
+      }
+      if (!(heap_[min].deadline < e.deadline)) {
+        break;
+      }
+      place(i, heap_[min]);
+      i = min;
+    }
+    place(i, e);
+  }
+
+ public:
+  std::size_t size() const noexcept {
+    return heap_.size();
+  }
+  bool empty() const noexcept {
+    return heap_.empty();
+  }
+
+  void push(TimerQueueNode& node) {
+    heap_.push_back(Entry{node.deadline, &node});
+    siftUp(heap_.size() - 1);
+  }
+
+  // node with the earliest deadline (heap must not be empty)
+  TimerQueueNode& top() const noexcept {
+    return *heap_.front().node;
+  }
+
+  // remove a queued node
+  void remove(TimerQueueNode& node) noexcept {
+    std::size_t i = node.heapIndex;
+    node.heapIndex = TimerQueueNode::notQueued;
+    Entry last = heap_.back();
+    heap_.pop_back();
+    if (i < heap_.size()) {
+      place(i, last);
+      siftDown(i);
+      siftUp(last.node->heapIndex);
+    }
+  }
+};
+
+class TimerQueue {
+ public:
+  using Clock = TimerQueueNode::Clock;
+
+ private:
+  std::mutex mx_;
+  TimerHeap heap_;
+  Clock::time_point armedFor_ = Clock::time_point::max();   // max: disarmed
+  std::atomic<std::size_t> size_{0};
+
+  [[noreturn]] static void throwErrno(const char* what) {
+    throw std::system_error{errno, std::generic_category(), what};
+  }
+
+#ifdef __linux__
+  int fd_ = -1;
+
+  // arm the timerfd for deadline (max: disarm), with mx_ locked
+  bool arm(Clock::time_point deadline) noexcept {
+    itimerspec spec{};
+    if (deadline != Clock::time_point::max()) {
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+      if (ns <= 0) {
+        ns = 1;   // (0 would disarm)
+      }
+      spec.it_value.tv_sec = static_cast<time_t>(ns / 1'000'000'000);
+      spec.it_value.tv_nsec = static_cast<long>(ns % 1'000'000'000);
+    }
+    if (::timerfd_settime(fd_, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+      return false;
+    }
+    armedFor_ = deadline;
+    return true;
+  }
+#else
+  std::condition_variable armed_;   // deadline armed or interrupt()
+  bool interrupted_ = false;
+
+  // arm wait() for deadline (max: disarm), with mx_ locked
+  bool arm(Clock::time_point deadline) noexcept {
+    armedFor_ = deadline;
+    armed_.notify_all();
+    return true;
+  }
+#endif
+
+ public:
+#ifdef __linux__
+  TimerQueue() {
+    fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd_ < 0) {
+      throwErrno("timerfd_create()");
+    }
+  }
+
+  TimerQueue(const TimerQueue&) = delete;
+  TimerQueue& operator=(const TimerQueue&) = delete;
+
+  // queued nodes are never released
+  ~TimerQueue() {
+    ::close(fd_);
+  }
+
+  // readable when the earliest deadline passed
+  int fd() const noexcept {
+    return fd_;
+  }
+#else
+  TimerQueue() = default;
+  TimerQueue(const TimerQueue&) = delete;
+  TimerQueue& operator=(const TimerQueue&) = delete;
+
+  // block until the earliest deadline passed, interrupt() was called,
+  // or timeoutMs passed (-1: no timeout); then call expire()
+  void wait(int timeoutMs) {
+    auto until = timeoutMs < 0 ? Clock::time_point::max()
+                               : Clock::now() + std::chrono::milliseconds{timeoutMs};
+    std::unique_lock lock{mx_};
+    while (!interrupted_) {
+      auto due = armedFor_ < until ? armedFor_ : until;
+      if (due == Clock::time_point::max()) {
+        armed_.wait(lock);
+      }
+      else if (armed_.wait_until(lock, due) == std::cv_status::timeout || Clock::now() >= due) {
+        break;
+      }
+    }
+    interrupted_ = false;
+  }
+
+  // wake up a blocking wait()
+  void interrupt() noexcept {
+    std::lock_guard lock{mx_};
+    interrupted_ = true;
+    armed_.notify_all();
+  }
+#endif
+
+  std::size_t size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  // queue node (deadline and hdl set)
+  // - from now on, expire() might release it
+  void add(TimerQueueNode& node) {
+    std::lock_guard lock{mx_};
+    heap_.push(node);
+    if (node.deadline < armedFor_ && !arm(node.deadline)) {
+      heap_.remove(node);
+      throwErrno("timerfd_settime()");
+    }
+    size_.store(heap_.size(), std::memory_order_relaxed);
+  }
+
+  // dequeue node before its deadline (false if it expired already)
+  // (the timerfd stays armed: expire() then finds nothing)
+  bool remove(TimerQueueNode& node) noexcept {
+    std::lock_guard lock{mx_};
+    if (node.heapIndex == TimerQueueNode::notQueued) {
+      return false;
+    }
+    heap_.remove(node);
+    size_.store(heap_.size(), std::memory_order_relaxed);
+    return true;
+  }
+
+  // after the timerfd became readable (or wait() returned):
+  // dequeue all nodes whose deadline passed, release them,
+  // and pass those that are ready to resume to onReady(hdl)
+  // (called with the queue locked: must not add or remove timers)
+  // - returns the number of expired nodes
+  template <typename FN>
+  std::size_t expire(FN onReady) {
+#ifdef __linux__
+    std::uint64_t expirations;
+    [[maybe_unused]] auto ret = ::read(fd_, &expirations, sizeof(expirations));
+#endif
+    std::lock_guard lock{mx_};
+    std::size_t num = 0;
+    auto now = Clock::now();
+    while (!heap_.empty() && heap_.top().deadline <= now) {
+      TimerQueueNode& node = heap_.top();
+      heap_.remove(node);
+      ++num;
+      std::coroutine_handle<> hdl = node.hdl;   // (node is gone once released)
+      if (node.release()) {
+        onReady(hdl);
+      }
+    }
+    size_.store(heap_.size(), std::memory_order_relaxed);
+    // the timer is one-shot: arm it for the next deadline
+    // (if that fails, the next add() tries again)
+    if (!arm(heap_.empty() ? Clock::time_point::max() : heap_.top().deadline)) {
+      armedFor_ = Clock::time_point::max();
+    }
+    return num;
+  }
+};
+
+#endif
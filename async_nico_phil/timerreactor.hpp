@@ -0,0 +1,61 @@
+// portable reactor for the CoroScheduler: timers only
+//  - used where there is no epoll (see epollreactor.hpp for Linux):
+//    coroutines can wait for deadlines (see timerqueue.hpp), not for sockets
+//  - poll() is called by the scheduler like that of the epoll reactor:
+//    non-blocking between resuming coroutines and blocking by a worker
+//    that has nothing else to do, which waits on the condition variable
+//    of the timer queue until the next timer expires or interrupt()
+
+#ifndef INCLUDED_TIMER_REACTOR_HPP
+#define INCLUDED_TIMER_REACTOR_HPP
+
+#include "timerqueue.hpp"
+#include <coroutine>
+#include <vector>
+#include <cstddef>
+
+class TimerReactor {
+ private:
+  TimerQueue timers_;
+
+ public:
+  TimerReactor() = default;
+  TimerReactor(const TimerReactor&) = delete;
+  TimerReactor& operator=(const TimerReactor&) = delete;
+
+  // coroutines waiting for a deadline (see timerqueue.hpp)
+  TimerQueue& timers() noexcept {
+    return timers_;
+  }
+
+  // something to poll for: queued timers
+  bool hasWaiters() const noexcept {
+    return timers_.size() > 0;
+  }
+
+  // wait up to timeoutMs (-1: forever) for the next timer
+  // and pass the handles of the coroutines whose timers expired
+  // to onReady(vector of handles)
+  // - only one thread may poll at a time
+  // - returns the number of coroutines passed
+  template <typename FN>
+  std::size_t poll(int timeoutMs, FN onReady) {
+    timers_.wait(timeoutMs);
+    static thread_local std::vector<std::coroutine_handle<>> ready;
+    ready.clear();
+    timers_.expire([](std::coroutine_handle<> hdl) {
+      ready.push_back(hdl);
+    });
+    if (!ready.empty()) {
+      onReady(ready);
+    }
+    return ready.size();
+  }
+
+  // wake up a blocking poll()
+  void interrupt() noexcept {
+    timers_.interrupt();
+  }
+};
+
+#endif
@@ -0,0 +1,160 @@
+// random 4 KiB reads with io_uring from coroutines of the CoroScheduler
+//  - queue depth = number of coroutines reading concurrently (1 to 256)
+//  - once with plain reads, once with registered buffers and file
+//  - reads a temporary file in $TMPDIR (or /tmp), which is unlinked at once,
+//    or fileName, which is created or extended if it is too small
+//    (read with O_DIRECT if the file system supports it)
+// usage: uringbench [fileName|- [fileMiB [readsPerDepth [numWorkers]]]]  (-: temporary file)
+
+#include "coroscheduler.hpp"
+#include "iouring.hpp"
+#include "../bench/benchfixture.hpp"
+#include <iostream>
+#include <coroutine>
+#include <exception>
+#include <chrono>
+#include <latch>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using Clock = std::chrono::steady_clock;
+using Sched = CoroScheduler<>;
+
+constexpr std::size_t blockSize = 4096;
+constexpr unsigned maxDepth = 256;
+
+// unlinked temporary file in $TMPDIR (or /tmp), gone once it is closed
+int createTempFile(std::string& name)
+{
+  const char* dir = std::getenv("TMPDIR");
+  name = std::string{dir != nullptr && *dir != '\0' ? dir : "/tmp"} + "/uringbench.XXXXXX";
+  int fd = ::mkstemp(name.data());
+  if (fd >= 0) {
+    ::unlink(name.c_str());
+  }
+  return fd;
+}
+
+// fill the file with numBlocks blocks of non-zero data (unless it has them)
+void prepareFile(int fd, std::uint64_t numBlocks)
+{
+  struct stat st{};
+  if (::fstat(fd, &st) == 0
+      && static_cast<std::uint64_t>(st.st_size) >= numBlocks * blockSize) {
+    return;
+  }
+  std::vector<char> chunk(256 * blockSize);
+  for (std::size_t i = 0; i < chunk.size(); ++i) {
+    chunk[i] = static_cast<char>('a' + i % 26);
+  }
+  for (std::uint64_t b = 0; b < numBlocks; b += 256) {
+    std::size_t len = static_cast<std::size_t>(std::min<std::uint64_t>(256, numBlocks - b)) * blockSize;
+    if (::pwrite(fd, chunk.data(), len, static_cast<off_t>(b * blockSize)) < 0) {
+      throwIoError(errno, "pwrite()");
+    }
+  }
+  ::fsync(fd);
+}
+
+struct Run {
+  std::atomic<std::int64_t> remaining;
+  std::vector<std::vector<double>> latencyUs;   // per reader
+  std::uint64_t numBlocks;
+  std::atomic<std::uint64_t> bytes{0};
+};
+
+DetachedTask reader(Sched& sched, UringFile<Sched> file, bool fixed,
+                    std::span<std::byte> buf, int bufIndex,
+                    Run& run, unsigned id, std::latch& done)
+{
+  co_await sched.schedule();
+  std::uint64_t rnd = 0x9E3779B97F4A7C15u * (id + 1);
+  auto& latency = run.latencyUs[id];
+  while (run.remaining.fetch_sub(1, std::memory_order_relaxed) > 0) {
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 7;
+    rnd ^= rnd << 17;
+    std::uint64_t offset = (rnd % run.numBlocks) * blockSize;
+    auto start = Clock::now();
+    std::size_t n = fixed ? co_await file.readFixed(buf, bufIndex, offset)
+                          : co_await file.read(buf, offset);
+    std::chrono::duration<double, std::micro> us = Clock::now() - start;
+    latency.push_back(us.count());
+    run.bytes.fetch_add(n, std::memory_order_relaxed);
+  }
+  done.count_down();
+}
+
+int main(int argc, char* argv[])
+{
+  std::string fileName = argc > 1 ? argv[1] : "-";
+  std::uint64_t fileMiB = argc > 2 ? std::stoull(argv[2]) : 256;
+  std::int64_t readsPerDepth = argc > 3 ? std::stoll(argv[3]) : 50'000;
+  unsigned numWorkers = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4]))
+                                 : std::thread::hardware_concurrency();
+
+  std::uint64_t numBlocks = fileMiB * 1024 * 1024 / blockSize;
+  int fd = fileName == "-" ? createTempFile(fileName)
+                           : ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    throwIoError(errno, "open()");
+  }
+  prepareFile(fd, numBlocks);
+  // not supported e.g. by tmpfs:
+  bool direct = ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_DIRECT) == 0;
+
+  // one aligned 4 KiB buffer per reader:
+  auto* mem = static_cast<std::byte*>(std::aligned_alloc(blockSize, maxDepth * blockSize));
+  std::vector<iovec> iovecs(maxDepth);
+  for (unsigned i = 0; i < maxDepth; ++i) {
+    iovecs[i] = iovec{mem + i * blockSize, blockSize};
+  }
+
+  {
+    Sched sched{numWorkers};
+    IoUringService<Sched> io{sched, maxDepth};
+    io.registerBuffers(iovecs);
+    io.registerFiles(std::span<const int>{&fd, 1});
+
+    std::cout << fileName << ": " << fileMiB << " MiB" << (direct ? " (O_DIRECT)" : "")
+              << ", " << readsPerDepth << " random 4 KiB reads per queue depth, "
+              << sched.numWorkers() << " workers\n"
+              << "mode        QD     IOPS       MiB/s    p50 us   p99 us\n";
+    for (bool fixed : {false, true}) {
+      for (unsigned depth = 1; depth <= maxDepth; depth *= 2) {
+        Run run{{readsPerDepth}, std::vector<std::vector<double>>(depth), numBlocks};
+        std::latch done{static_cast<std::ptrdiff_t>(depth)};
+        auto start = Clock::now();
+        for (unsigned i = 0; i < depth; ++i) {
+          UringFile<Sched> file = fixed ? UringFile<Sched>{io, fd, 0} : UringFile<Sched>{io, fd};
+          reader(sched, file, fixed, {mem + i * blockSize, blockSize}, static_cast<int>(i),
+                 run, i, done);
+        }
+        done.wait();
+        std::chrono::duration<double> secs = Clock::now() - start;
+
+        std::vector<double> all;
+        for (auto& l : run.latencyUs) {
+          all.insert(all.end(), l.begin(), l.end());
+        }
+        std::sort(all.begin(), all.end());
+        double iops = static_cast<double>(all.size()) / secs.count();
+        std::cout << (fixed ? "registered " : "plain      ") << ' ' << depth << "\t"
+                  << static_cast<std::uint64_t>(iops) << "\t"
+                  << static_cast<double>(run.bytes.load()) / secs.count() / (1024 * 1024) << "\t"
+                  << all[all.size() / 2] << "\t"
+                  << all[all.size() * 99 / 100] << '\n';
+      }
+    }
+    std::cout << io.numCompleted() << " requests, " << io.averageSubmitBatch()
+              << " submitted per io_uring_enter() and " << io.averageBatch()
+              << " completions per batch on average\n";
+  }
+  ::close(fd);
+  std::free(mem);
+}
@@ -0,0 +1,321 @@
+// when_all() and when_any() for CoroTasks on the CoroScheduler
+//  - co_await when_all(sched, task1, task2, ...) starts all tasks at once
+//    and continues when all of them are done;
+//    it yields a std::tuple of the results (std::monostate for void tasks)
+//  - co_await when_all(sched, vectorOfTasks) yields a std::vector
+//    of the results (nothing for void tasks)
+//  - co_await when_any(sched, vectorOfTasks) continues as soon as
+//    the first task is done and yields its index and result (see WhenAnyResult);
+//    the other tasks are cancelled, but run until they notice
+//    (their frames are freed by the last one done)
+//  - the first task runs on the awaiting thread (symmetric transfer),
+//    the others are posted to the scheduler as one batch (see postAll())
+//  - the tasks notify a single atomic countdown from their final
+//    suspend point (see CoroTaskObserver), so there is neither a wrapper
+//    coroutine nor any other allocation per task
+//  - exceptions of the tasks are rethrown when the results are collected
+//    (when_all(): after all tasks are done, in argument order)
+//  - the tasks get the cancellation token of the awaiting coroutine
+//    (unless they have their own)
+
+#ifndef INCLUDED_WHEN_ALL_HPP
+#define INCLUDED_WHEN_ALL_HPP
+
+#include "corotask.hpp"
+#include "../awaiter_lewis/cancellation.hpp"
+#include <coroutine>
+#include <atomic>
+#include <array>
+#include <tuple>
+#include <vector>
+#include <variant>     // for std::monostate
+#include <ranges>
+#include <span>
+#include <utility>
+#include <type_traits>
+#include <stdexcept>
+#include <optional>
+#include <cstddef>
+
+// result of a task as element of the when_all() tuple
+template <typename T>
+using WhenAllElement = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+template <typename T, typename Instr>
+WhenAllElement<T> whenAllResult(CoroTask<T, Instr>& task)
+{
+  if constexpr (std::is_void_v<T>) {
+    task.getHandle().promise().result();
+    return {};
+  }
+  else {
+    return task.getHandle().promise().result();
+  }
+}
+
+// let the observer know when the task is done, pass on the cancellation token,
+// and return the handle of the task
+// (posted: true if the task is passed to the scheduler, false if it is resumed directly)
+template <typename T, typename Instr>
+std::coroutine_handle<> whenAllPrepare(CoroTask<T, Instr>& task, CoroTaskObserver& obs,
+                                       const cancellation_token* token, bool posted) noexcept
+{
+  auto hdl = task.getHandle();
+  hdl.promise().observer = &obs;
+  if (token != nullptr && !hdl.promise().cancelToken.can_be_cancelled()) {
+    hdl.promise().cancelToken = *token;
+  }
+  Instr::onEvent(posted ? CoroEvent::schedule : CoroEvent::resume,
+                 &hdl.promise().frameData, hdl.address());
+  return hdl;
+}
+
+// countdown of the tasks: the last one done continues with the waiting coroutine
+class WhenAllLatch final : public CoroTaskObserver {
+ private:
+  std::atomic<std::size_t> count_;
+  std::coroutine_handle<> waiting_;
+
+ public:
+  explicit WhenAllLatch(std::size_t count) noexcept
+   : count_{count} {
+  }
+
+  void setWaiting(std::coroutine_handle<> hdl) noexcept {
+    waiting_ = hdl;
+  }
+
+  std::coroutine_handle<> taskDone(void*) noexcept override {
+    if (count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      return waiting_;
+    }
+    return std::noop_coroutine();
+  }
+};
+
+
+//*** when_all(sched, tasks...)
+
+template <typename Sched, typename... Tasks>
+class WhenAllAwaiter {
+ private:
+  Sched& sched_;
+  std::tuple<Tasks...> tasks_;
+  WhenAllLatch latch_{sizeof...(Tasks)};
+
+ public:
+  explicit WhenAllAwaiter(Sched& sched, Tasks&&... tasks)
+   : sched_{sched}, tasks_{std::move(tasks)...} {
+  }
+
+  bool await_ready() const noexcept {
+    return sizeof...(Tasks) == 0;
+  }
+
+  template <typename Promise>
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> waiting) {
+    latch_.setWaiting(waiting);
+    const cancellation_token* token = cancellation_token_of(waiting);
+    std::array<std::coroutine_handle<>, sizeof...(Tasks)> hdls;
+    std::apply([&](auto&... tasks) {
+                 std::size_t idx = 0;
+                 ((hdls[idx] = whenAllPrepare(tasks, latch_, token, idx > 0), ++idx), ...);
+               },
+               tasks_);
+    // nobody can continue the waiting coroutine before the first task ran:
+    sched_.postAll(std::span{hdls}.subspan(1));
+    return hdls[0];
+  }
+
+  auto await_resume() {
+    return std::apply([](auto&... tasks) {
+                        // braced initialization: results are collected in order
+                        return std::tuple<decltype(whenAllResult(tasks))...>{whenAllResult(tasks)...};
+                      },
+                      tasks_);
+  }
+};
+
+template <typename Sched, typename... Tasks>
+[[nodiscard]] WhenAllAwaiter<Sched, Tasks...> when_all(Sched& sched, Tasks... tasks)
+{
+  return WhenAllAwaiter<Sched, Tasks...>{sched, std::move(tasks)...};
+}
+
+
+//*** when_all(sched, vectorOfTasks)
+
+template <typename Sched, typename T, typename Instr>
+class WhenAllRangeAwaiter {
+ private:
+  Sched& sched_;
+  std::vector<CoroTask<T, Instr>> tasks_;
+  WhenAllLatch latch_;
+
+ public:
+  WhenAllRangeAwaiter(Sched& sched, std::vector<CoroTask<T, Instr>>&& tasks)
+   : sched_{sched}, tasks_{std::move(tasks)}, latch_{tasks_.size()} {
+  }
+
+  bool await_ready() const noexcept {
+    return tasks_.empty();
+  }
+
+  template <typename Promise>
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> waiting) {
+    latch_.setWaiting(waiting);
+    const cancellation_token* token = cancellation_token_of(waiting);
+    std::coroutine_handle<> first = whenAllPrepare(tasks_.front(), latch_, token, false);
+    // nobody can continue the waiting coroutine before the first task ran:
+    sched_.postAll(tasks_ | std::views::drop(1)
+                          | std::views::transform([this, token](CoroTask<T, Instr>& task) {
+                              return whenAllPrepare(task, latch_, token, true);
+                            }));
+    return first;
+  }
+
+  auto await_resume() {
+    if constexpr (std::is_void_v<T>) {
+      for (auto& task : tasks_) {
+        task.getHandle().promise().result();
+      }
+    }
+    else {
+      std::vector<T> results;
+      results.reserve(tasks_.size());
+      for (auto& task : tasks_) {
+        results.push_back(task.getHandle().promise().result());
+      }
+      return results;
+    }
+  }
+};
+
+template <typename Sched, typename T, typename Instr>
+[[nodiscard]] WhenAllRangeAwaiter<Sched, T, Instr>
+when_all(Sched& sched, std::vector<CoroTask<T, Instr>> tasks)
+{
+  return WhenAllRangeAwaiter<Sched, T, Instr>{sched, std::move(tasks)};
+}
+
+
+//*** when_any(sched, vectorOfTasks)
+
+template <typename T>
+struct WhenAnyResult {
+  std::size_t index;   // index of the first task done
+  T value;
+};
+
+template <>
+struct WhenAnyResult<void> {
+  std::size_t index;
+};
+
+template <typename Sched, typename T, typename Instr>
+class WhenAnyAwaiter {
+ private:
+  // shared by the awaiter and the tasks (tasks that lose the race
+  // run until they notice the cancellation): the last one frees it
+  class State final : public CoroTaskObserver {
+   public:
+    std::vector<CoroTask<T, Instr>> tasks;
+    std::atomic<std::size_t> refs;              // tasks not done + the awaiter
+    std::atomic<void*> winner{nullptr};         // first task done
+    std::coroutine_handle<> waiting;
+    // cancels the other tasks (and is cancelled with the awaiting coroutine):
+    cancellation_source source;
+    cancellation_token token = source.token();
+    std::optional<cancellation_registration> waitingCancelled;
+
+    explicit State(std::vector<CoroTask<T, Instr>>&& t)
+     : tasks{std::move(t)}, refs{tasks.size() + 1} {
+    }
+
+    std::coroutine_handle<> taskDone(void* task) noexcept override {
+      std::coroutine_handle<> next = std::noop_coroutine();
+      void* none = nullptr;
+      if (winner.compare_exchange_strong(none, task, std::memory_order_acq_rel)) {
+        next = waiting;
+      }
+      // the winner never frees the state (the awaiter still holds its reference):
+      if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+      }
+      return next;
+    }
+  };
+
+  Sched& sched_;
+  State* state_;
+  bool started_ = false;
+
+ public:
+  WhenAnyAwaiter(Sched& sched, std::vector<CoroTask<T, Instr>>&& tasks)
+   : sched_{sched}, state_{new State{std::move(tasks)}} {
+  }
+
+  WhenAnyAwaiter(const WhenAnyAwaiter&) = delete;
+  WhenAnyAwaiter& operator=(const WhenAnyAwaiter&) = delete;
+
+  ~WhenAnyAwaiter() {
+    if (!started_ || state_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete state_;
+    }
+  }
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  template <typename Promise>
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> waiting) {
+    started_ = true;
+    // another task might continue the waiting coroutine (and destroy this awaiter)
+    // while the first one is still not started, so only use the state from here:
+    State* state = state_;
+    state->waiting = waiting;
+    if (const cancellation_token* token = cancellation_token_of(waiting)) {
+      state->waitingCancelled.emplace(*token, [state] {
+                                        state->source.request_cancellation();
+                                      });
+    }
+    std::coroutine_handle<> first = whenAllPrepare(state->tasks.front(), *state,
+                                                   &state->token, false);
+    sched_.postAll(state->tasks | std::views::drop(1)
+                                | std::views::transform([state](CoroTask<T, Instr>& task) {
+                                    return whenAllPrepare(task, *state, &state->token, true);
+                                  }));
+    return first;
+  }
+
+  WhenAnyResult<T> await_resume() {
+    // the other tasks are wasted work now
+    // (cancellable waits of them resume in this thread):
+    state_->source.request_cancellation();
+    void* winner = state_->winner.load(std::memory_order_acquire);
+    std::size_t idx = 0;
+    while (state_->tasks[idx].getHandle().address() != winner) {
+      ++idx;
+    }
+    if constexpr (std::is_void_v<T>) {
+      state_->tasks[idx].getHandle().promise().result();
+      return WhenAnyResult<void>{idx};
+    }
+    else {
+      return WhenAnyResult<T>{idx, state_->tasks[idx].getHandle().promise().result()};
+    }
+  }
+};
+
+template <typename Sched, typename T, typename Instr>
+[[nodiscard]] WhenAnyAwaiter<Sched, T, Instr>
+when_any(Sched& sched, std::vector<CoroTask<T, Instr>> tasks)
+{
+  if (tasks.empty()) {
+    throw std::invalid_argument{"when_any() without tasks"};
+  }
+  return WhenAnyAwaiter<Sched, T, Instr>{sched, std::move(tasks)};
+}
+
+#endif
@@ -0,0 +1,131 @@
+// fan-out/gather latency: awaiting child tasks one after the other
+// versus when_all() (and when_any()) on the CoroScheduler
+//  - each child hops onto the scheduler and spins for a given time
+//  - also checks results, result order, and exception propagation
+// usage: whenallbench [numChildren [workMicroseconds [numWorkers [rounds]]]]
+
+#include "corotask.hpp"
+#include "coroscheduler.hpp"
+#include "syncwait.hpp"
+#include "whenall.hpp"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+using Sched = CoroScheduler<>;
+
+CoroTask<std::uint64_t> child(Sched& sched, std::uint64_t id, std::chrono::microseconds work)
+{
+  co_await sched.schedule();
+  auto end = Clock::now() + work;
+  while (Clock::now() < end) {
+  }
+  co_return id;
+}
+
+CoroTask<std::uint64_t> serial(Sched& sched, unsigned num, std::chrono::microseconds work)
+{
+  std::uint64_t sum = 0;
+  for (unsigned i = 0; i < num; ++i) {
+    sum += co_await child(sched, i, work);
+  }
+  co_return sum;
+}
+
+CoroTask<std::uint64_t> fanOut(Sched& sched, unsigned num, std::chrono::microseconds work)
+{
+  std::vector<CoroTask<std::uint64_t>> children;
+  children.reserve(num);
+  for (unsigned i = 0; i < num; ++i) {
+    children.push_back(child(sched, i, work));
+  }
+  std::vector<std::uint64_t> results = co_await when_all(sched, std::move(children));
+  std::uint64_t sum = 0;
+  for (unsigned i = 0; i < num; ++i) {
+    if (results[i] != i) {
+      throw std::logic_error{"when_all(): results out of order"};
+    }
+    sum += results[i];
+  }
+  co_return sum;
+}
+
+CoroTask<> failing(Sched& sched)
+{
+  co_await sched.schedule();
+  throw std::runtime_error{"child failed"};
+}
+
+CoroTask<bool> checks(Sched& sched)
+{
+  using namespace std::chrono_literals;
+  // heterogeneous results:
+  auto [i, s, v] = co_await when_all(sched, child(sched, 42, 0us),
+                                     []() -> CoroTask<std::string> { co_return "str"; }(),
+                                     []() -> CoroTask<> { co_return; }());
+  bool ok = i == 42 && s == "str";
+  (void)v;
+
+  // exceptions are rethrown after all children are done:
+  try {
+    co_await when_all(sched, child(sched, 1, 100us), failing(sched));
+    ok = false;
+  }
+  catch (const std::runtime_error&) {
+  }
+
+  // first one done wins (the others keep running):
+  std::vector<CoroTask<std::uint64_t>> racers;
+  racers.push_back(child(sched, 0, 20ms));
+  racers.push_back(child(sched, 1, 0us));
+  auto first = co_await when_any(sched, std::move(racers));
+  ok = ok && first.index == first.value;
+  co_return ok;
+}
+
+template <typename FN>
+double measureUs(unsigned rounds, std::uint64_t expected, FN fn)
+{
+  double best = 1e300;
+  for (unsigned r = 0; r < rounds; ++r) {
+    auto start = Clock::now();
+    std::uint64_t sum = fn();
+    std::chrono::duration<double, std::micro> us = Clock::now() - start;
+    if (sum != expected) {
+      std::cerr << "WRONG SUM\n";
+      std::exit(EXIT_FAILURE);
+    }
+    best = std::min(best, us.count());
+  }
+  return best;
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned num = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 16;
+  std::chrono::microseconds work{argc > 2 ? std::stol(argv[2]) : 100};
+  unsigned numWorkers = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3]))
+                                 : std::thread::hardware_concurrency();
+  unsigned rounds = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : 20;
+
+  Sched sched{numWorkers};
+  if (!sync_wait(checks(sched))) {
+    std::cerr << "checks FAILED\n";
+    return EXIT_FAILURE;
+  }
+
+  std::uint64_t expected = std::uint64_t{num} * (num - 1) / 2;
+  double serialUs = measureUs(rounds, expected, [&] { return sync_wait(serial(sched, num, work)); });
+  double fanOutUs = measureUs(rounds, expected, [&] { return sync_wait(fanOut(sched, num, work)); });
+  std::cout << num << " children of " << work.count() << " us each, "
+            << sched.numWorkers() << " worker(s), best of " << rounds << ":\n"
+            << "  serial co_await: " << serialUs << " us\n"
+            << "  when_all():      " << fanOutUs << " us\n";
+}
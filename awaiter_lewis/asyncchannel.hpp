@@ -0,0 +1,751 @@
+// async_channel<T>: bounded multi-producer multi-consumer channel for coroutines
+//  - co_await ch.send(value) suspends the coroutine while the channel is full,
+//    co_await ch.recv() suspends it while the channel is empty
+//    (instead of blocking the thread)
+//  - co_await ch.recv_batch(out, maxCount) appends up to maxCount elements
+//    to out, suspending only if there is none yet: a resumed consumer
+//    drains all that arrived meanwhile (claiming them with one CAS)
+//  - close(): sending fails from then on (send() returns false),
+//    receivers get the remaining elements, then std::nullopt (or 0);
+//    producers should close after their last send
+//    (a send racing with close() might never be received)
+//  - elements are moved in and out, never copied
+//    (T has to be nothrow move constructible)
+//  - fast path: a lock-free ring buffer with a sequence number per slot
+//    (capacity rounded up to a power of two), one CAS per send and receive
+//  - slow path: waiters are awaiter objects in the coroutine frames,
+//    linked into an intrusive FIFO list (no allocation);
+//    a receiver (sender) that finds the ring empty (full) registers
+//    under a mutex and retries; each send (receive) then checks for waiting
+//    receivers (senders) after a fence, so no wake-up is lost;
+//    an element goes directly into the frame of the receiver it wakes
+//    and a waiting sender's element into the ring
+//  - waiters are resumed in the thread that made them ready,
+//    or with async_channel(capacity, executor) handed to the executor
+//    (postAll() like async_manual_reset_event::set(executor))
+// see: Dmitry Vyukov's bounded MPMC queue:
+//  https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+
+#ifndef INCLUDED_ASYNC_CHANNEL_HPP
+#define INCLUDED_ASYNC_CHANNEL_HPP
+
+#include <coroutine>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <new>       // for std::launder()
+#include <bit>
+#include <cstddef>
+
+template <typename T>
+class async_channel
+{
+  static_assert(std::is_nothrow_move_constructible_v<T>,
+                "elements of an async_channel have to be nothrow move constructible");
+
+public:
+
+  explicit async_channel(std::size_t capacity);
+
+  // waiters are handed to executor, which has to provide
+  //   postAll(range of std::coroutine_handle<>)
+  template <typename Executor>
+  async_channel(std::size_t capacity, Executor& executor);
+
+  // No copying/moving
+  async_channel(const async_channel&) = delete;
+  async_channel(async_channel&&) = delete;
+  async_channel& operator=(const async_channel&) = delete;
+  async_channel& operator=(async_channel&&) = delete;
+
+  // there must be no waiters when destroyed
+  ~async_channel();
+
+  class send_awaiter;
+  class recv_awaiter;
+  class recv_batch_awaiter;
+
+  // co_await returns false if the channel is closed (value is not sent then)
+  send_awaiter send(T value) noexcept;
+
+  // co_await returns std::nullopt if the channel is closed and empty
+  recv_awaiter recv() noexcept;
+
+  // co_await returns the number of elements appended to out
+  // (0 if the channel is closed and empty)
+  recv_batch_awaiter recv_batch(std::vector<T>& out, std::size_t maxCount) noexcept;
+
+  // without suspending:
+  // - try_send() moves value away only if it returns true
+  bool try_send(T& value);
+  std::optional<T> try_recv();
+
+  void close();
+  bool is_closed() const noexcept {
+    return m_closed.load(std::memory_order_acquire);
+  }
+
+  std::size_t capacity() const noexcept {
+    return m_mask + 1;
+  }
+
+private:
+
+  struct waiter
+  {
+    std::coroutine_handle<> m_awaitingCoroutine;
+    waiter* m_next = nullptr;
+    waiter* m_prev = nullptr;
+  };
+
+  struct recv_waiter : waiter
+  {
+    std::optional<T> m_value;   // what a sender handed over
+  };
+
+  struct send_waiter : waiter
+  {
+    explicit send_waiter(T&& value) noexcept
+    : m_value(std::move(value))
+    {}
+    T m_value;
+    bool m_sent = false;
+  };
+
+  // FIFO list of waiters (only accessed with m_mutex locked)
+  class waiter_list
+  {
+  public:
+    bool empty() const noexcept {
+      return m_first == nullptr;
+    }
+    waiter* front() const noexcept {
+      return m_first;
+    }
+    std::size_t size() const noexcept {
+      return m_size;
+    }
+    void push_back(waiter* w) noexcept {
+      w->m_next = nullptr;
+      w->m_prev = m_last;
+      (m_last != nullptr ? m_last->m_next : m_first) = w;
+      m_last = w;
+      ++m_size;
+    }
+    void remove(waiter* w) noexcept {
+      (w->m_prev != nullptr ? w->m_prev->m_next : m_first) = w->m_next;
+      (w->m_next != nullptr ? w->m_next->m_prev : m_last) = w->m_prev;
+      --m_size;
+    }
+
+  private:
+    waiter* m_first = nullptr;
+    waiter* m_last = nullptr;
+    std::size_t m_size = 0;
+  };
+
+  // waiters to resume, linked with m_next
+  // (collected with m_mutex locked, resumed after unlocking it)
+  class ready_list
+  {
+  public:
+    void push_back(waiter* w) noexcept {
+      w->m_next = nullptr;
+      (m_last != nullptr ? m_last->m_next : m_first) = w;
+      m_last = w;
+    }
+    waiter* take() noexcept {
+      m_last = nullptr;
+      return std::exchange(m_first, nullptr);
+    }
+
+  private:
+    waiter* m_first = nullptr;
+    waiter* m_last = nullptr;
+  };
+
+  // input range over ready waiters
+  // (the successor is read before a handle is handed out,
+  //  because resuming the coroutine will likely destroy the awaiter object)
+  class handle_range
+  {
+  public:
+    class iterator
+    {
+    public:
+      using value_type = std::coroutine_handle<>;
+      using difference_type = std::ptrdiff_t;
+
+      iterator() noexcept = default;
+      explicit iterator(waiter* first) noexcept
+      : m_current(first), m_next(first != nullptr ? first->m_next : nullptr)
+      {}
+
+      std::coroutine_handle<> operator*() const noexcept {
+        return m_current->m_awaitingCoroutine;
+      }
+      iterator& operator++() noexcept {
+        m_current = m_next;
+        m_next = m_current != nullptr ? m_current->m_next : nullptr;
+        return *this;
+      }
+      void operator++(int) noexcept {
+        ++*this;
+      }
+      bool operator==(std::default_sentinel_t) const noexcept {
+        return m_current == nullptr;
+      }
+
+    private:
+      waiter* m_current = nullptr;
+      waiter* m_next = nullptr;
+    };
+
+    explicit handle_range(waiter* first) noexcept
+    : m_first(first)
+    {}
+
+    iterator begin() const noexcept { return iterator{m_first}; }
+    std::default_sentinel_t end() const noexcept { return {}; }
+
+  private:
+    waiter* m_first;
+  };
+
+  struct slot
+  {
+    std::atomic<std::size_t> m_seq;
+    alignas(T) std::byte m_storage[sizeof(T)];
+
+    T* get() noexcept {
+      return std::launder(reinterpret_cast<T*>(m_storage));
+    }
+  };
+
+  // ring buffer:
+  // - slot of position pos: m_slots[pos & m_mask]
+  // - m_seq == pos: free for the element of position pos
+  // - m_seq == pos + 1: holds the element of position pos
+  bool try_push(T& value) noexcept;
+  bool try_pop(std::optional<T>& value) noexcept;
+  std::size_t try_pop_batch(std::vector<T>& out, std::size_t maxCount);
+
+  // after a send (receive): hand elements (space) to waiting receivers (senders)
+  void notify_receivers();
+  void notify_senders();
+  // with m_mutex locked:
+  void serve_receivers(ready_list& ready) noexcept;
+  void serve_senders(ready_list& ready) noexcept;
+  void set_waiting_counts() noexcept;
+
+  // slow paths of the awaiters (true: stay suspended)
+  bool suspend_receiver(recv_waiter& w, std::coroutine_handle<> awaitingCoroutine);
+  bool suspend_sender(send_waiter& w, std::coroutine_handle<> awaitingCoroutine);
+
+  void resume(waiter* first);
+
+  alignas(64) std::atomic<std::size_t> m_tail{0};   // next position to send
+  alignas(64) std::atomic<std::size_t> m_head{0};   // next position to receive
+  alignas(64) std::size_t m_mask;
+  std::unique_ptr<slot[]> m_slots;
+
+  // number of waiters in the lists (written with m_mutex locked,
+  // read without it after a fence to see whether there is anything to do)
+  std::atomic<std::size_t> m_recvWaiting{0};
+  std::atomic<std::size_t> m_sendWaiting{0};
+  std::atomic<bool> m_closed{false};
+
+  std::mutex m_mutex;
+  waiter_list m_receivers;
+  waiter_list m_senders;
+
+  void* m_executor = nullptr;
+  void (*m_postAll)(void* executor, handle_range hdls) = nullptr;
+
+};
+
+template <typename T>
+class async_channel<T>::send_awaiter : private async_channel<T>::send_waiter
+{
+public:
+  send_awaiter(async_channel& channel, T&& value) noexcept
+  : send_waiter(std::move(value)), m_channel(channel)
+  {}
+
+  bool await_ready() {
+    if (m_channel.is_closed()) {
+      return true;
+    }
+    if (m_channel.try_push(this->m_value)) {
+      this->m_sent = true;
+      m_channel.notify_receivers();
+      return true;
+    }
+    return false;
+  }
+  bool await_suspend(std::coroutine_handle<> awaitingCoroutine) {
+    return m_channel.suspend_sender(*this, awaitingCoroutine);
+  }
+  bool await_resume() const noexcept {
+    return this->m_sent;
+  }
+
+private:
+  async_channel& m_channel;
+};
+
+template <typename T>
+class async_channel<T>::recv_awaiter : private async_channel<T>::recv_waiter
+{
+public:
+  explicit recv_awaiter(async_channel& channel) noexcept
+  : m_channel(channel)
+  {}
+
+  bool await_ready() {
+    if (m_channel.try_pop(this->m_value)) {
+      m_channel.notify_senders();
+      return true;
+    }
+    if (m_channel.is_closed()) {
+      // (elements sent before close() might have arrived meanwhile)
+      if (m_channel.try_pop(this->m_value)) {
+        m_channel.notify_senders();
+      }
+      return true;
+    }
+    return false;
+  }
+  bool await_suspend(std::coroutine_handle<> awaitingCoroutine) {
+    return m_channel.suspend_receiver(*this, awaitingCoroutine);
+  }
+  std::optional<T> await_resume() noexcept {
+    return std::move(this->m_value);
+  }
+
+private:
+  async_channel& m_channel;
+};
+
+template <typename T>
+class async_channel<T>::recv_batch_awaiter : private async_channel<T>::recv_waiter
+{
+public:
+  recv_batch_awaiter(async_channel& channel, std::vector<T>& out, std::size_t maxCount) noexcept
+  : m_channel(channel), m_out(out), m_maxCount(std::max<std::size_t>(maxCount, 1))
+  {}
+
+  bool await_ready() {
+    m_received = m_channel.try_pop_batch(m_out, m_maxCount);
+    if (m_received > 0) {
+      m_channel.notify_senders();
+      return true;
+    }
+    if (m_channel.is_closed()) {
+      drain();   // (elements sent before close() might have arrived meanwhile)
+      return true;
+    }
+    return false;
+  }
+  bool await_suspend(std::coroutine_handle<> awaitingCoroutine) {
+    return m_channel.suspend_receiver(*this, awaitingCoroutine);
+  }
+  std::size_t await_resume() {
+    if (this->m_value) {
+      m_out.push_back(std::move(*this->m_value));
+      this->m_value.reset();
+      ++m_received;
+    }
+    // also take what arrived since we were handed an element:
+    if (m_received > 0 && m_received < m_maxCount) {
+      drain();
+    }
+    return m_received;
+  }
+
+private:
+  std::size_t drain() {
+    std::size_t num = m_channel.try_pop_batch(m_out, m_maxCount - m_received);
+    if (num > 0) {
+      m_received += num;
+      m_channel.notify_senders();
+    }
+    return num;
+  }
+
+  async_channel& m_channel;
+  std::vector<T>& m_out;
+  std::size_t m_maxCount;
+  std::size_t m_received = 0;
+};
+
+template <typename T>
+inline async_channel<T>::async_channel(std::size_t capacity)
+: m_mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1),
+  m_slots(new slot[m_mask + 1])
+{
+  for (std::size_t i = 0; i <= m_mask; ++i)
+  {
+    m_slots[i].m_seq.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+template <typename Executor>
+inline async_channel<T>::async_channel(std::size_t capacity, Executor& executor)
+: async_channel(capacity)
+{
+  m_executor = &executor;
+  m_postAll = [](void* ex, handle_range hdls) {
+    static_cast<Executor*>(ex)->postAll(hdls);
+  };
+}
+
+template <typename T>
+inline async_channel<T>::~async_channel()
+{
+  std::size_t tail = m_tail.load(std::memory_order_acquire);
+  for (std::size_t pos = m_head.load(std::memory_order_acquire); pos != tail; ++pos)
+  {
+    std::destroy_at(m_slots[pos & m_mask].get());
+  }
+}
+
+template <typename T>
+inline typename async_channel<T>::send_awaiter async_channel<T>::send(T value) noexcept
+{
+  return send_awaiter{*this, std::move(value)};
+}
+
+template <typename T>
+inline typename async_channel<T>::recv_awaiter async_channel<T>::recv() noexcept
+{
+  return recv_awaiter{*this};
+}
+
+template <typename T>
+inline typename async_channel<T>::recv_batch_awaiter
+async_channel<T>::recv_batch(std::vector<T>& out, std::size_t maxCount) noexcept
+{
+  return recv_batch_awaiter{*this, out, maxCount};
+}
+
+template <typename T>
+inline bool async_channel<T>::try_send(T& value)
+{
+  if (is_closed() || !try_push(value))
+  {
+    return false;
+  }
+  notify_receivers();
+  return true;
+}
+
+template <typename T>
+inline std::optional<T> async_channel<T>::try_recv()
+{
+  std::optional<T> value;
+  if (try_pop(value))
+  {
+    notify_senders();
+  }
+  return value;
+}
+
+template <typename T>
+inline bool async_channel<T>::try_push(T& value) noexcept
+{
+  std::size_t pos = m_tail.load(std::memory_order_relaxed);
+  slot* s;
+  while (true)
+  {
+    s = &m_slots[pos & m_mask];
+    std::size_t seq = s->m_seq.load(std::memory_order_acquire);
+    auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+    if (diff == 0)
+    {
+      if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      return false;   // full (or the receiver of this slot isn't done yet)
+    }
+    else
+    {
+      pos = m_tail.load(std::memory_order_relaxed);
+    }
+  }
+  std::construct_at(s->get(), std::move(value));
+  s->m_seq.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+inline bool async_channel<T>::try_pop(std::optional<T>& value) noexcept
+{
+  std::size_t pos = m_head.load(std::memory_order_relaxed);
+  slot* s;
+  while (true)
+  {
+    s = &m_slots[pos & m_mask];
+    std::size_t seq = s->m_seq.load(std::memory_order_acquire);
+    auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+    if (diff == 0)
+    {
+      if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    else if (diff < 0)
+    {
+      return false;   // empty (or the sender of this slot isn't done yet)
+    }
+    else
+    {
+      pos = m_head.load(std::memory_order_relaxed);
+    }
+  }
+  value.emplace(std::move(*s->get()));
+  std::destroy_at(s->get());
+  s->m_seq.store(pos + m_mask + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+inline std::size_t async_channel<T>::try_pop_batch(std::vector<T>& out, std::size_t maxCount)
+{
+  maxCount = std::min(maxCount, m_mask + 1);
+  std::size_t pos = m_head.load(std::memory_order_relaxed);
+  std::size_t num;
+  while (true)
+  {
+    // count the consecutive filled slots and claim them at once
+    // (nobody else can take them once the CAS succeeded)
+    num = 0;
+    while (num < maxCount
+           && m_slots[(pos + num) & m_mask].m_seq.load(std::memory_order_acquire) == pos + num + 1)
+    {
+      ++num;
+    }
+    if (num == 0)
+    {
+      std::size_t seq = m_slots[pos & m_mask].m_seq.load(std::memory_order_acquire);
+      if (static_cast<std::ptrdiff_t>(seq - (pos + 1)) < 0)
+      {
+        return 0;   // empty
+      }
+      pos = m_head.load(std::memory_order_relaxed);
+      continue;
+    }
+    out.reserve(out.size() + num);   // (may throw: before claiming anything)
+    if (m_head.compare_exchange_weak(pos, pos + num, std::memory_order_relaxed))
+    {
+      break;
+    }
+  }
+  for (std::size_t i = 0; i < num; ++i)
+  {
+    slot& s = m_slots[(pos + i) & m_mask];
+    out.push_back(std::move(*s.get()));
+    std::destroy_at(s.get());
+    s.m_seq.store(pos + i + m_mask + 1, std::memory_order_release);
+  }
+  return num;
+}
+
+template <typename T>
+inline void async_channel<T>::set_waiting_counts() noexcept
+{
+  m_recvWaiting.store(m_receivers.size(), std::memory_order_relaxed);
+  m_sendWaiting.store(m_senders.size(), std::memory_order_relaxed);
+}
+
+template <typename T>
+inline void async_channel<T>::serve_receivers(ready_list& ready) noexcept
+{
+  while (!m_receivers.empty())
+  {
+    auto* w = static_cast<recv_waiter*>(m_receivers.front());
+    if (!try_pop(w->m_value))
+    {
+      break;
+    }
+    m_receivers.remove(w);
+    ready.push_back(w);
+  }
+}
+
+template <typename T>
+inline void async_channel<T>::serve_senders(ready_list& ready) noexcept
+{
+  while (!m_senders.empty())
+  {
+    auto* w = static_cast<send_waiter*>(m_senders.front());
+    if (!try_push(w->m_value))
+    {
+      break;
+    }
+    w->m_sent = true;
+    m_senders.remove(w);
+    ready.push_back(w);
+  }
+}
+
+template <typename T>
+inline void async_channel<T>::notify_receivers()
+{
+  // pairs with the fence in suspend_receiver():
+  // either it sees our element or we see its registration
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_recvWaiting.load(std::memory_order_relaxed) == 0)
+  {
+    return;
+  }
+  ready_list ready;
+  {
+    std::lock_guard lock{m_mutex};
+    serve_receivers(ready);
+    set_waiting_counts();
+  }
+  resume(ready.take());
+}
+
+template <typename T>
+inline void async_channel<T>::notify_senders()
+{
+  // pairs with the fence in suspend_sender()
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_sendWaiting.load(std::memory_order_relaxed) == 0)
+  {
+    return;
+  }
+  ready_list ready;
+  {
+    std::lock_guard lock{m_mutex};
+    serve_senders(ready);
+    set_waiting_counts();
+  }
+  resume(ready.take());
+}
+
+template <typename T>
+inline bool async_channel<T>::suspend_receiver(recv_waiter& w,
+                                               std::coroutine_handle<> awaitingCoroutine)
+{
+  w.m_awaitingCoroutine = awaitingCoroutine;
+  ready_list ready;
+  {
+    std::lock_guard lock{m_mutex};
+    if (!m_closed.load(std::memory_order_relaxed))
+    {
+      m_receivers.push_back(&w);
+      set_waiting_counts();
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!try_pop(w.m_value))
+      {
+        // a sender will hand us an element
+        // (and might resume us as soon as we unlock)
+        return true;
+      }
+      m_receivers.remove(&w);
+    }
+    else if (!try_pop(w.m_value))
+    {
+      return false;   // closed and empty
+    }
+    // we made room:
+    serve_senders(ready);
+    set_waiting_counts();
+  }
+  resume(ready.take());
+  return false;
+}
+
+template <typename T>
+inline bool async_channel<T>::suspend_sender(send_waiter& w,
+                                             std::coroutine_handle<> awaitingCoroutine)
+{
+  w.m_awaitingCoroutine = awaitingCoroutine;
+  ready_list ready;
+  {
+    std::lock_guard lock{m_mutex};
+    if (m_closed.load(std::memory_order_relaxed))
+    {
+      return false;
+    }
+    m_senders.push_back(&w);
+    set_waiting_counts();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!try_push(w.m_value))
+    {
+      // a receiver will make room for us
+      return true;
+    }
+    w.m_sent = true;
+    m_senders.remove(&w);
+    serve_receivers(ready);
+    set_waiting_counts();
+  }
+  resume(ready.take());
+  return false;
+}
+
+template <typename T>
+inline void async_channel<T>::close()
+{
+  ready_list ready;
+  {
+    std::lock_guard lock{m_mutex};
+    if (m_closed.exchange(true, std::memory_order_acq_rel))
+    {
+      return;
+    }
+    // receivers get what is left, then std::nullopt,
+    // waiting senders fail
+    serve_receivers(ready);
+    while (!m_receivers.empty())
+    {
+      waiter* w = m_receivers.front();
+      m_receivers.remove(w);
+      ready.push_back(w);
+    }
+    while (!m_senders.empty())
+    {
+      waiter* w = m_senders.front();
+      m_senders.remove(w);
+      ready.push_back(w);
+    }
+    set_waiting_counts();
+  }
+  resume(ready.take());
+}
+
+template <typename T>
+inline void async_channel<T>::resume(waiter* first)
+{
+  if (first == nullptr)
+  {
+    return;
+  }
+  if (m_postAll != nullptr)
+  {
+    m_postAll(m_executor, handle_range{first});
+    return;
+  }
+  for (std::coroutine_handle<> hdl : handle_range{first})
+  {
+    hdl.resume();  // BLOCKS until the waiter suspends again or ends
+  }
+}
+
+#endif
@@ -0,0 +1,369 @@
+// async_manual_reset_event from the blog post 'Understanding Awaitables'
+// https://lewissbaker.github.io/2017/11/17/understanding-operator-co-await
+//
+// Copyright (c) Lewis Baker
+//
+// extended by:
+//  - set(executor) hands all waiters to an executor in one batch
+//    (e.g. CoroScheduler::postAll()), so that the producer returns
+//    immediately and the waiters resume in parallel on its workers
+//    (set() resumes them one after the other in the calling thread)
+//  - waits of coroutines with a cancellation token (see cancellation.hpp)
+//    are cancellable: the cancelled waiter is unlinked from the list at once
+//    and resumed with operation_cancelled
+//    (while it's unlinked, the low bit of m_state marks the list as being
+//     edited; waiters and set() spin meanwhile, other waits stay lock-free)
+
+#ifndef INCLUDED_ASYNC_EVENT_HPP
+#define INCLUDED_ASYNC_EVENT_HPP
+
+#include "cancellation.hpp"
+#include <coroutine>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <iterator>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+class async_manual_reset_event
+{
+public:
+
+  async_manual_reset_event(bool initiallySet = false) noexcept;
+
+  // No copying/moving
+  async_manual_reset_event(const async_manual_reset_event&) = delete;
+  async_manual_reset_event(async_manual_reset_event&&) = delete;
+  async_manual_reset_event& operator=(const async_manual_reset_event&) = delete;
+  async_manual_reset_event& operator=(async_manual_reset_event&&) = delete;
+
+  bool is_set() const noexcept;
+
+  struct awaiter;
+  awaiter operator co_await() const noexcept;
+
+  // resume all waiters in the calling thread
+  void set() noexcept;
+
+  // hand all waiters to the executor, which has to provide
+  //   postAll(range of std::coroutine_handle<>) noexcept
+  // (it must not lose waiters, e.g. resume those it can't post)
+  template <typename Executor>
+  void set(Executor& executor) noexcept;
+
+  void reset() noexcept;
+
+private:
+
+  friend struct awaiter;
+
+  class waiter_range;
+
+  // set the state and take the list of waiters
+  awaiter* take_waiters() noexcept;
+
+  // unlink a cancelled waiter (false if set() already took it)
+  bool remove_waiter(awaiter* waiter) const noexcept;
+
+  static bool is_being_edited(void* state) noexcept {
+    return (reinterpret_cast<std::uintptr_t>(state) & 1) != 0;
+  }
+
+  // - 'this' => set state
+  // - otherwise => not set, head of linked list of awaiter*
+  //   (low bit set: list is being edited by remove_waiter())
+  mutable std::atomic<void*> m_state;
+
+};
+
+struct async_manual_reset_event::awaiter
+{
+  awaiter(const async_manual_reset_event& event) noexcept
+  : m_event(event)
+  {}
+
+  bool await_ready() const noexcept;
+
+  // the wait is cancellable if the awaiting coroutine has a cancellation token
+  template <typename Promise>
+  bool await_suspend(std::coroutine_handle<Promise> awaitingCoroutine) {
+    if (const cancellation_token* token = cancellation_token_of(awaitingCoroutine)) {
+      return suspend_cancellable(awaitingCoroutine, *token);
+    }
+    return push(awaitingCoroutine);
+  }
+
+  void await_resume() const {
+    if (m_cancelled) {
+      throw operation_cancelled{};
+    }
+  }
+
+private:
+  friend class async_manual_reset_event;
+
+  bool push(std::coroutine_handle<> awaitingCoroutine) noexcept;
+  bool suspend_cancellable(std::coroutine_handle<> awaitingCoroutine,
+                           const cancellation_token& token);
+  void on_cancel() noexcept;
+
+  const async_manual_reset_event& m_event;
+  std::coroutine_handle<> m_awaitingCoroutine;
+  awaiter* m_next;
+
+  // cancellable waits only:
+  enum cancel_state { not_pushed, pushed, cancelled_before_push };
+  std::atomic<cancel_state> m_cancelState{not_pushed};
+  std::optional<cancellation_registration> m_registration;
+  bool m_cancelled = false;
+};
+
+// input range over a taken list of waiters
+// - the successor is read before a handle is handed out,
+//   because resuming the coroutine will likely destroy the awaiter object
+class async_manual_reset_event::waiter_range
+{
+public:
+  class iterator
+  {
+  public:
+    using value_type = std::coroutine_handle<>;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() noexcept = default;
+    explicit iterator(awaiter* first) noexcept
+    : m_current(first), m_next(first != nullptr ? first->m_next : nullptr)
+    {}
+
+    std::coroutine_handle<> operator*() const noexcept {
+      return m_current->m_awaitingCoroutine;
+    }
+    iterator& operator++() noexcept {
+      m_current = m_next;
+      m_next = m_current != nullptr ? m_current->m_next : nullptr;
+      return *this;
+    }
+    void operator++(int) noexcept {
+      ++*this;
+    }
+    bool operator==(std::default_sentinel_t) const noexcept {
+      return m_current == nullptr;
+    }
+
+  private:
+    awaiter* m_current = nullptr;
+    awaiter* m_next = nullptr;
+  };
+
+  explicit waiter_range(awaiter* first) noexcept
+  : m_first(first)
+  {}
+
+  iterator begin() const noexcept { return iterator{m_first}; }
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+  awaiter* m_first;
+};
+
+inline bool async_manual_reset_event::awaiter::await_ready() const noexcept
+{
+  return m_event.is_set();
+}
+
+inline bool async_manual_reset_event::awaiter::push(
+  std::coroutine_handle<> awaitingCoroutine) noexcept
+{
+  // Special m_state value that indicates the event is in the 'set' state.
+  const void* const setState = &m_event;
+
+  // Stash the handle of the awaiting coroutine.
+  m_awaitingCoroutine = awaitingCoroutine;
+
+  // Try to atomically push this awaiter onto the front of the list.
+  void* oldValue = m_event.m_state.load(std::memory_order_acquire);
+  do
+  {
+    // Wait while a cancelled waiter is unlinked.
+    while (async_manual_reset_event::is_being_edited(oldValue)) {
+      std::this_thread::yield();
+      oldValue = m_event.m_state.load(std::memory_order_acquire);
+    }
+
+    // Resume immediately if already in 'set' state.
+    if (oldValue == setState) {
+      return false;
+    }
+
+    // Update linked list to point at current head.
+    m_next = static_cast<awaiter*>(oldValue);
+
+    // Finally, try to swap the old list head, inserting this awaiter
+    // as the new list head.
+  } while (!m_event.m_state.compare_exchange_weak(
+             oldValue,
+             this,
+             std::memory_order_release,
+             std::memory_order_acquire));
+
+  // Successfully enqueued. Remain suspended.
+  return true;
+}
+
+inline bool async_manual_reset_event::awaiter::suspend_cancellable(
+  std::coroutine_handle<> awaitingCoroutine, const cancellation_token& token)
+{
+  if (token.is_cancellation_requested()) {
+    m_cancelled = true;
+    return false;
+  }
+  // on_cancel() might be called from now on (even by emplace()):
+  m_registration.emplace(token, [this] { on_cancel(); });
+  if (!push(awaitingCoroutine)) {
+    return false;   // already set (set wins over a cancellation)
+  }
+  cancel_state expected = not_pushed;
+  if (m_cancelState.compare_exchange_strong(expected, pushed, std::memory_order_acq_rel)) {
+    return true;
+  }
+  // cancelled while we pushed: unlink ourselves again
+  // (unless set() took us already, then it resumes us)
+  if (m_event.remove_waiter(this)) {
+    m_cancelled = true;
+    return false;
+  }
+  return true;
+}
+
+inline void async_manual_reset_event::awaiter::on_cancel() noexcept
+{
+  cancel_state expected = not_pushed;
+  if (m_cancelState.compare_exchange_strong(expected, cancelled_before_push,
+                                            std::memory_order_acq_rel)) {
+    return;   // suspend_cancellable() takes care
+  }
+  if (m_event.remove_waiter(this)) {
+    m_cancelled = true;
+    m_awaitingCoroutine.resume();
+  }
+}
+
+inline async_manual_reset_event::async_manual_reset_event(
+  bool initiallySet) noexcept
+: m_state(initiallySet ? this : nullptr)
+{}
+
+inline bool async_manual_reset_event::is_set() const noexcept
+{
+  return m_state.load(std::memory_order_acquire) == this;
+}
+
+inline void async_manual_reset_event::reset() noexcept
+{
+  void* oldValue = this;
+  m_state.compare_exchange_strong(oldValue, nullptr, std::memory_order_acquire);
+}
+
+inline async_manual_reset_event::awaiter* async_manual_reset_event::take_waiters() noexcept
+{
+  // Needs to be 'release' so that subsequent 'co_await' has
+  // visibility of our prior writes.
+  // Needs to be 'acquire' so that we have visibility of prior
+  // writes by awaiting coroutines.
+  // (Not while a cancelled waiter is unlinked.)
+  void* oldValue = m_state.load(std::memory_order_acquire);
+  do
+  {
+    while (is_being_edited(oldValue))
+    {
+      std::this_thread::yield();
+      oldValue = m_state.load(std::memory_order_acquire);
+    }
+    if (oldValue == this)
+    {
+      // already in 'set' state
+      return nullptr;
+    }
+  } while (!m_state.compare_exchange_weak(oldValue, this, std::memory_order_acq_rel,
+                                          std::memory_order_acquire));
+  // Treat old value as head of a linked-list of waiters
+  // which we have now acquired and need to resume.
+  return static_cast<awaiter*>(oldValue);
+}
+
+inline bool async_manual_reset_event::remove_waiter(awaiter* waiter) const noexcept
+{
+  // mark the list as being edited (nobody else changes it meanwhile):
+  void* oldValue = m_state.load(std::memory_order_acquire);
+  while (true)
+  {
+    if (oldValue == this)
+    {
+      return false;   // set() took the waiters (and resumes them)
+    }
+    if (is_being_edited(oldValue))
+    {
+      std::this_thread::yield();
+      oldValue = m_state.load(std::memory_order_acquire);
+      continue;
+    }
+    void* editing = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(oldValue) | 1);
+    if (m_state.compare_exchange_weak(oldValue, editing, std::memory_order_acquire))
+    {
+      break;
+    }
+  }
+  // unlink the waiter (if set() took the list and reset() was called since,
+  // it isn't in the list anymore):
+  awaiter* head = static_cast<awaiter*>(oldValue);
+  bool found = false;
+  if (head == waiter)
+  {
+    head = waiter->m_next;
+    found = true;
+  }
+  else
+  {
+    for (awaiter* a = head; a != nullptr; a = a->m_next)
+    {
+      if (a->m_next == waiter)
+      {
+        a->m_next = waiter->m_next;
+        found = true;
+        break;
+      }
+    }
+  }
+  m_state.store(head, std::memory_order_release);
+  return found;
+}
+
+inline void async_manual_reset_event::set() noexcept
+{
+  for (std::coroutine_handle<> hdl : waiter_range{take_waiters()})
+  {
+    hdl.resume();  // BLOCKS until the waiter suspends again or ends
+  }
+}
+
+template <typename Executor>
+void async_manual_reset_event::set(Executor& executor) noexcept
+{
+  // the event is set once the waiters are taken: handing them out must not fail
+  static_assert(noexcept(executor.postAll(std::declval<waiter_range>())),
+                "postAll() has to be noexcept");
+  if (awaiter* waiters = take_waiters())
+  {
+    executor.postAll(waiter_range{waiters});
+  }
+}
+
+inline async_manual_reset_event::awaiter
+async_manual_reset_event::operator co_await() const noexcept
+{
+  return awaiter{ *this };
+}
+
+#endif
@@ -0,0 +1,254 @@
+// async_generator<T>: a coroutine that yields a stream of values
+// and may co_await inside its body
+//  - the consumer pulls with co_await gen.next() (one element)
+//    or co_await gen.next_batch(span) (many elements per resumption)
+//  - producer and consumer switch with symmetric transfer,
+//    so neither direction grows the native stack
+//  - next() doesn't copy a yielded rvalue: it returns a pointer to it,
+//    which is valid until the generator is resumed again
+//    (the consumer may move from it); a yielded lvalue is copied into
+//    the promise first, so that the consumer never moves from (or
+//    modifies) an object of the producer
+//  - next_batch() moves the yielded values into the span;
+//    the producer only suspends when the span is full (or at the end)
+//  - pipeline stages transform(), filter(), and batch(n)
+//    move the elements from stage to stage
+//  - exceptions thrown in the generator are rethrown in the consumer
+// see: cppcoro::async_generator by Lewis Baker
+
+#ifndef INCLUDED_ASYNC_GENERATOR_HPP
+#define INCLUDED_ASYNC_GENERATOR_HPP
+
+#include "../framepool/framepool.hpp"
+#include <coroutine>
+#include <exception>
+#include <utility>     // for std::exchange()
+#include <memory>      // for std::addressof()
+#include <optional>
+#include <span>
+#include <vector>
+#include <type_traits>
+#include <cstddef>
+
+template <typename T>
+class async_generator
+{
+public:
+  static_assert(!std::is_reference_v<T>, "async_generator<T> yields objects");
+
+  struct promise_type;
+  using CoroHdl = std::coroutine_handle<promise_type>;
+
+private:
+  CoroHdl hdl;
+
+public:
+  struct promise_type
+  {
+    T* current = nullptr;               // element of the last next()
+    std::optional<T> copy;              // copy of the last yielded lvalue
+    std::span<T> batch;                 // destination of next_batch()
+    std::size_t batchCount = 0;
+    bool batchMode = false;
+    std::coroutine_handle<> consumer;
+    std::exception_ptr exception;
+
+    // allocate the coroutine frames from the thread-local frame pool:
+    static void* operator new(std::size_t sz) {
+      return FramePool::allocate(sz);
+    }
+    static void operator delete(void* p) noexcept {
+      FramePool::deallocate(p);
+    }
+
+    async_generator get_return_object() noexcept {
+      return async_generator{CoroHdl::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+
+    // suspend (and continue with the consumer) unless a batch is being filled
+    struct YieldAwaiter {
+      bool suspend;
+      bool await_ready() const noexcept { return !suspend; }
+      std::coroutine_handle<> await_suspend(CoroHdl h) const noexcept {
+        return h.promise().consumer;
+      }
+      void await_resume() const noexcept {}
+    };
+
+    YieldAwaiter yield_value(T&& value)
+      noexcept(std::is_nothrow_move_assignable_v<T>) {
+      if (batchMode) {
+        batch[batchCount++] = std::move(value);
+        return YieldAwaiter{batchCount == batch.size()};
+      }
+      // the temporary lives until the generator is resumed:
+      current = std::addressof(value);
+      return YieldAwaiter{true};
+    }
+    YieldAwaiter yield_value(const T& value)
+      noexcept(std::is_nothrow_copy_assignable_v<T> && std::is_nothrow_copy_constructible_v<T>) {
+      if (batchMode) {
+        batch[batchCount++] = value;
+        return YieldAwaiter{batchCount == batch.size()};
+      }
+      current = std::addressof(copy.emplace(value));
+      return YieldAwaiter{true};
+    }
+
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept {
+      exception = std::current_exception();
+    }
+
+    struct FinalAwaiter {
+      bool await_ready() const noexcept { return false; }
+      std::coroutine_handle<> await_suspend(CoroHdl h) const noexcept {
+        return h.promise().consumer;
+      }
+      void await_resume() const noexcept {}
+    };
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+
+    void rethrowIfFailed() {
+      if (exception) {
+        std::rethrow_exception(std::exchange(exception, nullptr));
+      }
+    }
+  };
+
+  // awaiter of next(): pointer to the next element or nullptr at the end
+  class NextAwaiter
+  {
+  private:
+    CoroHdl hdl;
+  public:
+    explicit NextAwaiter(CoroHdl h) noexcept : hdl{h} {}
+    bool await_ready() const noexcept {
+      return !hdl || hdl.done();
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept {
+      auto& p = hdl.promise();
+      p.consumer = consumer;
+      p.batchMode = false;
+      p.current = nullptr;
+      return hdl;
+    }
+    T* await_resume() {
+      if (!hdl) {
+        return nullptr;
+      }
+      auto& p = hdl.promise();
+      p.rethrowIfFailed();
+      return hdl.done() ? nullptr : p.current;
+    }
+  };
+
+  // awaiter of next_batch(): number of elements moved into the span
+  // (less than its size only at the end)
+  class BatchAwaiter
+  {
+  private:
+    CoroHdl hdl;
+    std::span<T> out;
+    bool resumed = false;   // false: nothing to pull (no elements)
+  public:
+    BatchAwaiter(CoroHdl h, std::span<T> o) noexcept : hdl{h}, out{o} {}
+    bool await_ready() const noexcept {
+      return !hdl || hdl.done() || out.empty();
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept {
+      auto& p = hdl.promise();
+      p.consumer = consumer;
+      p.batchMode = true;
+      p.batch = out;
+      p.batchCount = 0;
+      resumed = true;
+      return hdl;
+    }
+    std::size_t await_resume() {
+      if (!resumed) {
+        return 0;
+      }
+      auto& p = hdl.promise();
+      p.batchMode = false;
+      p.rethrowIfFailed();
+      return p.batchCount;
+    }
+  };
+
+  async_generator() noexcept = default;
+  async_generator(async_generator&& g) noexcept
+  : hdl{std::exchange(g.hdl, {})}
+  {}
+  async_generator& operator=(async_generator&& g) noexcept {
+    if (this != &g) {
+      if (hdl) {
+        hdl.destroy();
+      }
+      hdl = std::exchange(g.hdl, {});
+    }
+    return *this;
+  }
+  ~async_generator() {
+    if (hdl) {
+      hdl.destroy();
+    }
+  }
+
+  // resume the generator until it yields the next element
+  [[nodiscard]] NextAwaiter next() noexcept {
+    return NextAwaiter{hdl};
+  }
+
+  // resume the generator until it yielded out.size() elements (or ended)
+  [[nodiscard]] BatchAwaiter next_batch(std::span<T> out) noexcept {
+    return BatchAwaiter{hdl, out};
+  }
+
+private:
+  explicit async_generator(CoroHdl h) noexcept
+  : hdl{h}
+  {}
+};
+
+
+//*** pipeline stages
+
+// yields fn(element) for each element of source
+template <typename T, typename FN>
+auto transform(async_generator<T> source, FN fn)
+  -> async_generator<std::remove_cvref_t<std::invoke_result_t<FN&, T&&>>>
+{
+  while (T* elem = co_await source.next()) {
+    co_yield fn(std::move(*elem));
+  }
+}
+
+// yields the elements of source for which pred(element) is true
+template <typename T, typename PRED>
+async_generator<T> filter(async_generator<T> source, PRED pred)
+{
+  while (T* elem = co_await source.next()) {
+    if (pred(std::as_const(*elem))) {
+      co_yield std::move(*elem);
+    }
+  }
+}
+
+// yields the elements of source in spans of up to n elements
+// (pulled with next_batch(), so source is resumed once per span;
+//  the span is valid until the generator is resumed again)
+template <typename T>
+async_generator<std::span<T>> batch(async_generator<T> source, std::size_t n)
+{
+  std::vector<T> buf(n);
+  while (std::size_t num = co_await source.next_batch(buf)) {
+    co_yield std::span<T>{buf.data(), num};
+    if (num < n) {
+      break;
+    }
+  }
+}
+
+#endif
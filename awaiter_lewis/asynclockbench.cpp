@@ -0,0 +1,259 @@
+// benchmark and checks for async_mutex, async_semaphore, and async_auto_reset_event
+//  - uncontended: lock/unlock in a loop on one thread (compared with std::mutex)
+//  - contended: coroutines on the CoroScheduler increment a shared counter
+//    (with std::mutex, waiting blocks the worker threads)
+//  - FIFO: waiters have to be resumed in the order they started waiting
+//  - semaphore: at most maxCount coroutines hold a permit at the same time
+// usage: asynclockbench [numWorkers [numTasks [numIncrements]]]
+
+#include "asyncmutex.hpp"
+#include "asyncsemaphore.hpp"
+#include "../async_nico_phil/coroscheduler.hpp"
+#include "../bench/benchfixture.hpp"
+#include <iostream>
+#include <coroutine>
+#include <exception>
+#include <chrono>
+#include <latch>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+using Clock = std::chrono::steady_clock;
+
+double nsPer(Clock::time_point start, std::uint64_t num)
+{
+  std::chrono::duration<double, std::nano> ns = Clock::now() - start;
+  return ns.count() / static_cast<double>(num);
+}
+
+//*** uncontended
+
+DetachedTask lockLoop(async_mutex& mx, std::uint64_t num)
+{
+  for (std::uint64_t i = 0; i < num; ++i) {
+    co_await mx.lock_async();
+    mx.unlock();
+  }
+}
+
+DetachedTask acquireLoop(async_semaphore& sem, std::uint64_t num)
+{
+  for (std::uint64_t i = 0; i < num; ++i) {
+    co_await sem.acquire();
+    sem.release();
+  }
+}
+
+void uncontended(std::uint64_t num)
+{
+  std::cout << "uncontended lock + unlock:\n";
+  {
+    std::mutex mx;
+    auto start = Clock::now();
+    for (std::uint64_t i = 0; i < num; ++i) {
+      mx.lock();
+      mx.unlock();
+    }
+    std::cout << "  std::mutex:      " << nsPer(start, num) << " ns\n";
+  }
+  {
+    async_mutex mx;
+    auto start = Clock::now();
+    lockLoop(mx, num);
+    std::cout << "  async_mutex:     " << nsPer(start, num) << " ns\n";
+  }
+  {
+    async_semaphore sem{1};
+    auto start = Clock::now();
+    acquireLoop(sem, num);
+    std::cout << "  async_semaphore: " << nsPer(start, num) << " ns\n";
+  }
+}
+
+//*** contended
+
+std::uint64_t counter = 0;
+
+DetachedTask asyncIncrements(CoroScheduler<>& sched, async_mutex& mx,
+                             std::latch& done, unsigned num)
+{
+  co_await sched.schedule();
+  for (unsigned i = 0; i < num; ++i) {
+    {
+      auto lock = co_await mx.scoped_lock_async();
+      ++counter;
+    }
+    if (i % 64 == 0) {
+      co_await sched.schedule();   // let others run in between
+    }
+  }
+  done.count_down();
+}
+
+DetachedTask blockingIncrements(CoroScheduler<>& sched, std::mutex& mx,
+                                std::latch& done, unsigned num)
+{
+  co_await sched.schedule();
+  for (unsigned i = 0; i < num; ++i) {
+    {
+      std::lock_guard lock{mx};
+      ++counter;
+    }
+    if (i % 64 == 0) {
+      co_await sched.schedule();
+    }
+  }
+  done.count_down();
+}
+
+template <typename Mutex, typename FN>
+void contendedRun(const char* name, CoroScheduler<>& sched,
+                  unsigned numTasks, unsigned num, FN increments)
+{
+  Mutex mx;
+  counter = 0;
+  std::latch done{static_cast<std::ptrdiff_t>(numTasks)};
+  auto start = Clock::now();
+  for (unsigned t = 0; t < numTasks; ++t) {
+    increments(sched, mx, done, num);
+  }
+  done.wait();
+  std::uint64_t total = std::uint64_t{numTasks} * num;
+  std::cout << "  " << name << nsPer(start, total) << " ns per increment\n";
+  check(counter == total, std::string{name} + "counter " + std::to_string(counter));
+}
+
+//*** FIFO
+
+DetachedTask lockAndRecord(async_mutex& mx, std::vector<int>& order, int id)
+{
+  co_await mx.lock_async();
+  order.push_back(id);
+  mx.unlock();
+}
+
+DetachedTask acquireAndRecord(async_semaphore& sem, std::vector<int>& order, int id)
+{
+  co_await sem.acquire();
+  order.push_back(id);
+}
+
+DetachedTask awaitAndRecord(async_auto_reset_event& event, std::vector<int>& order, int id)
+{
+  co_await event;
+  order.push_back(id);
+}
+
+bool isSequence(const std::vector<int>& order, int num)
+{
+  if (order.size() != static_cast<std::size_t>(num)) {
+    return false;
+  }
+  for (int i = 0; i < num; ++i) {
+    if (order[static_cast<std::size_t>(i)] != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void fifo(int num)
+{
+  std::cout << "FIFO handoff:\n";
+  {
+    async_mutex mx;
+    std::vector<int> order;
+    check(mx.try_lock(), "try_lock() of unlocked mutex");
+    for (int i = 0; i < num; ++i) {
+      lockAndRecord(mx, order, i);   // all wait
+    }
+    check(order.empty() && !mx.try_lock(), "async_mutex waiters suspended");
+    mx.unlock();                     // resumes all one after the other
+    check(isSequence(order, num), "async_mutex resumes in FIFO order");
+    check(mx.try_lock(), "async_mutex unlocked at the end");
+    mx.unlock();
+  }
+  {
+    async_semaphore sem{0};
+    std::vector<int> order;
+    for (int i = 0; i < num; ++i) {
+      acquireAndRecord(sem, order, i);
+    }
+    sem.release(3);
+    check(order.size() == 3, "async_semaphore release(3) resumes 3 waiters");
+    sem.release(static_cast<std::uint32_t>(num));
+    check(isSequence(order, num), "async_semaphore resumes in FIFO order");
+    check(sem.available() == 3, "async_semaphore keeps remaining permits");
+  }
+  {
+    async_auto_reset_event event;
+    std::vector<int> order;
+    for (int i = 0; i < num; ++i) {
+      awaitAndRecord(event, order, i);
+    }
+    for (int i = 0; i < num; ++i) {
+      event.set();
+    }
+    check(isSequence(order, num) && !event.is_set(),
+          "async_auto_reset_event: each set() resumes one waiter in FIFO order");
+    event.set();
+    event.set();
+    check(event.is_set(), "async_auto_reset_event set without waiters");
+    awaitAndRecord(event, order, num);
+    check(isSequence(order, num + 1) && !event.is_set(),
+          "async_auto_reset_event lets the next co_await pass and resets");
+  }
+}
+
+//*** semaphore limits concurrency
+
+std::atomic<int> inFlight{0};
+std::atomic<int> maxInFlight{0};
+
+DetachedTask limited(CoroScheduler<>& sched, async_semaphore& sem, std::latch& done)
+{
+  co_await sched.schedule();
+  co_await sem.acquire();
+  int now = inFlight.fetch_add(1) + 1;
+  int max = maxInFlight.load();
+  while (now > max && !maxInFlight.compare_exchange_weak(max, now)) {
+  }
+  co_await sched.schedule();   // hold the permit across a suspension
+  inFlight.fetch_sub(1);
+  sem.release();
+  done.count_down();
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned numWorkers = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1]))
+                                 : std::thread::hardware_concurrency();
+  unsigned numTasks = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 64;
+  unsigned num = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 20'000;
+
+  uncontended(10'000'000);
+
+  CoroScheduler<> sched{numWorkers};
+  std::cout << "contended (" << sched.numWorkers() << " workers, "
+            << numTasks << " coroutines):\n";
+  contendedRun<async_mutex>("async_mutex: ", sched, numTasks, num, asyncIncrements);
+  contendedRun<std::mutex>("std::mutex:  ", sched, numTasks, num, blockingIncrements);
+
+  fifo(1000);
+
+  std::cout << "semaphore:\n";
+  {
+    async_semaphore sem{4};
+    std::latch done{static_cast<std::ptrdiff_t>(numTasks * 10)};
+    for (unsigned t = 0; t < numTasks * 10; ++t) {
+      limited(sched, sem, done);
+    }
+    done.wait();
+    check(maxInFlight.load() <= 4 && sem.available() == 4,
+          "at most 4 permits held (max " + std::to_string(maxInFlight.load()) + ")");
+  }
+
+  return checksOk ? 0 : 1;
+}
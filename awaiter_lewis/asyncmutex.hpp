@@ -0,0 +1,215 @@
+// async_mutex: a mutex for coroutines
+//  - co_await mutex.lock_async() suspends the coroutine (instead of
+//    blocking the thread) while another coroutine holds the lock
+//  - co_await mutex.scoped_lock_async() returns an async_mutex_lock,
+//    which unlocks when it is destroyed
+//  - same technique as async_manual_reset_event:
+//    waiters are awaiter objects in the coroutine frames,
+//    pushed onto a list with a CAS (no allocation)
+//  - lock and unlock take one atomic operation each without contention
+//  - unlock() hands the lock to the oldest waiter (FIFO) and resumes it
+//    in the calling thread
+// see: cppcoro::async_mutex by Lewis Baker
+
+#ifndef INCLUDED_ASYNC_MUTEX_HPP
+#define INCLUDED_ASYNC_MUTEX_HPP
+
+#include <coroutine>
+#include <atomic>
+#include <mutex>     // for std::adopt_lock_t
+#include <cstdint>
+#include <utility>   // for std::exchange()
+
+class async_mutex_lock;
+
+class async_mutex
+{
+public:
+
+  async_mutex() noexcept;
+
+  // No copying/moving
+  async_mutex(const async_mutex&) = delete;
+  async_mutex(async_mutex&&) = delete;
+  async_mutex& operator=(const async_mutex&) = delete;
+  async_mutex& operator=(async_mutex&&) = delete;
+
+  // the mutex must not be locked when destroyed
+  ~async_mutex() = default;
+
+  bool try_lock() noexcept;
+
+  class lock_awaiter;
+  class scoped_lock_awaiter;
+
+  lock_awaiter lock_async() noexcept;
+  scoped_lock_awaiter scoped_lock_async() noexcept;
+
+  void unlock();
+
+private:
+
+  friend class lock_awaiter;
+
+  // - not_locked => not locked
+  // - locked_no_waiters => locked, no new waiters
+  // - otherwise => locked, head of linked list of new lock_awaiter*
+  //   (most recent first)
+  static constexpr std::uintptr_t not_locked = 1;
+  static constexpr std::uintptr_t locked_no_waiters = 0;
+  std::atomic<std::uintptr_t> m_state;
+
+  // waiters in FIFO order (only accessed by the holder of the lock)
+  lock_awaiter* m_waiters;
+
+};
+
+class async_mutex::lock_awaiter
+{
+public:
+  explicit lock_awaiter(async_mutex& mutex) noexcept
+  : m_mutex(mutex)
+  {}
+
+  bool await_ready() const noexcept {
+    return m_mutex.try_lock();
+  }
+  bool await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept;
+  void await_resume() noexcept {}
+
+protected:
+  async_mutex& m_mutex;
+
+private:
+  friend class async_mutex;
+
+  std::coroutine_handle<> m_awaitingCoroutine;
+  lock_awaiter* m_next;
+};
+
+// holds a locked async_mutex and unlocks it when destroyed
+class async_mutex_lock
+{
+public:
+  explicit async_mutex_lock(async_mutex& mutex, std::adopt_lock_t) noexcept
+  : m_mutex(&mutex)
+  {}
+
+  async_mutex_lock(async_mutex_lock&& other) noexcept
+  : m_mutex(std::exchange(other.m_mutex, nullptr))
+  {}
+
+  async_mutex_lock(const async_mutex_lock&) = delete;
+  async_mutex_lock& operator=(const async_mutex_lock&) = delete;
+
+  ~async_mutex_lock()
+  {
+    if (m_mutex != nullptr)
+    {
+      m_mutex->unlock();
+    }
+  }
+
+private:
+  async_mutex* m_mutex;
+};
+
+class async_mutex::scoped_lock_awaiter : public async_mutex::lock_awaiter
+{
+public:
+  using lock_awaiter::lock_awaiter;
+
+  [[nodiscard]] async_mutex_lock await_resume() noexcept {
+    return async_mutex_lock{m_mutex, std::adopt_lock};
+  }
+};
+
+inline async_mutex::async_mutex() noexcept
+: m_state(not_locked), m_waiters(nullptr)
+{}
+
+inline bool async_mutex::try_lock() noexcept
+{
+  // Only locks if not locked (keeps any list of waiters intact).
+  std::uintptr_t oldState = not_locked;
+  return m_state.compare_exchange_strong(
+    oldState, locked_no_waiters,
+    std::memory_order_acquire, std::memory_order_relaxed);
+}
+
+inline async_mutex::lock_awaiter async_mutex::lock_async() noexcept
+{
+  return lock_awaiter{*this};
+}
+
+inline async_mutex::scoped_lock_awaiter async_mutex::scoped_lock_async() noexcept
+{
+  return scoped_lock_awaiter{*this};
+}
+
+inline bool async_mutex::lock_awaiter::await_suspend(
+  std::coroutine_handle<> awaitingCoroutine) noexcept
+{
+  m_awaitingCoroutine = awaitingCoroutine;
+
+  std::uintptr_t oldState = m_mutex.m_state.load(std::memory_order_acquire);
+  while (true)
+  {
+    if (oldState == not_locked)
+    {
+      // Unlocked in the meantime: try to take the lock without suspending.
+      if (m_mutex.m_state.compare_exchange_weak(
+            oldState, locked_no_waiters,
+            std::memory_order_acquire, std::memory_order_relaxed))
+      {
+        return false;
+      }
+    }
+    else
+    {
+      // Try to push this awaiter onto the front of the list of new waiters.
+      m_next = reinterpret_cast<lock_awaiter*>(oldState);
+      if (m_mutex.m_state.compare_exchange_weak(
+            oldState, reinterpret_cast<std::uintptr_t>(this),
+            std::memory_order_release, std::memory_order_relaxed))
+      {
+        // Queued: unlock() resumes us when it is our turn.
+        return true;
+      }
+    }
+  }
+}
+
+inline void async_mutex::unlock()
+{
+  lock_awaiter* waitersHead = m_waiters;
+  if (waitersHead == nullptr)
+  {
+    // Fast path: no waiters at all.
+    std::uintptr_t oldState = locked_no_waiters;
+    if (m_state.compare_exchange_strong(
+          oldState, not_locked,
+          std::memory_order_release, std::memory_order_relaxed))
+    {
+      return;
+    }
+
+    // Take the new waiters and reverse the list,
+    // so that they are resumed in the order they started waiting.
+    oldState = m_state.exchange(locked_no_waiters, std::memory_order_acquire);
+    auto* next = reinterpret_cast<lock_awaiter*>(oldState);
+    do
+    {
+      auto* temp = next->m_next;
+      next->m_next = waitersHead;
+      waitersHead = next;
+      next = temp;
+    } while (next != nullptr);
+  }
+
+  // Hand the lock over to the oldest waiter.
+  m_waiters = waitersHead->m_next;
+  waitersHead->m_awaitingCoroutine.resume();
+}
+
+#endif
@@ -0,0 +1,294 @@
+// async_semaphore and async_auto_reset_event for coroutines
+//  - co_await sem.acquire() takes a permit or suspends the coroutine
+//    (instead of blocking the thread) until release() provides one
+//  - async_auto_reset_event is a semaphore with at most one permit:
+//    set() lets one waiter pass (or the next co_await)
+//  - same technique as async_manual_reset_event:
+//    waiters are awaiter objects in the coroutine frames,
+//    pushed onto a list with a CAS (no allocation)
+//  - acquiring an available permit takes one atomic operation
+//  - permits are handed to the waiters in FIFO order
+// see: cppcoro::async_auto_reset_event by Lewis Baker
+//
+// how it works:
+//  - the state counts released permits (low 32 bits) and waiters (high 32 bits);
+//    while both are not 0, the permits are handed to waiters
+//  - the thread that makes both counts non-zero (release() or a new waiter)
+//    is the only one that dequeues waiters until one of the counts is 0 again
+//  - waiters push themselves onto a list of new waiters before they are counted;
+//    the dequeuing thread reverses this list into the FIFO list m_waiters
+//  - a waiter may be dequeued before its own await_suspend() is done;
+//    the reference count in the awaiter lets whoever finishes last resume it
+
+#ifndef INCLUDED_ASYNC_SEMAPHORE_HPP
+#define INCLUDED_ASYNC_SEMAPHORE_HPP
+
+#include <coroutine>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+class async_semaphore
+{
+public:
+
+  explicit async_semaphore(std::uint32_t initialCount = 0,
+                           std::uint32_t maxCount = max_count_limit) noexcept;
+
+  // No copying/moving
+  async_semaphore(const async_semaphore&) = delete;
+  async_semaphore(async_semaphore&&) = delete;
+  async_semaphore& operator=(const async_semaphore&) = delete;
+  async_semaphore& operator=(async_semaphore&&) = delete;
+
+  // there must be no waiters when destroyed
+  ~async_semaphore() = default;
+
+  static constexpr std::uint32_t max_count_limit = 0x7fffffff;
+
+  class awaiter;
+  awaiter acquire() noexcept;
+
+  bool try_acquire() noexcept;
+
+  // add count permits (at most up to maxCount available permits)
+  // - waiters that get a permit are resumed in the calling thread
+  void release(std::uint32_t count = 1);
+
+  // number of permits available now (without waiters)
+  std::uint32_t available() const noexcept;
+
+private:
+
+  friend class awaiter;
+
+  static constexpr std::uint64_t set_increment = 1;
+  static constexpr std::uint64_t waiter_increment = std::uint64_t{1} << 32;
+
+  static std::uint32_t get_set_count(std::uint64_t state) noexcept {
+    return static_cast<std::uint32_t>(state);
+  }
+  static std::uint32_t get_waiter_count(std::uint64_t state) noexcept {
+    return static_cast<std::uint32_t>(state >> 32);
+  }
+  static std::uint32_t get_available(std::uint64_t state) noexcept {
+    std::uint32_t setCount = get_set_count(state);
+    std::uint32_t waiterCount = get_waiter_count(state);
+    return setCount > waiterCount ? setCount - waiterCount : 0;
+  }
+
+  // hand permits to waiters (called by the one thread responsible for it)
+  void resume_waiters(std::uint64_t state);
+
+  std::atomic<std::uint64_t> m_state;
+
+  // new waiters (most recent first)
+  std::atomic<awaiter*> m_newWaiters;
+
+  // waiters in FIFO order (only accessed by the thread dequeuing waiters)
+  awaiter* m_waiters;
+
+  const std::uint32_t m_maxCount;
+
+};
+
+class async_semaphore::awaiter
+{
+public:
+  explicit awaiter(async_semaphore& semaphore) noexcept
+  : m_semaphore(semaphore)
+  {}
+
+  bool await_ready() const noexcept {
+    return m_semaphore.try_acquire();
+  }
+  bool await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept;
+  void await_resume() noexcept {}
+
+private:
+  friend class async_semaphore;
+
+  async_semaphore& m_semaphore;
+  std::coroutine_handle<> m_awaitingCoroutine;
+  awaiter* m_next = nullptr;
+  // 2: the resumer and await_suspend() both have to be done
+  std::atomic<std::uint32_t> m_refCount{2};
+};
+
+inline async_semaphore::async_semaphore(std::uint32_t initialCount,
+                                        std::uint32_t maxCount) noexcept
+: m_state(std::min({initialCount, maxCount, max_count_limit})),
+  m_newWaiters(nullptr),
+  m_waiters(nullptr),
+  m_maxCount(std::min(maxCount, max_count_limit))
+{}
+
+inline async_semaphore::awaiter async_semaphore::acquire() noexcept
+{
+  return awaiter{*this};
+}
+
+inline std::uint32_t async_semaphore::available() const noexcept
+{
+  return get_available(m_state.load(std::memory_order_acquire));
+}
+
+inline bool async_semaphore::try_acquire() noexcept
+{
+  std::uint64_t oldState = m_state.load(std::memory_order_relaxed);
+  do
+  {
+    if (get_available(oldState) == 0)
+    {
+      return false;
+    }
+  } while (!m_state.compare_exchange_weak(
+             oldState,
+             oldState - set_increment,
+             std::memory_order_acquire,
+             std::memory_order_relaxed));
+  return true;
+}
+
+inline void async_semaphore::release(std::uint32_t count)
+{
+  std::uint64_t oldState = m_state.load(std::memory_order_relaxed);
+  std::uint64_t newState;
+  do
+  {
+    std::uint32_t available = get_available(oldState);
+    std::uint32_t add = std::min(count, m_maxCount - std::min(available, m_maxCount));
+    if (add == 0)
+    {
+      // already at the maximum
+      return;
+    }
+    newState = oldState + add * set_increment;
+  } while (!m_state.compare_exchange_weak(
+             oldState,
+             newState,
+             std::memory_order_acq_rel,
+             std::memory_order_relaxed));
+
+  // If there were waiters and nobody was handing out permits,
+  // we are responsible now.
+  if (get_set_count(oldState) == 0 && get_waiter_count(oldState) != 0)
+  {
+    resume_waiters(newState);
+  }
+}
+
+inline bool async_semaphore::awaiter::await_suspend(
+  std::coroutine_handle<> awaitingCoroutine) noexcept
+{
+  m_awaitingCoroutine = awaitingCoroutine;
+
+  // Push this awaiter onto the front of the list of new waiters.
+  awaiter* head = m_semaphore.m_newWaiters.load(std::memory_order_relaxed);
+  do
+  {
+    m_next = head;
+  } while (!m_semaphore.m_newWaiters.compare_exchange_weak(
+             head,
+             this,
+             std::memory_order_release,
+             std::memory_order_relaxed));
+
+  // Count us as waiter.
+  std::uint64_t oldState = m_semaphore.m_state.fetch_add(waiter_increment,
+                                                         std::memory_order_acq_rel);
+
+  // If there were permits and nobody was handing them out,
+  // we are responsible now (and might resume ourselves).
+  if (get_set_count(oldState) != 0 && get_waiter_count(oldState) == 0)
+  {
+    m_semaphore.resume_waiters(oldState + waiter_increment);
+  }
+
+  // Suspend unless we were already resumed.
+  return m_refCount.fetch_sub(1, std::memory_order_acq_rel) != 1;
+}
+
+inline void async_semaphore::resume_waiters(std::uint64_t state)
+{
+  awaiter* toResume = nullptr;
+  awaiter** toResumeTail = &toResume;
+
+  do
+  {
+    std::uint32_t count = std::min(get_set_count(state), get_waiter_count(state));
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+      if (m_waiters == nullptr)
+      {
+        // Take the new waiters and reverse the list,
+        // so that they are resumed in the order they started waiting.
+        awaiter* newWaiters = m_newWaiters.exchange(nullptr, std::memory_order_acquire);
+        do
+        {
+          awaiter* next = newWaiters->m_next;
+          newWaiters->m_next = m_waiters;
+          m_waiters = newWaiters;
+          newWaiters = next;
+        } while (newWaiters != nullptr);
+      }
+
+      awaiter* waiter = m_waiters;
+      m_waiters = waiter->m_next;
+      *toResumeTail = waiter;
+      toResumeTail = &waiter->m_next;
+    }
+
+    // Consume the permits and waiters we dequeued.
+    std::uint64_t delta = count * set_increment + count * waiter_increment;
+    state = m_state.fetch_sub(delta, std::memory_order_acq_rel) - delta;
+  } while (get_set_count(state) != 0 && get_waiter_count(state) != 0);
+
+  *toResumeTail = nullptr;
+
+  while (toResume != nullptr)
+  {
+    // Read m_next before resuming the coroutine as resuming
+    // the coroutine will likely destroy the awaiter object.
+    awaiter* next = toResume->m_next;
+    if (toResume->m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      toResume->m_awaitingCoroutine.resume();
+    }
+    toResume = next;
+  }
+}
+
+
+// auto-reset event: set() lets exactly one waiter (or the next co_await) pass
+class async_auto_reset_event
+{
+public:
+
+  explicit async_auto_reset_event(bool initiallySet = false) noexcept
+  : m_semaphore(initiallySet ? 1 : 0, 1)
+  {}
+
+  bool is_set() const noexcept {
+    return m_semaphore.available() != 0;
+  }
+
+  async_semaphore::awaiter operator co_await() noexcept {
+    return m_semaphore.acquire();
+  }
+
+  // resumes the oldest waiter (in the calling thread)
+  // or lets the next co_await pass
+  void set() {
+    m_semaphore.release();
+  }
+
+  void reset() noexcept {
+    m_semaphore.try_acquire();
+  }
+
+private:
+  async_semaphore m_semaphore;
+};
+
+#endif
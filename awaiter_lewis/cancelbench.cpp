@@ -0,0 +1,230 @@
+// checks and costs of cooperative cancellation (see cancellation.hpp)
+//  - checks: cancelled event waits, registrations racing with
+//    request_cancellation(), a CoroTask chain hopping on the CoroScheduler,
+//    and when_any() cancelling the tasks that lost
+//  - costs: registering/deregistering a callback,
+//    and waiting for an event with and without a cancellation token
+// usage: cancelbench [numOps [numWorkers]]
+
+#include "cancellation.hpp"
+#include "asyncevent.hpp"
+#include "../async_nico_phil/corotask.hpp"
+#include "../async_nico_phil/coroscheduler.hpp"
+#include "../async_nico_phil/syncwait.hpp"
+#include "../async_nico_phil/whenall.hpp"
+#include "../bench/benchfixture.hpp"
+#include <iostream>
+#include <coroutine>
+#include <exception>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+
+using Clock = std::chrono::steady_clock;
+using Sched = CoroScheduler<>;
+
+// result: 1 if the event was set, -1 if the wait was cancelled
+CancellableDetachedTask waitEvent(cancellation_token, async_manual_reset_event& event, int& result)
+{
+  try {
+    co_await event;
+    result = 1;
+  }
+  catch (const operation_cancelled&) {
+    result = -1;
+  }
+}
+
+bool checkEventWaits()
+{
+  async_manual_reset_event event;
+  cancellation_source source;
+  int cancelled = 0, other = 0, plain = 0;
+  waitEvent(source.token(), event, cancelled);
+  waitEvent(cancellation_source{}.token(), event, other);
+  waitEvent(cancellation_token{}, event, plain);
+  // resumes the first waiter in this thread, the others keep waiting:
+  source.request_cancellation();
+  bool ok = cancelled == -1 && other == 0 && plain == 0;
+  event.set();
+  ok = ok && cancelled == -1 && other == 1 && plain == 1;
+
+  // already cancelled: the wait doesn't even start
+  int late = 0;
+  async_manual_reset_event unset;
+  waitEvent(source.token(), unset, late);
+  return ok && late == -1;
+}
+
+// a callback is called at most once and never after its registration is gone;
+// registrations after request_cancellation() call it at once
+bool checkRegistrationRaces(unsigned rounds)
+{
+  bool ok = true;
+  for (unsigned r = 0; r < rounds && ok; ++r) {
+    cancellation_source source;
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned> misses{0};
+    std::thread registering{[&] {
+      while (!stop.load(std::memory_order_acquire)) {
+        std::atomic<int> calls{0};
+        std::atomic<bool> alive{true};
+        bool cancelledBefore = source.is_cancellation_requested();
+        {
+          cancellation_registration reg{source.token(), [&] {
+                                          if (!alive.load()) {
+                                            misses.fetch_add(1);
+                                          }
+                                          calls.fetch_add(1);
+                                        }};
+          if (cancelledBefore && calls.load() != 1) {
+            misses.fetch_add(1);
+          }
+        }
+        alive.store(false);
+        if (calls.load() > 1) {
+          misses.fetch_add(1);
+        }
+      }
+    }};
+    std::this_thread::sleep_for(std::chrono::microseconds{50 + r % 50});
+    source.request_cancellation();
+    std::this_thread::sleep_for(std::chrono::microseconds{20});
+    stop.store(true, std::memory_order_release);
+    registering.join();
+    ok = misses.load() == 0;
+  }
+  return ok;
+}
+
+CoroTask<std::uint64_t> hopForever(Sched& sched, std::atomic<std::uint64_t>& hops)
+{
+  while (true) {
+    co_await sched.schedule();   // throws operation_cancelled once cancelled
+    hops.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+CoroTask<std::uint64_t> parentOfHopper(Sched& sched, std::atomic<std::uint64_t>& hops)
+{
+  // the child inherits our token:
+  co_return co_await hopForever(sched, hops);
+}
+
+bool checkSchedulerChain(Sched& sched)
+{
+  std::atomic<std::uint64_t> hops{0};
+  cancellation_source source;
+  auto task = parentOfHopper(sched, hops);
+  task.setCancellationToken(source.token());
+  std::thread canceller{[&] {
+    while (hops.load() < 1000) {
+      std::this_thread::yield();
+    }
+    source.request_cancellation();
+  }};
+  bool ok = false;
+  try {
+    sync_wait(std::move(task));
+  }
+  catch (const operation_cancelled&) {
+    ok = true;
+  }
+  canceller.join();
+  return ok;
+}
+
+CoroTask<int> waitForever(async_manual_reset_event& never, std::atomic<int>& cancelled)
+{
+  try {
+    co_await never;
+  }
+  catch (const operation_cancelled&) {
+    cancelled.fetch_add(1);
+    throw;
+  }
+  co_return 0;
+}
+
+CoroTask<int> finishAtOnce(Sched& sched)
+{
+  co_await sched.schedule();
+  co_return 42;
+}
+
+CoroTask<bool> checkWhenAny(Sched& sched, async_manual_reset_event& never,
+                            std::atomic<int>& cancelled)
+{
+  std::vector<CoroTask<int>> racers;
+  racers.push_back(waitForever(never, cancelled));
+  racers.push_back(finishAtOnce(sched));
+  racers.push_back(waitForever(never, cancelled));
+  auto first = co_await when_any(sched, std::move(racers));
+  co_return first.index == 1 && first.value == 42;
+}
+
+template <typename FN>
+double nsPerOp(std::uint64_t num, FN fn)
+{
+  auto start = Clock::now();
+  for (std::uint64_t i = 0; i < num; ++i) {
+    fn();
+  }
+  std::chrono::duration<double, std::nano> ns = Clock::now() - start;
+  return ns.count() / static_cast<double>(num);
+}
+
+int main(int argc, char* argv[])
+{
+  std::uint64_t num = argc > 1 ? std::stoull(argv[1]) : 1'000'000;
+  unsigned numWorkers = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2]))
+                                 : std::thread::hardware_concurrency();
+
+  Sched sched{numWorkers};
+  bool ok = true;
+  auto check = [&ok](const char* what, bool passed) {
+    std::cout << "  " << what << ": " << (passed ? "ok" : "FAILED") << '\n';
+    ok = ok && passed;
+  };
+  std::cout << "checks:\n";
+  check("cancelled event waits", checkEventWaits());
+  check("registrations racing with cancellation", checkRegistrationRaces(200));
+  check("CoroTask chain on the scheduler", checkSchedulerChain(sched));
+  async_manual_reset_event never;   // outlives the losers
+  std::atomic<int> cancelled{0};
+  bool whenAnyOk = sync_wait(checkWhenAny(sched, never, cancelled));
+  // a loser that didn't wait yet notices the cancellation when it starts to:
+  for (auto end = Clock::now() + std::chrono::seconds{1};
+       cancelled.load() < 2 && Clock::now() < end; ) {
+    std::this_thread::yield();
+  }
+  check("when_any() cancels the losers", whenAnyOk && cancelled.load() == 2);
+
+  std::cout << "costs (" << num << " ops):\n";
+  cancellation_source source;
+  cancellation_token token = source.token();
+  double reg = nsPerOp(num, [&] {
+    cancellation_registration r{token, [] {}};
+  });
+  std::cout << "  register + deregister:   " << reg << " ns\n";
+
+  int result = 0;
+  double plainWait = nsPerOp(num, [&] {
+    async_manual_reset_event event;
+    waitEvent(cancellation_token{}, event, result);
+    event.set();
+  });
+  std::cout << "  event wait + set:        " << plainWait << " ns\n";
+  double cancellableWait = nsPerOp(num, [&] {
+    async_manual_reset_event event;
+    waitEvent(token, event, result);
+    event.set();
+  });
+  std::cout << "  cancellable wait + set:  " << cancellableWait << " ns\n";
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
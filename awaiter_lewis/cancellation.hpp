@@ -0,0 +1,330 @@
+// cooperative cancellation (names and semantics follow cppcoro by Lewis Baker)
+//  - cancellation_source: requests cancellation
+//  - cancellation_token: cheap copy that observes a source
+//  - cancellation_registration(token, callback): callback() is called
+//    when cancellation is requested (at once, if it already is),
+//    in the thread that calls request_cancellation()
+//  - callbacks must not throw: nobody could handle the exception there,
+//    and the other registrations would wait for the notification forever
+//    (an exception terminates the program, see invoke())
+//  - registering and deregistering are lock-free:
+//    a registration occupies a slot of an array of chunks (CAS of the slot),
+//    request_cancellation() takes each slot with exchange()
+//  - deregistering (the destructor) only waits if the callback is just
+//    running in another thread; a callback may destroy its own registration
+//  - awaiters that were cancelled throw operation_cancelled
+//  - cancellation_token_of(handle): token of an awaiting coroutine whose
+//    promise has a member cancelToken (see CoroTask), nullptr if there is none
+// see also: https://github.com/lewissbaker/cppcoro#cancellationtoken
+
+#ifndef INCLUDED_CANCELLATION_HPP
+#define INCLUDED_CANCELLATION_HPP
+
+#include <coroutine>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <exception>
+#include <concepts>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+class cancellation_registration;
+
+class operation_cancelled : public std::exception
+{
+public:
+  const char* what() const noexcept override {
+    return "operation cancelled";
+  }
+};
+
+
+// state shared by a source, its tokens, and their registrations
+class cancellation_state
+{
+public:
+  static constexpr std::size_t chunk_size = 16;
+
+  struct chunk
+  {
+    std::atomic<cancellation_registration*> slots[chunk_size]{};
+    std::atomic<chunk*> next{nullptr};
+  };
+
+  cancellation_state() noexcept = default;
+  cancellation_state(const cancellation_state&) = delete;
+  cancellation_state& operator=(const cancellation_state&) = delete;
+
+  ~cancellation_state() {
+    chunk* c = m_first.next.load(std::memory_order_relaxed);
+    while (c != nullptr) {
+      chunk* next = c->next.load(std::memory_order_relaxed);
+      delete c;
+      c = next;
+    }
+  }
+
+  void add_ref() noexcept {
+    m_refCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  void release() noexcept {
+    if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  bool is_cancellation_requested() const noexcept {
+    return m_cancelRequested.load(std::memory_order_acquire);
+  }
+
+  // occupy a free slot (chunks are only added, never removed)
+  std::atomic<cancellation_registration*>& add(cancellation_registration* r) {
+    chunk* c = &m_first;
+    while (true) {
+      for (auto& slot : c->slots) {
+        cancellation_registration* expected = nullptr;
+        if (slot.load(std::memory_order_relaxed) == nullptr
+            && slot.compare_exchange_strong(expected, r, std::memory_order_seq_cst)) {
+          return slot;
+        }
+      }
+      chunk* next = c->next.load(std::memory_order_acquire);
+      if (next == nullptr) {
+        chunk* fresh = new chunk;
+        if (c->next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel)) {
+          next = fresh;
+        }
+        else {
+          delete fresh;   // another thread appended a chunk
+        }
+      }
+      c = next;
+    }
+  }
+
+  // returns false if cancellation was already requested
+  bool request_cancellation();
+
+  // called by a registration whose slot was taken by request_cancellation():
+  // returns false if it has to wait until its callback is done
+  bool deregister_taken(cancellation_registration* r) noexcept {
+    if (m_notifyingThread.load(std::memory_order_acquire) != std::this_thread::get_id()) {
+      return false;
+    }
+    // called by a callback: its callback is either done or the running one
+    if (m_invoking == r) {
+      m_invokingDestroyed = true;
+    }
+    return true;
+  }
+
+private:
+  std::atomic<std::uint32_t> m_refCount{1};
+  std::atomic<bool> m_cancelRequested{false};
+  std::atomic<std::thread::id> m_notifyingThread{};
+  // only used by the notifying thread:
+  cancellation_registration* m_invoking = nullptr;
+  bool m_invokingDestroyed = false;
+  chunk m_first;
+};
+
+
+class cancellation_token
+{
+public:
+  cancellation_token() noexcept = default;
+
+  cancellation_token(const cancellation_token& t) noexcept
+  : m_state(t.m_state)
+  {
+    if (m_state != nullptr) {
+      m_state->add_ref();
+    }
+  }
+  cancellation_token(cancellation_token&& t) noexcept
+  : m_state(std::exchange(t.m_state, nullptr))
+  {}
+  cancellation_token& operator=(cancellation_token t) noexcept {
+    std::swap(m_state, t.m_state);
+    return *this;
+  }
+  ~cancellation_token() {
+    if (m_state != nullptr) {
+      m_state->release();
+    }
+  }
+
+  // false for a default-constructed token (cheap to check on fast paths)
+  bool can_be_cancelled() const noexcept {
+    return m_state != nullptr;
+  }
+
+  bool is_cancellation_requested() const noexcept {
+    return m_state != nullptr && m_state->is_cancellation_requested();
+  }
+
+  void throw_if_cancellation_requested() const {
+    if (is_cancellation_requested()) {
+      throw operation_cancelled{};
+    }
+  }
+
+private:
+  friend class cancellation_source;
+  friend class cancellation_registration;
+
+  explicit cancellation_token(cancellation_state* state) noexcept
+  : m_state(state)
+  {
+    m_state->add_ref();
+  }
+
+  cancellation_state* m_state = nullptr;
+};
+
+
+class cancellation_source
+{
+public:
+  cancellation_source()
+  : m_state(new cancellation_state)
+  {}
+
+  // copies share the state
+  cancellation_source(const cancellation_source& s) noexcept
+  : m_state(s.m_state)
+  {
+    m_state->add_ref();
+  }
+  cancellation_source& operator=(const cancellation_source&) = delete;
+  ~cancellation_source() {
+    m_state->release();
+  }
+
+  cancellation_token token() const noexcept {
+    return cancellation_token{m_state};
+  }
+
+  // calls the callbacks of all registrations in this thread
+  void request_cancellation() {
+    m_state->request_cancellation();
+  }
+
+  bool is_cancellation_requested() const noexcept {
+    return m_state->is_cancellation_requested();
+  }
+
+private:
+  cancellation_state* m_state;
+};
+
+
+class cancellation_registration
+{
+public:
+  template <typename FN>
+    requires std::invocable<FN&>
+  cancellation_registration(const cancellation_token& token, FN&& callback)
+  : m_callback(std::forward<FN>(callback))
+  {
+    if (!token.can_be_cancelled()) {
+      return;
+    }
+    if (token.is_cancellation_requested()) {
+      invoke();
+      return;
+    }
+    m_state = token.m_state;
+    m_state->add_ref();
+    m_slot = &m_state->add(this);
+    // cancellation might have been requested before we occupied the slot:
+    if (m_state->is_cancellation_requested()) {
+      cancellation_registration* self = this;
+      if (m_slot->compare_exchange_strong(self, nullptr, std::memory_order_seq_cst)) {
+        m_slot = nullptr;
+        invoke();
+      }
+      // otherwise request_cancellation() took the slot and calls us
+    }
+  }
+
+  cancellation_registration(const cancellation_registration&) = delete;
+  cancellation_registration& operator=(const cancellation_registration&) = delete;
+
+  ~cancellation_registration() {
+    if (m_state == nullptr) {
+      return;
+    }
+    cancellation_registration* self = this;
+    if (m_slot != nullptr
+        && !m_slot->compare_exchange_strong(self, nullptr, std::memory_order_seq_cst)) {
+      // request_cancellation() took the slot: wait until our callback is done
+      // (unless it's running in this thread, i.e. we are destroyed by a callback)
+      if (!m_state->deregister_taken(this)) {
+        while (!m_done.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+      }
+    }
+    m_state->release();
+  }
+
+private:
+  friend class cancellation_state;
+
+  // (noexcept: a callback that throws terminates the program)
+  void invoke() noexcept {
+    m_callback();
+  }
+
+  std::function<void()> m_callback;
+  cancellation_state* m_state = nullptr;
+  std::atomic<cancellation_registration*>* m_slot = nullptr;
+  std::atomic<bool> m_done{false};   // callback called by request_cancellation() is done
+};
+
+inline bool cancellation_state::request_cancellation()
+{
+  if (m_cancelRequested.exchange(true, std::memory_order_seq_cst)) {
+    return false;
+  }
+  add_ref();   // a callback might destroy the registration holding the last reference
+  m_notifyingThread.store(std::this_thread::get_id(), std::memory_order_release);
+  for (chunk* c = &m_first; c != nullptr; c = c->next.load(std::memory_order_acquire)) {
+    for (auto& slot : c->slots) {
+      cancellation_registration* r = slot.exchange(nullptr, std::memory_order_seq_cst);
+      if (r == nullptr) {
+        continue;
+      }
+      m_invoking = r;
+      m_invokingDestroyed = false;
+      r->invoke();
+      if (!m_invokingDestroyed) {
+        r->m_done.store(true, std::memory_order_release);
+      }
+      m_invoking = nullptr;
+    }
+  }
+  m_notifyingThread.store(std::thread::id{}, std::memory_order_release);
+  release();
+  return true;
+}
+
+
+// token of the coroutine behind h (nullptr if its promise has none
+// or if it can't be cancelled anyway)
+template <typename Promise>
+const cancellation_token* cancellation_token_of(std::coroutine_handle<Promise> h) noexcept
+{
+  if constexpr (requires { { h.promise().cancelToken } -> std::convertible_to<const cancellation_token&>; }) {
+    const cancellation_token& token = h.promise().cancelToken;
+    return token.can_be_cancelled() ? &token : nullptr;
+  }
+  else {
+    return nullptr;
+  }
+}
+
+#endif
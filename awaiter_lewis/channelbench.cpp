@@ -0,0 +1,244 @@
+// benchmark and checks for async_channel
+//  - throughput of producer and consumer coroutines on the CoroScheduler:
+//    SPSC, MPSC, and MPMC, each with recv() and recv_batch()
+//    and with waiters resumed inline or posted to the scheduler
+//  - inline, a send resumes the waiting consumer, which takes that one
+//    element and waits again; posted, the consumer runs later (or on
+//    another worker), so that recv_batch() finds many elements
+//  - checks: FIFO order, move-only elements, senders suspend while
+//    the channel is full, close() ends receivers and fails waiting senders
+// usage: channelbench [numWorkers [numPerProducer [capacity [batchSize]]]]
+
+#include "asyncchannel.hpp"
+#include "../async_nico_phil/coroscheduler.hpp"
+#include "../bench/benchfixture.hpp"
+#include <iostream>
+#include <coroutine>
+#include <exception>
+#include <chrono>
+#include <latch>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+using Clock = std::chrono::steady_clock;
+
+double nsPer(Clock::time_point start, std::uint64_t num)
+{
+  std::chrono::duration<double, std::nano> ns = Clock::now() - start;
+  return ns.count() / static_cast<double>(num);
+}
+
+//*** checks (without a scheduler: waiters are resumed inline)
+
+DetachedTask sendPtrs(async_channel<std::unique_ptr<int>>& ch, int num, int& sent)
+{
+  for (int i = 0; i < num; ++i) {
+    if (!co_await ch.send(std::make_unique<int>(i))) {
+      co_return;
+    }
+    ++sent;
+  }
+}
+
+DetachedTask recvPtrs(async_channel<std::unique_ptr<int>>& ch, std::vector<int>& got, bool& done)
+{
+  while (std::optional<std::unique_ptr<int>> p = co_await ch.recv()) {
+    got.push_back(**p);
+  }
+  done = true;
+}
+
+DetachedTask recvPtrBatches(async_channel<std::unique_ptr<int>>& ch, std::size_t batchSize,
+                            std::vector<int>& got, unsigned& resumes, bool& done)
+{
+  std::vector<std::unique_ptr<int>> batch;
+  while (co_await ch.recv_batch(batch, batchSize) > 0) {
+    ++resumes;
+    for (const auto& p : batch) {
+      got.push_back(*p);
+    }
+    batch.clear();
+  }
+  done = true;
+}
+
+bool isSequence(const std::vector<int>& v, int num)
+{
+  if (v.size() != static_cast<std::size_t>(num)) {
+    return false;
+  }
+  for (int i = 0; i < num; ++i) {
+    if (v[static_cast<std::size_t>(i)] != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void checks()
+{
+  std::cout << "checks:\n";
+  {
+    async_channel<std::unique_ptr<int>> ch{4};
+    std::vector<int> got;
+    bool done = false;
+    int sent = 0;
+    recvPtrs(ch, got, done);           // waits
+    sendPtrs(ch, 100, sent);           // each send resumes the receiver
+    check(isSequence(got, 100) && !done, "recv() gets move-only elements in FIFO order");
+    ch.close();
+    check(done, "close() ends a waiting receiver");
+  }
+  {
+    async_channel<std::unique_ptr<int>> ch{4};
+    int sent = 0;
+    sendPtrs(ch, 10, sent);
+    check(sent == 4, "sender suspends while the channel is full (sent " + std::to_string(sent) + ")");
+    std::optional<std::unique_ptr<int>> first = ch.try_recv();
+    check(first && **first == 0 && sent == 5, "try_recv() lets the waiting sender continue");
+    std::vector<int> got;
+    unsigned resumes = 0;
+    bool done = false;
+    recvPtrBatches(ch, 64, got, resumes, done);   // takes 4, lets the sender send the rest
+    ch.close();
+    check(sent == 10 && got.size() == 9 && got.front() == 1 && got.back() == 9 && done,
+          "recv_batch() drains the channel (" + std::to_string(resumes) + " batches)");
+  }
+  {
+    async_channel<std::unique_ptr<int>> ch{2};
+    int sent = 0;
+    sendPtrs(ch, 5, sent);
+    ch.close();
+    std::vector<int> got;
+    bool done = false;
+    recvPtrs(ch, got, done);
+    check(sent == 2 && isSequence(got, 2) && done,
+          "close() fails the waiting sender, receivers get what was sent before");
+    std::unique_ptr<int> p = std::make_unique<int>(42);
+    check(!ch.try_send(p) && p != nullptr, "try_send() to a closed channel keeps the element");
+  }
+}
+
+//*** throughput
+
+using Sched = CoroScheduler<>;
+using Channel = async_channel<std::uint64_t>;
+
+struct Totals {
+  std::atomic<std::uint64_t> count{0};
+  std::atomic<std::uint64_t> sum{0};
+  std::atomic<std::uint64_t> resumes{0};   // of batch consumers (with elements)
+};
+
+DetachedTask producer(Sched& sched, Channel& ch, std::uint64_t first, std::uint64_t num,
+                      std::atomic<unsigned>& producersLeft, std::latch& done)
+{
+  co_await sched.schedule();
+  for (std::uint64_t i = 0; i < num; ++i) {
+    co_await ch.send(first + i);
+  }
+  if (producersLeft.fetch_sub(1) == 1) {
+    ch.close();   // after the last send of all producers
+  }
+  done.count_down();
+}
+
+DetachedTask consumer(Sched& sched, Channel& ch, Totals& totals, std::latch& done)
+{
+  co_await sched.schedule();
+  std::uint64_t count = 0, sum = 0;
+  while (std::optional<std::uint64_t> v = co_await ch.recv()) {
+    ++count;
+    sum += *v;
+  }
+  totals.count.fetch_add(count);
+  totals.sum.fetch_add(sum);
+  done.count_down();
+}
+
+DetachedTask batchConsumer(Sched& sched, Channel& ch, std::size_t batchSize,
+                           Totals& totals, std::latch& done)
+{
+  co_await sched.schedule();
+  std::uint64_t count = 0, sum = 0, resumes = 0;
+  std::vector<std::uint64_t> batch;
+  batch.reserve(batchSize);
+  while (co_await ch.recv_batch(batch, batchSize) > 0) {
+    ++resumes;
+    for (std::uint64_t v : batch) {
+      ++count;
+      sum += v;
+    }
+    batch.clear();
+  }
+  totals.count.fetch_add(count);
+  totals.sum.fetch_add(sum);
+  totals.resumes.fetch_add(resumes);
+  done.count_down();
+}
+
+void run(const std::string& name, Sched& sched, unsigned numProducers, unsigned numConsumers,
+         std::uint64_t numPerProducer, std::size_t capacity, std::size_t batchSize, bool post)
+{
+  std::optional<Channel> ch;
+  if (post) {
+    ch.emplace(capacity, sched);
+  }
+  else {
+    ch.emplace(capacity);
+  }
+  Totals totals;
+  std::atomic<unsigned> producersLeft{numProducers};
+  std::latch done{static_cast<std::ptrdiff_t>(numProducers + numConsumers)};
+  auto start = Clock::now();
+  for (unsigned c = 0; c < numConsumers; ++c) {
+    if (batchSize > 1) {
+      batchConsumer(sched, *ch, batchSize, totals, done);
+    }
+    else {
+      consumer(sched, *ch, totals, done);
+    }
+  }
+  for (unsigned p = 0; p < numProducers; ++p) {
+    producer(sched, *ch, p * numPerProducer, numPerProducer, producersLeft, done);
+  }
+  done.wait();
+  std::uint64_t total = numProducers * numPerProducer;
+  double ns = nsPer(start, total);
+  std::cout << "  " << name << (post ? " posted: " : " inline: ") << ns << " ns per element";
+  if (batchSize > 1) {
+    std::cout << ", " << static_cast<double>(total) / static_cast<double>(totals.resumes.load())
+              << " elements per batch";
+  }
+  std::cout << '\n';
+  check(totals.count.load() == total && totals.sum.load() == total * (total - 1) / 2,
+        name + " received each element once");
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned numWorkers = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1]))
+                                 : std::thread::hardware_concurrency();
+  std::uint64_t num = argc > 2 ? std::stoull(argv[2]) : 1'000'000;
+  std::size_t capacity = argc > 3 ? std::stoul(argv[3]) : 1024;
+  std::size_t batchSize = argc > 4 ? std::stoul(argv[4]) : 64;
+
+  checks();
+
+  Sched sched{numWorkers};
+  std::cout << "throughput (" << sched.numWorkers() << " workers, capacity " << capacity
+            << ", batches of " << batchSize << "):\n";
+  for (bool post : {false, true}) {
+    run("SPSC recv()      ", sched, 1, 1, num, capacity, 1, post);
+    run("SPSC recv_batch()", sched, 1, 1, num, capacity, batchSize, post);
+    run("MPSC recv()      ", sched, 4, 1, num / 4, capacity, 1, post);
+    run("MPSC recv_batch()", sched, 4, 1, num / 4, capacity, batchSize, post);
+    run("MPMC recv()      ", sched, 4, 4, num / 4, capacity, 1, post);
+    run("MPMC recv_batch()", sched, 4, 4, num / 4, capacity, batchSize, post);
+  }
+
+  return checksOk ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+// benchmark for waking the waiters of async_manual_reset_event
+//  - numWaiters coroutines wait for the event, each doing some work
+//    when it is resumed
+//  - set() resumes them one after the other in the producer thread,
+//    set(sched) hands them to the CoroScheduler in one batch
+//  - producer latency: how long set() blocks the producer
+//  - wake latency: from calling set() until a waiter runs
+// usage: eventbench [numWaiters [numWorkers [spinsPerWaiter [numRounds]]]]
+
+#include "asyncevent.hpp"
+#include "../async_nico_phil/coroscheduler.hpp"
+#include "../bench/benchfixture.hpp"
+#include <iostream>
+#include <coroutine>
+#include <exception>
+#include <chrono>
+#include <latch>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+
+using Clock = std::chrono::steady_clock;
+
+std::uint64_t burn(unsigned spins)
+{
+  std::uint64_t x = spins;
+  for (unsigned i = 0; i < spins; ++i) {
+    x = x * 6364136223846793005u + 1442695040888963407u;
+  }
+  return x;
+}
+
+std::atomic<std::uint64_t> sink{0};
+
+DetachedTask waiter(async_manual_reset_event& event, Clock::time_point& resumedAt,
+                    std::latch& done, unsigned spins)
+{
+  co_await event;
+  resumedAt = Clock::now();
+  sink.fetch_add(burn(spins), std::memory_order_relaxed);
+  done.count_down();
+}
+
+struct Result {
+  std::vector<double> producerUs;   // per round
+  std::vector<double> wakeUs;       // per waiter of all rounds
+
+  static double percentile(std::vector<double> v, double p) {
+    std::sort(v.begin(), v.end());
+    return v[static_cast<std::size_t>(p * static_cast<double>(v.size() - 1))];
+  }
+  void print(const char* name) const {
+    std::cout << name << "producer " << percentile(producerUs, 0.5) << " us"
+              << ", wake p50 " << percentile(wakeUs, 0.5) << " us"
+              << ", p99 " << percentile(wakeUs, 0.99) << " us"
+              << ", max " << percentile(wakeUs, 1.0) << " us\n";
+  }
+};
+
+// SET: calls set() or set(sched) on the event
+template <typename SET>
+void round(Result& result, unsigned numWaiters, unsigned spins, SET set)
+{
+  async_manual_reset_event event;
+  std::latch done{static_cast<std::ptrdiff_t>(numWaiters)};
+  std::vector<Clock::time_point> resumedAt(numWaiters);
+  for (unsigned i = 0; i < numWaiters; ++i) {
+    waiter(event, resumedAt[i], done, spins);
+  }
+
+  auto start = Clock::now();
+  set(event);
+  std::chrono::duration<double, std::micro> producer = Clock::now() - start;
+  done.wait();
+
+  result.producerUs.push_back(producer.count());
+  for (auto t : resumedAt) {
+    std::chrono::duration<double, std::micro> wake = t - start;
+    result.wakeUs.push_back(wake.count());
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned numWaiters = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 10'000;
+  unsigned numWorkers = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2]))
+                                 : std::thread::hardware_concurrency();
+  unsigned spins = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 2'000;
+  unsigned numRounds = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : 10;
+
+  CoroScheduler<> sched{numWorkers};
+
+  Result inlineResult, schedResult;
+  for (unsigned r = 0; r < numRounds; ++r) {
+    round(inlineResult, numWaiters, spins, [](auto& event) {
+      event.set();
+    });
+    round(schedResult, numWaiters, spins, [&](auto& event) {
+      event.set(sched);
+    });
+  }
+
+  std::cout << numWaiters << " waiters, " << spins << " spins each, "
+            << sched.numWorkers() << " workers, " << numRounds << " rounds (median producer):\n";
+  inlineResult.print("  set():      ");
+  schedResult.print("  set(sched): ");
+}
@@ -0,0 +1,115 @@
+// elements per second through async_generator pipelines
+//  - source: 0..n-1, pipeline: transform(x * 3) | filter(even)
+//  - pulled element by element with next(), in spans with next_batch(),
+//    and with the batch(n) stage
+//  - compared with a hand-written loop (all variants have to agree on the sum)
+// usage: generatorbench [numElements [batchSize]]
+
+#include "asyncgenerator.hpp"
+#include "../async_nico_phil/corotask.hpp"
+#include "../async_nico_phil/syncwait.hpp"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+using Clock = std::chrono::steady_clock;
+
+async_generator<std::uint64_t> iota(std::uint64_t n)
+{
+  for (std::uint64_t i = 0; i < n; ++i) {
+    co_yield i;
+  }
+}
+
+async_generator<std::uint64_t> pipeline(std::uint64_t n)
+{
+  return filter(transform(iota(n), [](std::uint64_t x) { return x * 3; }),
+                [](std::uint64_t x) { return x % 2 == 0; });
+}
+
+CoroTask<std::uint64_t> sumNext(async_generator<std::uint64_t> gen)
+{
+  std::uint64_t sum = 0;
+  while (std::uint64_t* x = co_await gen.next()) {
+    sum += *x;
+  }
+  co_return sum;
+}
+
+CoroTask<std::uint64_t> sumNextBatch(async_generator<std::uint64_t> gen, std::size_t batchSize)
+{
+  std::vector<std::uint64_t> buf(batchSize);
+  std::uint64_t sum = 0;
+  while (std::size_t num = co_await gen.next_batch(buf)) {
+    for (std::size_t i = 0; i < num; ++i) {
+      sum += buf[i];
+    }
+  }
+  co_return sum;
+}
+
+CoroTask<std::uint64_t> sumBatchStage(async_generator<std::uint64_t> gen, std::size_t batchSize)
+{
+  auto batches = batch(std::move(gen), batchSize);
+  std::uint64_t sum = 0;
+  while (std::span<std::uint64_t>* span = co_await batches.next()) {
+    for (std::uint64_t x : *span) {
+      sum += x;
+    }
+  }
+  co_return sum;
+}
+
+template <typename FN>
+void measure(const char* name, std::uint64_t n, std::uint64_t expected, FN fn)
+{
+  auto start = Clock::now();
+  std::uint64_t sum = fn();
+  std::chrono::duration<double, std::nano> ns = Clock::now() - start;
+  std::cout << name << ns.count() / static_cast<double>(n) << " ns/element, "
+            << static_cast<double>(n) / ns.count() * 1000 << " M elements/s"
+            << (sum == expected ? "" : "  WRONG SUM") << '\n';
+}
+
+int main(int argc, char* argv[])
+{
+  std::uint64_t n = argc > 1 ? std::stoull(argv[1]) : 20'000'000;
+  std::size_t batchSize = argc > 2 ? std::stoul(argv[2]) : 256;
+
+  // hand-written loop (volatile bound so that the loop isn't computed at compile time):
+  volatile std::uint64_t vn = n;
+  auto loop = [&] {
+    std::uint64_t sum = 0;
+    for (std::uint64_t i = 0; i < vn; ++i) {
+      std::uint64_t x = i * 3;
+      if (x % 2 == 0) {
+        sum += x;
+      }
+    }
+    return sum;
+  };
+  std::uint64_t expected = loop();
+  std::uint64_t sourceSum = n * (n - 1) / 2;
+
+  std::cout << n << " elements, batches of " << batchSize << ":\n";
+  measure("loop:                  ", n, expected, loop);
+  std::cout << "source only:\n";
+  measure("  next():              ", n, sourceSum, [&] {
+    return sync_wait(sumNext(iota(n)));
+  });
+  measure("  next_batch():        ", n, sourceSum, [&] {
+    return sync_wait(sumNextBatch(iota(n), batchSize));
+  });
+  std::cout << "transform | filter:\n";
+  measure("  next():              ", n, expected, [&] {
+    return sync_wait(sumNext(pipeline(n)));
+  });
+  measure("  next_batch():        ", n, expected, [&] {
+    return sync_wait(sumNextBatch(pipeline(n), batchSize));
+  });
+  measure("  batch(n) stage:      ", n, expected, [&] {
+    return sync_wait(sumBatchStage(pipeline(n), batchSize));
+  });
+}
@@ -0,0 +1,47 @@
+// fixtures shared by the benchmarks and demos
+//  - DetachedTask: fire-and-forget coroutine
+//    (starts at once, its frame destroys itself at the end,
+//     an exception that escapes it terminates the program)
+//  - CancellableDetachedTask: DetachedTask whose awaits are cancelled
+//    by the token passed as first argument (see cancellation_token_of())
+//  - check(): prints the outcome of a check, checksOk tells whether all passed
+
+#ifndef INCLUDED_BENCH_FIXTURE_HPP
+#define INCLUDED_BENCH_FIXTURE_HPP
+
+#include "../awaiter_lewis/cancellation.hpp"
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <string>
+
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+struct CancellableDetachedTask {
+  struct promise_type : DetachedTask::promise_type {
+    cancellation_token cancelToken;
+
+    template <typename... Args>
+    promise_type(const cancellation_token& token, Args&...) : cancelToken{token} {}
+
+    CancellableDetachedTask get_return_object() noexcept { return {}; }
+  };
+};
+
+inline bool checksOk = true;
+
+inline void check(bool ok, const std::string& what)
+{
+  std::cout << "  " << (ok ? "OK:     " : "FAILED: ") << what << '\n';
+  checksOk = checksOk && ok;
+}
+
+#endif
@@ -0,0 +1,314 @@
+// minimal micro-benchmark harness for the coroutine primitives
+//  - measure(name, opsPerSample, numSamples, fn):
+//    fn(ops) performs the operation ops times and is timed as one sample
+//    (batches keep the clock overhead out of operations of a few ns)
+//  - measureLatency(name, numSamples, fn):
+//    fn() performs the operation once and returns its latency itself
+//  - each result is printed as one JSON object per line (JSON Lines):
+//      {"name":..., "ops":..., "ns_per_op":..., "allocs_per_op":...,
+//       "p50_ns":..., "p90_ns":..., "p99_ns":..., "max_ns":...}
+//    ns_per_op is the mean, the percentiles are over the samples (per op)
+//  - allocations/op counts calls of the global operator new of all threads
+//    (frames served by the FramePool are no allocations);
+//    the replacement operators are defined in this header,
+//    so include it in exactly one translation unit
+//  - a baseline (earlier output) can be compared: a p50 that got slower by
+//    more than the threshold is reported as a regression
+
+#ifndef INCLUDED_BENCH_HARNESS_HPP
+#define INCLUDED_BENCH_HARNESS_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+
+//*** counting global operator new/delete
+// (all forms, so that none of them pairs the allocation of the library
+//  with a deallocation of ours)
+
+inline std::atomic<std::uint64_t> benchAllocations{0};
+
+inline void* benchAllocate(std::size_t sz) noexcept
+{
+  benchAllocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(sz == 0 ? 1 : sz);
+}
+
+inline void* benchAllocate(std::size_t sz, std::align_val_t al) noexcept
+{
+  benchAllocations.fetch_add(1, std::memory_order_relaxed);
+  auto align = static_cast<std::size_t>(al);
+  // (aligned_alloc() wants a multiple of the alignment)
+  return std::aligned_alloc(align, (std::max<std::size_t>(sz, 1) + align - 1) / align * align);
+}
+
+void* operator new(std::size_t sz)
+{
+  if (void* p = benchAllocate(sz)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+void* operator new[](std::size_t sz)
+{
+  return ::operator new(sz);
+}
+void* operator new(std::size_t sz, const std::nothrow_t&) noexcept
+{
+  return benchAllocate(sz);
+}
+void* operator new[](std::size_t sz, const std::nothrow_t&) noexcept
+{
+  return benchAllocate(sz);
+}
+
+void* operator new(std::size_t sz, std::align_val_t al)
+{
+  if (void* p = benchAllocate(sz, al)) {
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+void* operator new[](std::size_t sz, std::align_val_t al)
+{
+  return ::operator new(sz, al);
+}
+void* operator new(std::size_t sz, std::align_val_t al, const std::nothrow_t&) noexcept
+{
+  return benchAllocate(sz, al);
+}
+void* operator new[](std::size_t sz, std::align_val_t al, const std::nothrow_t&) noexcept
+{
+  return benchAllocate(sz, al);
+}
+
+// GCC warns when it inlines free() into a caller whose pointer came from
+// operator new (it doesn't know that this new is malloc() as well)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+
+//*** results
+
+struct BenchResult {
+  std::string name;
+  std::uint64_t ops = 0;          // operations measured in total
+  double nsPerOp = 0;             // mean
+  double allocsPerOp = 0;
+  double p50 = 0, p90 = 0, p99 = 0, max = 0;   // ns per op of the samples
+};
+
+inline void printJson(std::ostream& strm, const BenchResult& r)
+{
+  strm << "{\"name\":\"" << r.name << "\",\"ops\":" << r.ops
+       << ",\"ns_per_op\":" << r.nsPerOp << ",\"allocs_per_op\":" << r.allocsPerOp
+       << ",\"p50_ns\":" << r.p50 << ",\"p90_ns\":" << r.p90
+       << ",\"p99_ns\":" << r.p99 << ",\"max_ns\":" << r.max << "}" << std::endl;
+}
+
+class BenchHarness {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+ private:
+  std::string filter_;                        // only run benchmarks containing this
+  std::map<std::string, double> baseline_;    // name => p50 of the baseline
+  double threshold_ = 0.2;                    // tolerated slowdown of the p50
+  std::vector<BenchResult> results_;
+  unsigned numRegressions_ = 0;
+
+  // value of "key": in a line written by printJson()
+  static double jsonNumber(const std::string& line, std::string_view key) {
+    std::string pattern = "\"" + std::string{key} + "\":";
+    auto pos = line.find(pattern);
+    return pos == std::string::npos ? -1.0 : std::atof(line.c_str() + pos + pattern.size());
+  }
+
+  static double percentile(const std::vector<double>& sorted, double p) {
+    auto idx = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[idx];
+  }
+
+  void report(std::string_view name, std::uint64_t ops, std::uint64_t allocs,
+              std::vector<double>& nsPerOp) {
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+    BenchResult r;
+    r.name = name;
+    r.ops = ops;
+    double sum = 0;
+    for (double ns : nsPerOp) {
+      sum += ns;
+    }
+    r.nsPerOp = sum / static_cast<double>(nsPerOp.size());
+    r.allocsPerOp = static_cast<double>(allocs) / static_cast<double>(ops);
+    r.p50 = percentile(nsPerOp, 0.5);
+    r.p90 = percentile(nsPerOp, 0.9);
+    r.p99 = percentile(nsPerOp, 0.99);
+    r.max = nsPerOp.back();
+    printJson(std::cout, r);
+
+    if (auto pos = baseline_.find(r.name); pos != baseline_.end()) {
+      if (r.p50 > pos->second * (1 + threshold_)) {
+        std::cerr << "REGRESSION: " << r.name << ": p50 " << r.p50 << " ns/op, baseline "
+                  << pos->second << " ns/op\n";
+        ++numRegressions_;
+      }
+    }
+    results_.push_back(std::move(r));
+  }
+
+ public:
+  // command line: [--filter substring] [--baseline file.jsonl] [--threshold percent]
+  BenchHarness(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+      std::string_view opt{argv[i]};
+      if (opt == "--filter") {
+        filter_ = argv[i + 1];
+      }
+      else if (opt == "--baseline") {
+        loadBaseline(argv[i + 1]);
+      }
+      else if (opt == "--threshold") {
+        threshold_ = std::atof(argv[i + 1]) / 100;
+      }
+      else {
+        std::cerr << "unknown option " << opt << '\n';
+      }
+    }
+  }
+
+  void loadBaseline(const char* path) {
+    std::ifstream in{path};
+    if (!in) {
+      std::cerr << "can't read baseline " << path << '\n';
+      return;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+      auto begin = line.find("\"name\":\"");
+      if (begin == std::string::npos) {
+        continue;
+      }
+      begin += 8;
+      auto end = line.find('"', begin);
+      baseline_[line.substr(begin, end - begin)] = jsonNumber(line, "p50_ns");
+    }
+  }
+
+  bool enabled(std::string_view name) const {
+    return name.find(filter_) != std::string_view::npos;
+  }
+
+  // fn(ops) performs the operation ops times
+  template <typename FN>
+  void measure(std::string_view name, std::uint64_t opsPerSample, unsigned numSamples, FN fn) {
+    if (!enabled(name)) {
+      return;
+    }
+    fn(opsPerSample);   // warm up (e.g. fill the frame pool)
+    std::vector<double> nsPerOp;
+    nsPerOp.reserve(numSamples);   // allocated before counting
+    std::uint64_t allocsBefore = benchAllocations.load();
+    for (unsigned s = 0; s < numSamples; ++s) {
+      auto start = Clock::now();
+      fn(opsPerSample);
+      std::chrono::duration<double, std::nano> ns = Clock::now() - start;
+      nsPerOp.push_back(ns.count() / static_cast<double>(opsPerSample));
+    }
+    std::uint64_t allocs = benchAllocations.load() - allocsBefore;
+    report(name, opsPerSample * numSamples, allocs, nsPerOp);
+  }
+
+  // fn() performs the operation once and returns its latency in ns
+  template <typename FN>
+  void measureLatency(std::string_view name, unsigned numSamples, FN fn) {
+    if (!enabled(name)) {
+      return;
+    }
+    fn();   // warm up
+    std::vector<double> latencies(numSamples);   // allocated before counting
+    std::uint64_t allocsBefore = benchAllocations.load();
+    for (unsigned s = 0; s < numSamples; ++s) {
+      latencies[s] = fn();
+    }
+    std::uint64_t allocs = benchAllocations.load() - allocsBefore;
+    report(name, numSamples, allocs, latencies);
+  }
+
+  const std::vector<BenchResult>& results() const noexcept {
+    return results_;
+  }
+
+  // number of benchmarks slower than the baseline (exit code)
+  unsigned numRegressions() const noexcept {
+    return numRegressions_;
+  }
+};
+
+#endif
@@ -0,0 +1,224 @@
+// micro-benchmark suite for the coroutine primitives of this repository
+//  - create/destroy:  CoroTask (async_nico_phil) and CoTask (sched_charles)
+//  - resume/suspend round trip of a CoTask, co_await of a CoroTask child
+//  - a small request tree with frames from the FramePool and from a FrameArena
+//  - CoroScheduler::schedule() hops (own deque), also with SchedMetrics,
+//    and posts from another thread
+//  - cotask dispatch: pop from the PriorityRunQueue, resume, push back
+//  - async_manual_reset_event: set() to resume latency
+//    (inline and handed to the scheduler with set(sched))
+// output: one JSON object per line (see benchharness.hpp)
+// usage: corobench [--filter substring] [--baseline file.jsonl] [--threshold percent]
+//  - exit code: number of benchmarks whose p50 regressed against the baseline
+
+#include "benchharness.hpp"
+#include "../async_nico_phil/corotask.hpp"
+#include "../async_nico_phil/coroscheduler.hpp"
+#include "../async_nico_phil/syncwait.hpp"
+#include "../framepool/framearena.hpp"
+#include "../awaiter_lewis/asyncevent.hpp"
+#include "../sched_charles/cotask.hpp"
+#include "benchfixture.hpp"
+#include <coroutine>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+using Clock = BenchHarness::Clock;
+
+CoroTask<> emptyTask()
+{
+  co_return;
+}
+
+CoroTask<int> valueTask(int i)
+{
+  co_return i;
+}
+
+CoroTask<std::uint64_t> awaitChildren(std::uint64_t num)
+{
+  std::uint64_t sum = 0;
+  for (std::uint64_t i = 0; i < num; ++i) {
+    sum += static_cast<std::uint64_t>(co_await valueTask(static_cast<int>(i & 0xff)));
+  }
+  co_return sum;
+}
+
+// a small request tree: the root awaits 8 children
+CoroTask<std::uint64_t> requestTree()
+{
+  std::uint64_t sum = 0;
+  for (int i = 0; i < 8; ++i) {
+    sum += static_cast<std::uint64_t>(co_await valueTask(i));
+  }
+  co_return sum;
+}
+
+// same with all frames in the arena
+CoroTask<int> valueTaskIn(std::allocator_arg_t, FrameArena&, int i)
+{
+  co_return i;
+}
+
+CoroTask<std::uint64_t> requestTreeIn(std::allocator_arg_t, FrameArena& arena)
+{
+  std::uint64_t sum = 0;
+  for (int i = 0; i < 8; ++i) {
+    sum += static_cast<std::uint64_t>(co_await valueTaskIn(std::allocator_arg, arena, i));
+  }
+  co_return sum;
+}
+
+// runs forever, suspends after each step
+CoTask spinningCoTask(CoTaskInfo)
+{
+  while (true) {
+    co_await std::suspend_always{};
+  }
+}
+
+template <typename Sched>
+CoroTask<> hops(Sched& sched, std::uint64_t num)
+{
+  for (std::uint64_t i = 0; i < num; ++i) {
+    co_await sched.schedule();
+  }
+}
+
+// waits for the event (on a worker of sched if not nullptr)
+// and records when it was resumed
+template <typename Sched>
+DetachedTask eventWaiter(Sched* sched, async_manual_reset_event& event,
+                         std::atomic<bool>& waiting, std::atomic<std::int64_t>& resumedAt)
+{
+  if (sched != nullptr) {
+    co_await sched->schedule();
+  }
+  waiting.store(true);
+  co_await event;
+  resumedAt.store(Clock::now().time_since_epoch().count());
+}
+
+// latency from set() (inline or via the scheduler) to the resumption of one waiter
+template <typename Sched>
+double eventLatency(Sched* sched)
+{
+  async_manual_reset_event event;
+  std::atomic<bool> waiting{false};
+  std::atomic<std::int64_t> resumedAt{0};
+  eventWaiter(sched, event, waiting, resumedAt);
+  while (!waiting.load()) {
+    std::this_thread::yield();
+  }
+  if (sched != nullptr) {
+    // let the waiter suspend on the event
+    std::this_thread::sleep_for(std::chrono::microseconds{20});
+  }
+  auto start = Clock::now();
+  if (sched != nullptr) {
+    event.set(*sched);
+  }
+  else {
+    event.set();
+  }
+  while (resumedAt.load() == 0) {
+    std::this_thread::yield();
+  }
+  return static_cast<double>(resumedAt.load() - start.time_since_epoch().count());
+}
+
+int main(int argc, char* argv[])
+{
+  BenchHarness bench{argc, argv};
+  using Sched = CoroScheduler<>;
+
+  bench.measure("corotask_create_destroy", 10'000, 200, [](std::uint64_t num) {
+    for (std::uint64_t i = 0; i < num; ++i) {
+      auto task = emptyTask();
+    }
+  });
+
+  bench.measure("cotask_create_destroy", 10'000, 200, [](std::uint64_t num) {
+    for (std::uint64_t i = 0; i < num; ++i) {
+      CoTask task = spinningCoTask(CoTaskInfo{0, "t", 0, 0, 0});
+    }
+  });
+
+  bench.measure("cotask_resume_roundtrip", 100'000, 200, [] {
+    // created once, so only the round trips are measured
+    static CoTask task = spinningCoTask(CoTaskInfo{0, "t", 0, 0, 0});
+    return [](std::uint64_t num) {
+      for (std::uint64_t i = 0; i < num; ++i) {
+        task.resume();
+      }
+    };
+  }());
+
+  bench.measure("corotask_await_child", 10'000, 200, [](std::uint64_t num) {
+    sync_wait(awaitChildren(num));
+  });
+
+  bench.measure("corotask_request_tree_pool", 10'000, 200, [](std::uint64_t num) {
+    for (std::uint64_t i = 0; i < num; ++i) {
+      sync_wait(requestTree());
+    }
+  });
+
+  bench.measure("corotask_request_tree_arena", 10'000, 200, [](std::uint64_t num) {
+    // rewound after each tree
+    static FrameArena arena;
+    for (std::uint64_t i = 0; i < num; ++i) {
+      sync_wait(requestTreeIn(std::allocator_arg, arena));
+    }
+  });
+
+  bench.measure("coroscheduler_schedule_hop", 10'000, 100, [](std::uint64_t num) {
+    static Sched sched{1};
+    sync_wait(hops(sched, num));
+  });
+
+  bench.measure("coroscheduler_schedule_hop_metrics", 10'000, 100, [](std::uint64_t num) {
+    static CoroScheduler<NoInstrumentation, SchedMetrics> sched{1};
+    sync_wait(hops(sched, num));
+  });
+
+  bench.measure("coroscheduler_post_external", 10'000, 100, [](std::uint64_t num) {
+    // every hop from a non-worker thread goes through the injection queue
+    static Sched sched{1};
+    for (std::uint64_t i = 0; i < num; ++i) {
+      sync_wait(hops(sched, 1));
+    }
+  });
+
+  bench.measure("cotask_dispatch", 100'000, 100, [] {
+    static std::vector<std::unique_ptr<CoTask>> tasks;
+    static PriorityRunQueue<CoTask> runnable;
+    for (int i = 0; i < 64; ++i) {
+      // (CoTask is not movable)
+      tasks.emplace_back(new CoTask(spinningCoTask(CoTaskInfo{i % 8, "t", 0, 0, 0})));
+      runnable.push(*tasks.back(), runnable.clampPriority(tasks.back()->getPriority()));
+    }
+    return [](std::uint64_t num) {
+      for (std::uint64_t i = 0; i < num; ++i) {
+        CoTask* task = runnable.pop();
+        task->resume();
+        runnable.push(*task, runnable.clampPriority(task->getPriority()));
+      }
+    };
+  }());
+
+  bench.measureLatency("event_set_resume_inline", 10'000, [] {
+    return eventLatency<Sched>(nullptr);
+  });
+
+  bench.measureLatency("event_set_resume_sched", 2'000, [] {
+    static Sched sched{1};
+    return eventLatency(&sched);
+  });
+
+  return static_cast<int>(bench.numRegressions());
+}
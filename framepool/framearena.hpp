@@ -0,0 +1,127 @@
+// bump arena for the coroutine frames of one task tree (e.g. one request)
+//  - coroutines whose promise supports it (see CoroTask) take the arena
+//    with the std::allocator_arg convention:
+//      CoroTask<> handle(std::allocator_arg_t, FrameArena& arena, Request& req) {
+//        co_await parse(std::allocator_arg, arena, req);   // pass it on
+//        ...
+//      }
+//      FrameArena arena;
+//      sync_wait(handle(std::allocator_arg, arena, req));
+//  - frames are carved from one contiguous block with an atomic bump pointer,
+//    so the frames of a tree are close to each other, and worker threads
+//    that create frames of the same tree only share one compare-exchange
+//    (the bump pointer and the number of live frames are one atomic word,
+//     so a frame is carved and counted, or the block rewound, in one step)
+//  - freeing a frame only counts it; when the last frame of the tree is gone
+//    (the root finished), the whole block is rewound at once and can be
+//    reused by the next tree
+//  - freed frames are not reused before the tree is done,
+//    so size the arena for all frames a tree creates
+//  - only one tree at a time may use an arena
+//  - if the block is exhausted, frames come from the FramePool (overflows)
+//  - frames are freed by FramePool::deallocate() (see FrameOwner)
+
+#ifndef INCLUDED_FRAME_ARENA_HPP
+#define INCLUDED_FRAME_ARENA_HPP
+
+#include "framepool.hpp"
+#include <atomic>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+
+struct FrameArenaStats {
+  std::uint64_t overflows = 0;   // frames served by the FramePool
+  std::uint64_t rewinds = 0;     // task trees finished
+  std::size_t highWater = 0;     // most bytes of the block used by a tree
+};
+
+class FrameArena final : public FrameOwner {
+ public:
+  static constexpr std::size_t alignment = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+ private:
+  // state_: frames of the block not freed yet (high bits)
+  //         and bump pointer (offset into the block, low bits)
+  static constexpr unsigned liveShift = 40;
+  static constexpr std::uint64_t oneLive = std::uint64_t{1} << liveShift;
+  static constexpr std::uint64_t usedMask = oneLive - 1;
+
+  std::byte* block_;
+  std::size_t capacity_;
+  std::atomic<std::uint64_t> state_{0};
+  std::atomic<std::uint64_t> overflows_{0};
+  std::atomic<std::uint64_t> rewinds_{0};
+  std::atomic<std::size_t> highWater_{0};
+
+  static std::size_t roundUp(std::size_t sz) noexcept {
+    return (sz + alignment - 1) & ~(alignment - 1);
+  }
+
+  // one frame less: the last one rewinds the block
+  // (from the exact state it saw, so that an allocate() meanwhile
+  //  makes it retry as one frame less instead of being lost)
+  void release() noexcept {
+    std::uint64_t old = state_.load(std::memory_order_relaxed);
+    while (true) {
+      bool last = (old >> liveShift) == 1;
+      if (state_.compare_exchange_weak(old, last ? 0 : old - oneLive,
+                                       std::memory_order_acq_rel, std::memory_order_relaxed)) {
+        if (last) {
+          std::size_t used = static_cast<std::size_t>(old & usedMask);
+          if (used > highWater_.load(std::memory_order_relaxed)) {
+            highWater_.store(used, std::memory_order_relaxed);
+          }
+          rewinds_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+      }
+    }
+  }
+
+ public:
+  explicit FrameArena(std::size_t capacity = 64 * 1024)
+   : block_{static_cast<std::byte*>(::operator new(roundUp(capacity)))},
+     capacity_{roundUp(capacity)} {
+  }
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  // all frames of the block have to be freed before
+  ~FrameArena() {
+    ::operator delete(block_);
+  }
+
+  void* allocate(std::size_t size) {
+    std::size_t need = FramePool::headerSize + roundUp(size);
+    // (acquire: after a rewind, the frames of the last tree are done with the block)
+    std::uint64_t old = state_.load(std::memory_order_relaxed);
+    do {
+      if ((old & usedMask) + need > capacity_) {
+        // (the bump pointer stays where it is: the block is not touched)
+        overflows_.fetch_add(1, std::memory_order_relaxed);
+        return FramePool::allocate(size);
+      }
+    } while (!state_.compare_exchange_weak(old, old + oneLive + need,
+                                           std::memory_order_acquire, std::memory_order_relaxed));
+    return FramePool::ownedFrame(block_ + (old & usedMask), this);
+  }
+
+  // called by FramePool::deallocate()
+  void deallocateFrame(void*) noexcept override {
+    release();
+  }
+
+  std::size_t capacity() const noexcept {
+    return capacity_;
+  }
+
+  FrameArenaStats stats() const noexcept {
+    return FrameArenaStats{overflows_.load(std::memory_order_relaxed),
+                           rewinds_.load(std::memory_order_relaxed),
+                           highWater_.load(std::memory_order_relaxed)};
+  }
+};
+
+#endif
@@ -0,0 +1,393 @@
+// pooled allocation of coroutine frames
+//  - use it in a promise type:
+//      static void* operator new(std::size_t sz) { return FramePool::allocate(sz); }
+//      static void operator delete(void* p) noexcept { FramePool::deallocate(p); }
+//  - each thread has freelists for size classes of 64 bytes up to 2 KB
+//  - a frame freed by another thread is pushed (lock-free) onto the
+//    remote-free list of the pool it came from;
+//    the owning thread collects these frames when its freelist runs empty
+//  - larger frames use the global operator new/delete
+//  - the pool of a finished thread is kept and adopted by the next new thread,
+//    so that frames it handed out can still be freed safely
+//  - frames of other allocators (a FrameOwner, e.g. FrameArena) get a header
+//    with their owner (see ownedFrame()), so that deallocate() hands them back
+//  - a thread bound to a NUMA node (see bindToNode(), e.g. a pinned worker)
+//    carves new frames from slabs of its own that prefer memory of that node
+//    (mbind(), Linux only) and are first touched by it;
+//    such frames are always kept in the freelists (slabs are never released);
+//    when the thread leaves the node (rebinds or exits), the rest of its slab
+//    is kept for the next thread that needs a slab of that node
+//    (a slab no frame was carved from yet is unmapped instead)
+
+#ifndef INCLUDED_FRAME_POOL_HPP
+#define INCLUDED_FRAME_POOL_HPP
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct FramePoolStats {
+  std::uint64_t hits = 0;         // allocations served from a freelist
+  std::uint64_t misses = 0;       // allocations served by global operator new or a node slab
+  std::uint64_t remoteFrees = 0;  // frames freed by a thread other than the allocating one
+  std::uint64_t nodeFrames = 0;   // misses served by a slab of the node of the thread
+
+  FramePoolStats& operator+= (const FramePoolStats& s) noexcept {
+    hits += s.hits;
+    misses += s.misses;
+    remoteFrees += s.remoteFrees;
+    nodeFrames += s.nodeFrames;
+    return *this;
+  }
+};
+
+// allocator of frames outside the pools (see FramePool::ownedFrame())
+class FrameOwner {
+ public:
+  virtual void deallocateFrame(void* frame) noexcept = 0;
+ protected:
+  ~FrameOwner() = default;
+};
+
+class FramePool {
+ public:
+  static constexpr std::size_t granularity = 64;
+  static constexpr std::size_t numClasses = 32;        // blocks up to 2 KB
+  static constexpr std::size_t maxFreePerClass = 256;  // frames kept beyond that are released
+  static constexpr std::size_t slabSize = 256 * 1024;  // carved into frames of a node
+
+ private:
+  struct Pool;
+
+  static constexpr std::uint32_t ownedClass = numClasses + 1;
+
+  // header in front of each frame:
+  // - while the frame is in use: owning pool (nullptr for large frames)
+  //   or owning FrameOwner (sizeClass ownedClass)
+  // - while the frame is free: next frame in the freelist
+  struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Header {
+    union {
+      Pool* pool;
+      FrameOwner* owner;
+      Header* next;
+    };
+    std::uint32_t sizeClass;
+    bool fromSlab;   // part of a node slab (never released)
+  };
+
+  struct Pool {
+    Header* freeLists[numClasses]{};
+    std::size_t freeCounts[numClasses]{};
+    std::atomic<Header*> remoteFrees{nullptr};
+    // written only by the owning thread, read by stats():
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+    std::atomic<std::uint64_t> nodeFrames{0};
+    // node slab of the owning thread (if bound to a node):
+    bool nodeBound = false;
+    int node = -1;   // kernel id of the node (-1: none, first touch only)
+    std::byte* slabNext = nullptr;
+    std::byte* slabEnd = nullptr;
+    // written by any thread:
+    std::atomic<std::uint64_t> remoteFreeCount{0};
+    bool orphaned = false;   // protected by registry mutex
+  };
+
+  // unused end of a node slab a thread left
+  struct SlabRest {
+    int node;
+    std::byte* next;
+    std::byte* end;
+  };
+
+  struct Registry {
+    std::mutex mx;
+    std::vector<Pool*> pools;   // never shrinks: pools are adopted, not deleted
+    std::vector<SlabRest> slabRests;
+  };
+
+  static Registry& registry() {
+    static Registry* reg = new Registry;   // intentionally leaked (frames may outlive main())
+    return *reg;
+  }
+
+  // pool of the calling thread while its Binding lives (nullptr before and after):
+  // trivially destructible, so it can still be read during thread exit
+  // and static destruction, when the Binding may already be gone
+  static inline thread_local Pool* boundPool = nullptr;
+
+  // thread-local binding to a pool
+  struct Binding {
+    Pool* pool;
+    Binding() {
+      Registry& reg = registry();
+      std::lock_guard lock{reg.mx};
+      pool = nullptr;
+      for (Pool* p : reg.pools) {
+        if (p->orphaned) {
+          p->orphaned = false;
+          p->nodeBound = false;   // (the rest of its slab was kept when it was orphaned)
+          p->node = -1;
+          p->slabNext = p->slabEnd = nullptr;
+          pool = p;
+          break;
+        }
+      }
+      if (pool == nullptr) {
+        pool = new Pool;
+        reg.pools.push_back(pool);
+      }
+      boundPool = pool;
+    }
+    ~Binding() {
+      boundPool = nullptr;   // later frees of this thread are remote frees
+      Registry& reg = registry();
+      std::lock_guard lock{reg.mx};
+      leaveSlab(reg, pool);
+      pool->orphaned = true;
+    }
+  };
+
+  static Pool* localPool() {
+    Pool* pool = boundPool;
+    if (pool != nullptr) {
+      return pool;
+    }
+    thread_local Binding binding;
+    return binding.pool;
+  }
+
+  static void bump(std::atomic<std::uint64_t>& counter) noexcept {
+    // single writer: no read-modify-write needed
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  // new slab for the node of the pool (nullptr if there is no memory)
+  static std::byte* newSlab(int node) noexcept {
+#ifdef __linux__
+    void* p = ::mmap(nullptr, slabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      return nullptr;
+    }
+    if (node >= 0 && node < 64) {
+      // prefer the node; if that fails (no NUMA support, simulated node),
+      // the first touch by this thread still makes the pages local:
+      constexpr int mpolPreferred = 1;
+      unsigned long mask = 1UL << node;
+      [[maybe_unused]] long ret = ::syscall(SYS_mbind, p, slabSize, mpolPreferred, &mask,
+                                            8 * sizeof(mask) + 1, 0);
+    }
+    return static_cast<std::byte*>(p);
+#else
+    (void)node;
+    return nullptr;
+#endif
+  }
+
+  // the thread of pool leaves its slab (with reg.mx locked):
+  // keep the rest for another thread of the node, or unmap it if it is unused
+  static void leaveSlab(Registry& reg, Pool* pool) noexcept {
+    std::size_t rest = static_cast<std::size_t>(pool->slabEnd - pool->slabNext);
+    if (rest == slabSize) {
+#ifdef __linux__
+      ::munmap(pool->slabNext, slabSize);
+#endif
+    }
+    else if (rest >= granularity) {
+      try {
+        reg.slabRests.push_back(SlabRest{pool->node, pool->slabNext, pool->slabEnd});
+      }
+      catch (const std::bad_alloc&) {
+        // (the rest is dropped)
+      }
+    }
+    pool->slabNext = pool->slabEnd = nullptr;
+  }
+
+  // rest of a slab of node with room for size bytes, which another thread left
+  // (false if there is none)
+  static bool takeSlabRest(Pool* pool, std::size_t size) {
+    Registry& reg = registry();
+    std::lock_guard lock{reg.mx};
+    for (SlabRest& r : reg.slabRests) {
+      if (r.node == pool->node && static_cast<std::size_t>(r.end - r.next) >= size) {
+        pool->slabNext = r.next;
+        pool->slabEnd = r.end;
+        r = reg.slabRests.back();
+        reg.slabRests.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // new frame of size class c from the node slab of the pool (nullptr if there is no memory)
+  static Header* carveFromSlab(Pool* pool, std::size_t c) {
+    std::size_t size = (c + 1) * granularity;
+    if (static_cast<std::size_t>(pool->slabEnd - pool->slabNext) < size
+        && !takeSlabRest(pool, size)) {
+      std::byte* slab = newSlab(pool->node);
+      if (slab == nullptr) {
+        return nullptr;
+      }
+      pool->slabNext = slab;
+      pool->slabEnd = slab + slabSize;
+    }
+    Header* h = ::new (pool->slabNext) Header;
+    pool->slabNext += size;
+    h->fromSlab = true;
+    bump(pool->nodeFrames);
+    return h;
+  }
+
+  static void pushFree(Pool* pool, Header* h) noexcept {
+    std::size_t c = h->sizeClass;
+    if (pool->freeCounts[c] >= maxFreePerClass && !h->fromSlab) {
+      ::operator delete(h);
+      return;
+    }
+    h->next = pool->freeLists[c];
+    pool->freeLists[c] = h;
+    ++pool->freeCounts[c];
+  }
+
+  // move frames other threads gave back into the freelists
+  static void collectRemoteFrees(Pool* pool) noexcept {
+    Header* h = pool->remoteFrees.exchange(nullptr, std::memory_order_acquire);
+    while (h != nullptr) {
+      Header* next = h->next;
+      pushFree(pool, h);
+      h = next;
+    }
+  }
+
+ public:
+  // bytes in front of each frame
+  static constexpr std::size_t headerSize = sizeof(Header);
+
+  // turn block (headerSize + frame size bytes, suitably aligned)
+  // into a frame that deallocate() hands back to owner
+  static void* ownedFrame(void* block, FrameOwner* owner) noexcept {
+    Header* h = ::new (block) Header;
+    h->owner = owner;
+    h->sizeClass = ownedClass;
+    return h + 1;
+  }
+
+  static void* allocate(std::size_t size) {
+    std::size_t c = (size + sizeof(Header) - 1) / granularity;
+    if (c >= numClasses) {
+      Header* h = static_cast<Header*>(::operator new(sizeof(Header) + size));
+      h->pool = nullptr;
+      h->sizeClass = numClasses;
+      h->fromSlab = false;
+      bump(localPool()->misses);
+      return h + 1;
+    }
+
+    Pool* pool = localPool();
+    if (pool->freeLists[c] == nullptr) {
+      collectRemoteFrees(pool);
+    }
+    Header* h = pool->freeLists[c];
+    if (h != nullptr) {
+      pool->freeLists[c] = h->next;
+      --pool->freeCounts[c];
+      bump(pool->hits);
+    }
+    else {
+      h = pool->nodeBound ? carveFromSlab(pool, c) : nullptr;
+      if (h == nullptr) {
+        h = static_cast<Header*>(::operator new((c + 1) * granularity));
+        h->fromSlab = false;
+      }
+      h->sizeClass = static_cast<std::uint32_t>(c);
+      bump(pool->misses);
+    }
+    h->pool = pool;
+    return h + 1;
+  }
+
+  static void deallocate(void* p) noexcept {
+    if (p == nullptr) {
+      return;
+    }
+    Header* h = static_cast<Header*>(p) - 1;
+    if (h->sizeClass == ownedClass) {
+      h->owner->deallocateFrame(p);
+      return;
+    }
+    Pool* owner = h->pool;
+    if (owner == nullptr) {
+      ::operator delete(h);
+      return;
+    }
+    // (no localPool(): the thread might be exiting with its Binding destroyed)
+    Pool* pool = boundPool;
+    if (owner == pool) {
+      pushFree(pool, h);
+      return;
+    }
+    // frame of another thread (or freed after the Binding of this thread is gone):
+    // give it back to its pool
+    owner->remoteFreeCount.fetch_add(1, std::memory_order_relaxed);
+    Header* head = owner->remoteFrees.load(std::memory_order_relaxed);
+    do {
+      h->next = head;
+    } while (!owner->remoteFrees.compare_exchange_weak(head, h,
+                                                       std::memory_order_release,
+                                                       std::memory_order_relaxed));
+  }
+
+  // let the calling thread carve new frames from slabs of node
+  // (call it after pinning the thread to a CPU of the node)
+  // - node: id of the kernel (see CpuTopology::nodeId());
+  //   -1 for a node without one (simulated): the slabs are not bound,
+  //   only first touched by the thread
+  static void bindToNode(int node) {
+    Pool* pool = localPool();
+    if (!pool->nodeBound || pool->node != node) {
+      if (pool->nodeBound) {
+        Registry& reg = registry();
+        std::lock_guard lock{reg.mx};
+        leaveSlab(reg, pool);
+      }
+      pool->nodeBound = true;
+      pool->node = node;
+    }
+  }
+
+  // statistics of the pool of the calling thread
+  static FramePoolStats threadStats() {
+    return stats(*localPool());
+  }
+
+  // statistics of all pools (of running and finished threads)
+  static FramePoolStats totalStats() {
+    FramePoolStats total;
+    Registry& reg = registry();
+    std::lock_guard lock{reg.mx};
+    for (Pool* p : reg.pools) {
+      total += stats(*p);
+    }
+    return total;
+  }
+
+ private:
+  static FramePoolStats stats(const Pool& p) noexcept {
+    return FramePoolStats{p.hits.load(std::memory_order_relaxed),
+                          p.misses.load(std::memory_order_relaxed),
+                          p.remoteFreeCount.load(std::memory_order_relaxed),
+                          p.nodeFrames.load(std::memory_order_relaxed)};
+  }
+};
+
+#endif
@@ -0,0 +1,336 @@
+// metrics of a scheduler (CoroScheduler<> and the cotask loop)
+//  - HdrHistogram: log-linear buckets like HdrHistogram
+//    (16 per power of two, so values are recorded with less than 7% error),
+//    values up to 2^40 (ns: 18 minutes), bigger ones count as that
+//  - SchedMetrics: per-thread counters and histograms
+//    (each recording thread has its own ThreadMetrics,
+//     written only by that thread without read-modify-write operations):
+//    - wait time: from schedule() to resume (ns)
+//    - run time: of each resume slice (ns), also per task name
+//    - queue depth: runnable coroutines seen when resuming one
+//    - resumes and tasks completed
+//  - reading the clock costs more than a resume, so a scheduler
+//    should only time every sampleInterval-th schedule() and resume
+//    of a thread (see sampleWait() and sampleRun()); counters count all
+//  - snapshot() merges the threads while they keep running
+//    (relaxed loads, so a snapshot is not an atomic cut)
+//  - NoSchedMetrics: same interface, compiles to nothing
+//  - tasks completing on a thread bound to a ThreadMetrics (see bind())
+//    are counted by SchedMetrics::taskCompleted()
+//    (e.g. by CoroTasks with a TaskCountingInstrumentation)
+
+#ifndef INCLUDED_SCHED_METRICS_HPP
+#define INCLUDED_SCHED_METRICS_HPP
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <map>
+#include <array>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <chrono>
+#include <ostream>
+#include <bit>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+class HdrHistogram {
+ public:
+  static constexpr unsigned subBucketBits = 4;
+  static constexpr std::uint64_t subBuckets = std::uint64_t{1} << subBucketBits;
+  static constexpr unsigned maxValueBits = 40;
+  static constexpr std::uint64_t maxValue = (std::uint64_t{1} << maxValueBits) - 1;
+  static constexpr std::size_t numBuckets = (maxValueBits - subBucketBits + 1) * subBuckets;
+
+  // values below 2*subBuckets have a bucket each,
+  // above each power of two is split into subBuckets buckets
+  static std::size_t bucketOf(std::uint64_t value) noexcept {
+    value = std::min(value, maxValue);
+    if (value < 2 * subBuckets) {
+      return static_cast<std::size_t>(value);
+    }
+    unsigned shift = static_cast<unsigned>(std::bit_width(value)) - (subBucketBits + 1);
+    return static_cast<std::size_t>(shift * subBuckets + (value >> shift));
+  }
+
+  // highest value counted in bucket
+  static std::uint64_t bucketMax(std::size_t bucket) noexcept {
+    if (bucket < 2 * subBuckets) {
+      return bucket;
+    }
+    unsigned shift = static_cast<unsigned>(bucket / subBuckets) - 1;
+    std::uint64_t sub = bucket - shift * subBuckets;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  struct Snapshot {
+    std::array<std::uint64_t, numBuckets> counts{};
+    std::uint64_t total = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+
+    Snapshot& operator+= (const Snapshot& s) noexcept {
+      for (std::size_t i = 0; i < numBuckets; ++i) {
+        counts[i] += s.counts[i];
+      }
+      total += s.total;
+      sum += s.sum;
+      max = std::max(max, s.max);
+      return *this;
+    }
+
+    double mean() const noexcept {
+      return total == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(total);
+    }
+    // upper bound of the given fraction (e.g. 0.99) of all values
+    std::uint64_t percentile(double fraction) const noexcept {
+      auto limit = static_cast<std::uint64_t>(std::ceil(fraction * static_cast<double>(total)));
+      std::uint64_t count = 0;
+      for (std::size_t i = 0; i < numBuckets; ++i) {
+        count += counts[i];
+        if (count > 0 && count >= limit) {
+          return std::min(bucketMax(i), max);
+        }
+      }
+      return max;
+    }
+  };
+
+ private:
+  std::array<std::atomic<std::uint64_t>, numBuckets> counts_{};
+  std::atomic<std::uint64_t> total_{0};
+  std::atomic<std::uint64_t> sum_{0};
+  std::atomic<std::uint64_t> max_{0};
+
+  static void add(std::atomic<std::uint64_t>& counter, std::uint64_t n) noexcept {
+    // single writer: no read-modify-write needed
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+ public:
+  HdrHistogram() = default;
+  HdrHistogram(const HdrHistogram&) = delete;
+  HdrHistogram& operator=(const HdrHistogram&) = delete;
+
+  // owner thread only:
+  void record(std::uint64_t value) noexcept {
+    add(counts_[bucketOf(value)], 1);
+    add(total_, 1);
+    add(sum_, value);
+    if (value > max_.load(std::memory_order_relaxed)) {
+      max_.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  // any thread:
+  void addTo(Snapshot& s) const noexcept {
+    Snapshot mine;
+    for (std::size_t i = 0; i < numBuckets; ++i) {
+      mine.counts[i] = counts_[i].load(std::memory_order_relaxed);
+    }
+    mine.total = total_.load(std::memory_order_relaxed);
+    mine.sum = sum_.load(std::memory_order_relaxed);
+    mine.max = max_.load(std::memory_order_relaxed);
+    s += mine;
+  }
+};
+
+
+struct SchedMetricsSnapshot {
+  unsigned threads = 0;
+  std::uint64_t resumes = 0;
+  std::uint64_t tasksCompleted = 0;
+  HdrHistogram::Snapshot waitTime;     // ns from schedule() to resume
+  HdrHistogram::Snapshot runTime;      // ns per resume slice
+  HdrHistogram::Snapshot queueDepth;   // runnable coroutines when resuming one
+  std::map<std::string, HdrHistogram::Snapshot, std::less<>> runTimeByName;
+
+  void report(std::ostream& strm) const {
+    auto line = [&strm](const char* what, const HdrHistogram::Snapshot& h, const char* unit) {
+      strm << what << ": " << h.total << " samples, mean " << h.mean() << unit
+           << ", p50 " << h.percentile(0.5) << unit << ", p99 " << h.percentile(0.99) << unit
+           << ", max " << h.max << unit << '\n';
+    };
+    strm << "metrics of " << threads << " threads: " << resumes << " resumes, "
+         << tasksCompleted << " tasks completed\n";
+    line("  wait time", waitTime, "ns");
+    line("  run time", runTime, "ns");
+    line("  queue depth", queueDepth, "");
+    for (const auto& [name, h] : runTimeByName) {
+      line(("  run time of " + name).c_str(), h, "ns");
+    }
+  }
+};
+
+
+class SchedMetrics {
+ public:
+  static constexpr bool enabled = true;
+  static constexpr unsigned sampleInterval = 16;
+  using Clock = std::chrono::steady_clock;
+  using Stamp = Clock::time_point;
+
+  static Stamp now() noexcept {
+    return Clock::now();
+  }
+
+  // metrics recorded by one thread
+  class ThreadMetrics {
+    friend class SchedMetrics;
+    std::atomic<std::uint64_t> resumes_{0};
+    std::atomic<std::uint64_t> tasksCompleted_{0};
+    unsigned sinceWaitSample_ = sampleInterval - 1;   // so that the first ones are timed
+    unsigned sinceRunSample_ = sampleInterval - 1;
+    HdrHistogram waitTime_;
+    HdrHistogram runTime_;
+    HdrHistogram queueDepth_;
+    std::mutex namedMx_;   // inserts into named_ (by the owner) vs. snapshot()
+    std::map<std::string, HdrHistogram, std::less<>> named_;
+
+    static std::uint64_t ns(Stamp from, Stamp to) noexcept {
+      auto d = std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+      return d < 0 ? 0 : static_cast<std::uint64_t>(d);
+    }
+
+    static bool sample(unsigned& since) noexcept {
+      if (++since < sampleInterval) {
+        return false;
+      }
+      since = 0;
+      return true;
+    }
+
+    static void bump(std::atomic<std::uint64_t>& counter) noexcept {
+      // single writer: no read-modify-write needed
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+   public:
+    // true for every sampleInterval-th schedule() (resume) of the thread:
+    // time this one
+    bool sampleWait() noexcept {
+      return sample(sinceWaitSample_);
+    }
+    bool sampleRun() noexcept {
+      return sample(sinceRunSample_);
+    }
+
+    void recordWait(Stamp scheduled, Stamp resumed) noexcept {
+      waitTime_.record(ns(scheduled, resumed));
+    }
+    // a resume slice (name: of the task, empty if unknown)
+    void recordRun(Stamp start, Stamp end, std::string_view name = {}) {
+      std::uint64_t d = ns(start, end);
+      runTime_.record(d);
+      if (!name.empty()) {
+        auto pos = named_.find(name);   // only we insert: no lock needed to look up
+        if (pos == named_.end()) {
+          std::lock_guard lock{namedMx_};
+          pos = named_.try_emplace(std::string{name}).first;
+        }
+        pos->second.record(d);
+      }
+    }
+    void recordQueueDepth(std::size_t depth) noexcept {
+      queueDepth_.record(depth);
+    }
+    void countResume() noexcept {
+      bump(resumes_);
+    }
+    void countTaskCompleted() noexcept {
+      bump(tasksCompleted_);
+    }
+  };
+
+ private:
+  mutable std::mutex mx_;
+  std::vector<std::unique_ptr<ThreadMetrics>> threads_;
+
+  static ThreadMetrics*& current() noexcept {
+    thread_local ThreadMetrics* metrics = nullptr;
+    return metrics;
+  }
+
+ public:
+  SchedMetrics() = default;
+  SchedMetrics(const SchedMetrics&) = delete;
+  SchedMetrics& operator=(const SchedMetrics&) = delete;
+
+  // metrics of a new recording thread (valid as long as *this)
+  ThreadMetrics& addThread() {
+    std::lock_guard lock{mx_};
+    threads_.push_back(std::make_unique<ThreadMetrics>());
+    return *threads_.back();
+  }
+
+  // let taskCompleted() of the calling thread count into metrics (nullptr: no more)
+  static void bind(ThreadMetrics* metrics) noexcept {
+    current() = metrics;
+  }
+  static void taskCompleted() noexcept {
+    if (ThreadMetrics* metrics = current()) {
+      metrics->countTaskCompleted();
+    }
+  }
+
+  // merged metrics of all threads (they don't have to stop for it)
+  SchedMetricsSnapshot snapshot() const {
+    SchedMetricsSnapshot s;
+    std::lock_guard lock{mx_};
+    for (const auto& t : threads_) {
+      ++s.threads;
+      s.resumes += t->resumes_.load(std::memory_order_relaxed);
+      s.tasksCompleted += t->tasksCompleted_.load(std::memory_order_relaxed);
+      t->waitTime_.addTo(s.waitTime);
+      t->runTime_.addTo(s.runTime);
+      t->queueDepth_.addTo(s.queueDepth);
+      std::lock_guard namedLock{t->namedMx_};
+      for (const auto& [name, h] : t->named_) {
+        h.addTo(s.runTimeByName[name]);
+      }
+    }
+    return s;
+  }
+};
+
+
+struct NoSchedMetrics {
+  static constexpr bool enabled = false;
+  struct Stamp {
+    bool operator== (const Stamp&) const = default;
+  };
+
+  static Stamp now() noexcept {
+    return {};
+  }
+
+  struct ThreadMetrics {
+    bool sampleWait() noexcept { return false; }
+    bool sampleRun() noexcept { return false; }
+    void recordWait(Stamp, Stamp) noexcept {}
+    void recordRun(Stamp, Stamp, std::string_view = {}) noexcept {}
+    void recordQueueDepth(std::size_t) noexcept {}
+    void countResume() noexcept {}
+    void countTaskCompleted() noexcept {}
+  };
+
+  ThreadMetrics& addThread() noexcept {
+    return dummy_;
+  }
+  static void bind(ThreadMetrics*) noexcept {}
+  static void taskCompleted() noexcept {}
+
+  SchedMetricsSnapshot snapshot() const {
+    return {};
+  }
+
+ private:
+  [[no_unique_address]] ThreadMetrics dummy_;
+};
+
+#endif
@@ -0,0 +1,249 @@
+// per-core schedulers for the scheduler demo (see cotask.cpp)
+//  - each core has its own run queue and timing wheel;
+//    the run queue decides the order of the runnable tasks:
+//    PriorityRunQueue (static priorities) or EdfRunQueue (deadlines),
+//    a smaller priority value of the run queue is more urgent
+//  - each core is run by its own thread, which pops the tasks of its core
+//    (the queues of a core are guarded by its mutex, so that the other
+//     cores and the tick thread can use them, too)
+//  - a task remembers the core it last ran on (T derives from CoreNode):
+//    it waits in the timing wheel of that core and is woken there,
+//    so that it finds its caches warm;
+//    with a dispatch limit per tick, it only moves at once if that core
+//    can't run it in this tick anyway (enough tasks at least as urgent)
+//    and another core has a free slot
+//  - pull(): a core that ran out of runnable tasks takes
+//    the most urgent runnable task of the other cores
+//  - dispatchPerTick: tasks a core may run per tick (0: no limit, each
+//    core runs its tasks while the budget of the tick lasts); a limit
+//    simulates cores that are too slow for the task set
+
+#ifndef INCLUDED_CORE_SCHEDULER_HPP
+#define INCLUDED_CORE_SCHEDULER_HPP
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <ostream>
+#include "timingwheel.hpp"
+#include "runqueue.hpp"
+#include "edfrunqueue.hpp"
+
+// hook for tasks of a MultiCoreScheduler
+struct CoreNode {
+  static constexpr unsigned noCore = ~0u;
+  unsigned lastCore = noCore;   // core the task ran on last
+};
+
+template <typename T, typename RunQueue = PriorityRunQueue<T>>
+class MultiCoreScheduler {
+ public:
+  using Priority = typename RunQueue::Priority;
+
+  struct Stats {
+    std::uint64_t dispatched = 0;   // tasks run
+    std::uint64_t localWakeups = 0; // runnable again on the core they last ran on
+    std::uint64_t pulled = 0;       // taken from other cores by pull()
+    std::uint64_t migrations = 0;   // tasks run that last ran on another core
+  };
+
+  struct Core {
+    std::mutex mx;                          // guards runnable and waiting
+    RunQueue runnable;
+    TimingWheel<T> waiting;
+    std::atomic<std::size_t> numRunnable{0};   // (read without the lock)
+    Stats stats;                            // (each counter has one writer)
+  };
+
+ private:
+  std::vector<Core> cores_;
+  unsigned dispatchPerTick_;
+
+  static Priority priorityOf(const T& t) noexcept {
+    return RunQueue::priorityOf(t);
+  }
+
+  std::size_t numRunnableOf(unsigned c) const noexcept {
+    return cores_[c].numRunnable.load(std::memory_order_relaxed);
+  }
+
+  // core with the fewest runnable tasks
+  unsigned leastLoaded() const noexcept {
+    unsigned best = 0;
+    for (unsigned c = 1; c < cores_.size(); ++c) {
+      if (numRunnableOf(c) < numRunnableOf(best)) {
+        best = c;
+      }
+    }
+    return best;
+  }
+
+  // true if the core can't dispatch a task of priority prio in this tick
+  // (it has at least dispatchPerTick runnable tasks that are at least as urgent;
+  //  approximated by the most urgent one)
+  bool saturated(Core& core, Priority prio) {
+    if (dispatchPerTick_ == 0) {
+      return false;
+    }
+    std::lock_guard lock{core.mx};
+    return core.runnable.size() >= dispatchPerTick_ && core.runnable.topPriority() <= prio;
+  }
+
+  // other core than c with the most urgent runnable task
+  // (cores_.size() if there is none)
+  unsigned mostUrgent(unsigned c) {
+    unsigned best = static_cast<unsigned>(cores_.size());
+    Priority bestPrio{};
+    for (unsigned v = 0; v < cores_.size(); ++v) {
+      if (v == c || numRunnableOf(v) == 0) {
+        continue;
+      }
+      std::lock_guard lock{cores_[v].mx};
+      if (cores_[v].runnable.empty()) {
+        continue;
+      }
+      Priority prio = cores_[v].runnable.topPriority();
+      if (best == cores_.size() || prio < bestPrio) {
+        best = v;
+        bestPrio = prio;
+      }
+    }
+    return best;
+  }
+
+  // take the most urgent task of core v (nullptr if it has none)
+  T* take(unsigned v) noexcept {
+    std::lock_guard lock{cores_[v].mx};
+    T* t = cores_[v].runnable.pop();
+    cores_[v].numRunnable.store(cores_[v].runnable.size(), std::memory_order_relaxed);
+    return t;
+  }
+
+  // the task taken runs on core c
+  T* dispatch(unsigned c, T* t) noexcept {
+    if (t != nullptr) {
+      CoreNode& node = *t;
+      if (node.lastCore != CoreNode::noCore && node.lastCore != c) {
+        ++cores_[c].stats.migrations;
+      }
+      node.lastCore = c;
+      ++cores_[c].stats.dispatched;
+    }
+    return t;
+  }
+
+ public:
+  // dispatchPerTick 0: no limit
+  MultiCoreScheduler(unsigned numCores, unsigned dispatchPerTick = 0)
+   : cores_(numCores == 0 ? 1 : numCores), dispatchPerTick_{dispatchPerTick} {
+    static_assert(std::is_base_of_v<CoreNode, T>, "T has to derive from CoreNode");
+  }
+
+  unsigned numCores() const noexcept {
+    return static_cast<unsigned>(cores_.size());
+  }
+  unsigned dispatchPerTick() const noexcept {
+    return dispatchPerTick_;
+  }
+
+  std::size_t numRunnable() const noexcept {
+    std::size_t num = 0;
+    for (unsigned c = 0; c < cores_.size(); ++c) {
+      num += numRunnableOf(c);
+    }
+    return num;
+  }
+
+  // queue t as runnable, preferably on the core it last ran on
+  // (new tasks: on the core with the fewest runnable tasks);
+  // returns the core
+  unsigned makeRunnable(T& t) {
+    CoreNode& node = t;
+    Priority prio = priorityOf(t);
+    unsigned c = node.lastCore;
+    bool local = false;
+    if (c == CoreNode::noCore) {
+      c = leastLoaded();
+    }
+    else if (saturated(cores_[c], prio) && numRunnableOf(leastLoaded()) < dispatchPerTick_) {
+      c = leastLoaded();
+    }
+    else {
+      local = true;
+    }
+    std::lock_guard lock{cores_[c].mx};
+    if (local) {
+      ++cores_[c].stats.localWakeups;
+    }
+    cores_[c].runnable.push(t, prio);
+    cores_[c].numRunnable.store(cores_[c].runnable.size(), std::memory_order_relaxed);
+    return c;
+  }
+
+  // let t wait until tick in the timing wheel of the core it last ran on
+  void makeWaiting(T& t, std::uint64_t tick) {
+    CoreNode& node = t;
+    Core& core = cores_[node.lastCore == CoreNode::noCore ? 0 : node.lastCore];
+    std::lock_guard lock{core.mx};
+    core.waiting.insert(t, tick);
+  }
+
+  // remove t from the timing wheel (false if it doesn't wait)
+  bool cancelWait(T& t) {
+    CoreNode& node = t;
+    Core& core = cores_[node.lastCore == CoreNode::noCore ? 0 : node.lastCore];
+    std::lock_guard lock{core.mx};
+    return core.waiting.cancel(t);
+  }
+
+  // advance the timing wheels of all cores:
+  // onWake(t) is called for each expired task (which has to make it runnable)
+  template <typename FN>
+  void advance(std::uint64_t now, FN onWake) {
+    std::vector<T*> woken;   // (onWake() is called without a lock held)
+    for (auto& core : cores_) {
+      std::lock_guard lock{core.mx};
+      core.waiting.advance(now, [&woken](T& t) {
+        woken.push_back(&t);
+      });
+    }
+    for (T* t : woken) {
+      onWake(*t);
+    }
+  }
+
+  // next task to run on core c (nullptr if none);
+  // the task is taken from the run queue and remembers the core
+  T* pop(unsigned c) noexcept {
+    return dispatch(c, take(c));
+  }
+
+  // most urgent runnable task of the other cores to run on core c
+  // (nullptr if none)
+  T* pull(unsigned c) {
+    while (true) {
+      unsigned victim = mostUrgent(c);
+      if (victim == cores_.size()) {
+        return nullptr;
+      }
+      if (T* t = take(victim)) {   // (nullptr if another core was faster)
+        ++cores_[c].stats.pulled;
+        return dispatch(c, t);
+      }
+    }
+  }
+
+  void report(std::ostream& strm) const {
+    for (unsigned c = 0; c < cores_.size(); ++c) {
+      const Stats& s = cores_[c].stats;
+      strm << "core " << c << ": " << s.dispatched << " dispatched, "
+           << s.localWakeups << " local wakeups, " << s.pulled << " pulled, "
+           << s.migrations << " migrations\n";
+    }
+  }
+};
+
+#endif
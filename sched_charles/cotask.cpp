@@ -1,9 +1,17 @@
 // based on https://gitlab.com/charlest_uk/scheduler_demo/-/blob/main/CoTask.cpp
 #include <iostream>
 #include <coroutine>
-#include <map>
 #include <thread>
+#include <barrier>
+#include <atomic>
+#include <syncstream>
 #include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <initializer_list>
+#include "cotask.hpp"
+#include "tickdriver.hpp"
 
 using namespace std::chrono_literals;
 
@@ -11,101 +19,14 @@ using namespace std::chrono_literals;
 // Just simple co-routine based scheduler demo code - feel free to mod and use.
 // Charles Tolman ct@acm.org charlestolman.com
 
-// main does simple ticking of globalTime.
+// main ticks globalTime with the wall clock (see TickDriver).
 int globalTime{0};
 
-// CoTask configuration control structure
-struct CoTaskInfo
-{
-  int _priority{};
-  std::string _name;
-  int _numRuns{};
-  int _runCount{};
-  int _waitCount{};
-
-  void announce() const
-  {
-    std::cout
-      << "    " << _name << ":start:" << _numRuns
-      << " Run:" << _runCount << " Wait:" << _waitCount
-      << '\n';
-  }
-};
-
-// The co routine task itself initialised from CoTaskInfo
-class CoTask
-{
-public:
-  struct promise_type
-  {
-    CoTaskInfo _info;
-    int _yieldValue{-1};
-
-    promise_type(CoTaskInfo const & info) : _info{info} {}
-
-    CoTask get_return_object() noexcept {
-      return CoTask{Handle::from_promise(*this)};
-    }
-
-    auto yield_value(int value) {
-      _yieldValue = value;
-      return std::suspend_always{};
-    }
-    void return_void() noexcept {}
-  
-    auto initial_suspend() const noexcept { return std::suspend_always{}; }
-    auto final_suspend() const noexcept { return std::suspend_always{}; }
-    void unhandled_exception() noexcept {
-      std::cerr << "CoTask: Unhandled exception caught...\n";
-      std::terminate();
-    }
-  };
-
-  using Handle = std::coroutine_handle<promise_type>;
-  Handle _handle;
-
-  explicit CoTask(Handle h) : _handle{h} { }
-  ~CoTask() { if (_handle) _handle.destroy(); }
-  CoTask(const CoTask&) = delete;
-  CoTask& operator=(const CoTask&) = delete;
-  
-  bool resume() {
-    if (!_handle || _handle.done()) {
-      return false;
-    }
-    _handle.resume();
-    return !_handle.done();
-  }
-
-  int getYieldValue() const {
-    if (_handle) {
-      int const value {_handle.promise()._yieldValue};
-      _handle.promise()._yieldValue = -1;
-      return value;
-    }
-    return -1;
-  }
-
-  int getPriority() const {
-    if (_handle) {
-      return _handle.promise()._info._priority;
-    }
-    return 0;
-  }
-
-  std::string getName() const {
-    if (_handle) {
-      return _handle.promise()._info._name;
-    }
-    return "";
-  }
-};
-
-
 // Each co-routine runs <info._numRuns> loops of <info._runCount> ticks.
 // Then it will wait using a yield until globalTime + <info._waitCount> ticks
+// (it gives up if the wait is cancelled)
 
-CoTask coRun(CoTaskInfo const & info)
+CoTask coRun(CoTaskInfo info)
 {
   info.announce();
 
@@ -113,91 +34,309 @@ CoTask coRun(CoTaskInfo const & info)
   {
     for (int i {0}; i < info._runCount; ++i)
     {
-      std::cout << "    " << info._name << ':' << i << '\n';
+      std::osyncstream{std::cout} << "    " << info._name << ':' << i << '\n';
       co_await std::suspend_always();
     }
 
     const int waitUntil{globalTime + info._waitCount};
-    co_yield waitUntil;
+    if (!(co_yield waitUntil))
+    {
+      std::osyncstream{std::cout} << "    " << info._name << ":cancelled\n";
+      co_return;
+    }
   }
 
-  std::cout << "    " << info._name << ":end\n";
+  std::osyncstream{std::cout} << "    " << info._name << ":end\n";
 }
 
 
-// runnable task pointers ordered by priority
-// could be a set since task has priority
+// per core: runnable tasks ordered by priority
+// (FIFO per priority, so tasks of the same priority run round-robin)
+// or by the deadline of their current run (earliest deadline first),
+// and waiting tasks by reschedule time
+// (any number of tasks may wait for the same time)
 // priority 0 is highest!
-std::map<int,CoTask*> runnableTasks;
+using PriorityScheduler = MultiCoreScheduler<CoTask>;
+using EdfScheduler = MultiCoreScheduler<CoTask, EdfRunQueue<CoTask>>;
 
-// waiting task pointers ordered by reschedule time
-std::map<int,CoTask*> waitingTasks;
-
-
-int main()
+template <typename Scheduler>
+unsigned makeRunnable(Scheduler& sched, CoTask& task)
 {
-  std::cout << "START:\n";
-  
-  // task1: 2 runs of running for 8 ticks and waiting for 3 ticks
-  CoTask task1 = coRun(CoTaskInfo{0, "task1", 2, 8, 3});
-  // task2: 3 runs of running for 2 ticks and waiting for 2 ticks
-  CoTask task2 = coRun(CoTaskInfo{1, "task2", 4, 2, 4});
-
-  // put the task pointers on the runnable queue in priority order
-  runnableTasks[task1.getPriority()] = &task1;
-  runnableTasks[task2.getPriority()] = &task2;
+  task._runnableSince = SchedMetrics::now();
+  return sched.makeRunnable(task);
+}
 
-  std::cout << "INIT DONE\n";
+// let the task wait until the tick (on the core it ran on)
+// (a cancellation makes it runnable at once)
+template <typename Scheduler>
+void makeWaiting(Scheduler& sched, CoTask& task, int tick)
+{
+  sched.makeWaiting(task, static_cast<std::uint64_t>(tick));
+  task.onCancel([&sched, &task] {
+    if (sched.cancelWait(task))
+    {
+      task.markCancelled();
+      task.startJob(static_cast<std::uint64_t>(globalTime));
+      makeRunnable(sched, task);
+      std::osyncstream{std::cout} << "    " << task.getName() << " CANCELLED\n";
+    }
+  });
+}
 
-  // just run the "system" for 50 seconds
-  while (globalTime < 50)
+// deadline misses, lateness and CPU utilization of each task:
+// its run time (recorded per name by the cores) in the time the cores had
+// (capacityNs: elapsed time times the number of cores)
+void reportDeadlines(std::ostream& strm, std::initializer_list<const CoTask*> tasks,
+                     const SchedMetricsSnapshot& metrics, double capacityNs)
+{
+  auto printShare = [&strm, capacityNs](const HdrHistogram::Snapshot& runTime) {
+    strm << 100.0 * static_cast<double>(runTime.sum) / capacityNs << '%';
+  };
+  for (const CoTask* task : tasks)
   {
-    std::cout << "TIME:" << globalTime << '\n';
-
-    // see if there are any waiting tasks that are now runnable
-    auto waitIt {waitingTasks.begin()};
-    while (waitIt != waitingTasks.end() && globalTime >= waitIt->first)
+    const DeadlineStats& s {task->deadlineStats};
+    strm << task->getName() << ": " << s.jobs << " runs, " << s.misses << " missed, max lateness "
+         << s.maxLateness << ", " << s.budgetOverruns << " budget overruns, utilization ";
+    auto pos {metrics.runTimeByName.find(task->getName())};
+    printShare(pos != metrics.runTimeByName.end() ? pos->second : HdrHistogram::Snapshot{});
+    strm << "\n    lateness:";
+    for (unsigned i {0}; i < DeadlineStats::numBuckets; ++i)
     {
-      // we have a waiting task that is runnable 
-      // move it from waiting queue to runnable queue
-      CoTask * task {waitIt->second};
-      waitingTasks.erase(waitIt);
-      runnableTasks[task->getPriority()] = task;
+      if (s.latenessLog2[i] != 0)
+      {
+        strm << (i == 0 ? " in time:" : " <" + std::to_string(std::uint64_t{1} << i) + ':')
+             << s.latenessLog2[i];
+      }
+    }
+    strm << '\n';
+  }
+  strm << "utilization: ";
+  printShare(metrics.runTime);
+  strm << " of " << capacityNs / 1e6 << "ms of CPU time\n";
+}
 
-      std::cout << "    " << task->getName() << " RUNNING\n";
+// run the demo task set with the given scheduling policy
+template <typename Scheduler>
+void runTasks(Scheduler& sched, TickDriver& ticker)
+{
+  // wait and run times of all dispatches (also per task name),
+  // recorded by each core thread:
+  SchedMetrics metrics;
 
-      waitIt = waitingTasks.begin();
-    }
+  // task1: 2 runs of running for 8 ticks and waiting for 3 ticks
+  // (each run has to be done 12 ticks after it became runnable
+  //  and may take 9 dispatches: 8 ticks and the yield)
+  CoTask task1 = coRun(CoTaskInfo{0, "task1", 2, 8, 3, 12, 9});
+  // task2: 4 runs of running for 2 ticks and waiting for 4 ticks
+  CoTask task2 = coRun(CoTaskInfo{1, "task2", 4, 2, 4, 4, 3});
+  // task3: same priority as task2
+  // (but its waits are cancelled at tick <cancelTick>)
+  CoTask task3 = coRun(CoTaskInfo{1, "task3", 2, 3, 5, 6, 4});
+  cancellation_source cancelTask3;
+  task3.setCancellationToken(cancelTask3.token());
+  const int cancelTick{6};
+  // more tasks than one core can dispatch per tick:
+  CoTask task4 = coRun(CoTaskInfo{2, "task4", 3, 6, 2, 8, 7});
+  // high priority but a loose deadline:
+  CoTask task5 = coRun(CoTaskInfo{0, "task5", 2, 4, 6, 24, 5});
+  // low priority but a tight deadline:
+  CoTask task6 = coRun(CoTaskInfo{3, "task6", 1, 12, 1, 20, 13});
+
+  // put the tasks on the runnable queues
+  for (CoTask* task : {&task1, &task2, &task3, &task4, &task5, &task6})
+  {
+    task->startJob(static_cast<std::uint64_t>(globalTime));
+    makeRunnable(sched, *task);
+  }
 
-    // Run the highest priority runnable task if any
-    auto runIt {runnableTasks.begin()};
-    if (runIt != runnableTasks.end())
-    {
-      CoTask * const task {runIt->second};
-      runnableTasks.erase(runIt);
+  std::cout << "INIT DONE\n";
 
-      if (task->resume())
+  // one thread per core: in each tick, the tick thread (this one) wakes up
+  // the waiting tasks, then the cores run their runnable tasks
+  // until each one did or the budget of the tick is used up
+  const unsigned numCores {sched.numCores()};
+  std::barrier tickStart{static_cast<std::ptrdiff_t>(numCores + 1)};
+  std::barrier tickDone{static_cast<std::ptrdiff_t>(numCores + 1)};
+  bool stop{false};                          // (written before tickStart)
+  std::atomic<bool> budgetOverrun{false};    // of any core in this tick
+  // tasks that ran in this tick and are still runnable, per core
+  // (they run again in the next tick)
+  std::vector<std::vector<CoTask*>> ranThisTick(numCores);
+
+  // run the runnable tasks of the core once (most urgent first);
+  // once it has none left, it pulls those of the other cores
+  auto runCore = [&](unsigned core, SchedMetrics::ThreadMetrics& dispatchMetrics) {
+    const auto now {static_cast<std::uint64_t>(globalTime)};
+    for (unsigned n {0}; sched.dispatchPerTick() == 0 || n < sched.dispatchPerTick(); ++n)
+    {
+      if (!ticker.budgetLeft())
+      {
+        // remaining tasks have to wait for the next tick
+        if (sched.numRunnable() > 0)
+        {
+          budgetOverrun.store(true);
+        }
+        break;
+      }
+      CoTask * task {sched.pop(core)};
+      if (task == nullptr)
+      {
+        task = sched.pull(core);
+        if (task == nullptr)
+        {
+          break;
+        }
+      }
+      dispatchMetrics.recordQueueDepth(sched.numRunnable());
+      const auto start {SchedMetrics::now()};
+      dispatchMetrics.countResume();
+      dispatchMetrics.recordWait(task->_runnableSince, start);
+      const bool running {task->resume()};
+      dispatchMetrics.recordRun(start, SchedMetrics::now(), task->getName());
+      if (running)
       {
         // waitUntil will be -1 if the co task does NOT want to wait
         const int waitUntil{task->getYieldValue()};
         if (waitUntil > globalTime)
         {
           // task wants to wait and wait has not already expired
-          std::cout << "    " << task->getName() << " WAITING UNTIL:" << waitUntil << '\n';
-          waitingTasks[waitUntil] = task;
+          // (its run is done)
+          task->completeJob(now);
+          std::osyncstream{std::cout} << "    " << task->getName() << " WAITING UNTIL:" << waitUntil
+                                      << " ON CORE:" << core << '\n';
+          makeWaiting(sched, *task, waitUntil);
         }
         else
         {
-          // task is still runnable
-          runnableTasks[task->getPriority()] = task;
+          if (waitUntil >= 0)
+          {
+            // run done, next one starts at once
+            task->completeJob(now);
+            task->startJob(now);
+          }
+          else if (task->chargeDispatch())
+          {
+            std::osyncstream{std::cout} << "    " << task->getName() << " BUDGET USED UP\n";
+          }
+          // task is still runnable in the next tick
+          ranThisTick[core].push_back(task);
+        }
+      }
+      else
+      {
+        // the task is done: its last run completed when it yielded
+        // its last wait, so the wake-up after that is no job of its own
+        dispatchMetrics.countTaskCompleted();
+      }
+    }
+  };
+
+  std::vector<std::jthread> coreThreads;
+  for (unsigned core {0}; core < numCores; ++core)
+  {
+    coreThreads.emplace_back([&, core] {
+      SchedMetrics::ThreadMetrics& dispatchMetrics {metrics.addThread()};
+      while (true)
+      {
+        tickStart.arrive_and_wait();
+        if (stop)
+        {
+          return;
         }
+        runCore(core, dispatchMetrics);
+        tickDone.arrive_and_wait();
       }
+    });
+  }
+
+  // just run the "system" for 50 ticks
+  // (the ticks are driven by the wall clock without drifting)
+  const auto startTime {std::chrono::steady_clock::now()};
+  while (globalTime < 50)
+  {
+    std::cout << "TIME:" << globalTime << '\n';
+    const auto now {static_cast<std::uint64_t>(globalTime)};
+
+    if (globalTime >= cancelTick && !cancelTask3.is_cancellation_requested())
+    {
+      cancelTask3.request_cancellation();
     }
 
-    // this sleep is just here to give a nice controlled timing
-    // of debug output. It could be done by a hardware timer perhaps.
-    std::this_thread::sleep_for(1s);
-    ++globalTime;
-  }  
+    // see if there are any waiting tasks that are now runnable
+    // and move them from waiting queue to runnable queue
+    // (of the core they ran on, if possible)
+    sched.advance(now, [&sched, now](CoTask& task) {
+      task.waitDone();
+      task.startJob(now);
+      unsigned core = makeRunnable(sched, task);
+      std::cout << "    " << task.getName() << " RUNNING ON:" << core << '\n';
+    });
+
+    // let the cores run the tick:
+    tickStart.arrive_and_wait();
+    tickDone.arrive_and_wait();
+    if (budgetOverrun.exchange(false))
+    {
+      ticker.recordBudgetOverrun();   // (once per tick, not per core)
+    }
+    for (auto& ran : ranThisTick)
+    {
+      for (CoTask* task : ran)
+      {
+        makeRunnable(sched, *task);
+      }
+      ran.clear();
+    }
+
+    // block until the next tick is due
+    // (more than one tick passes if we were too late)
+    globalTime += static_cast<int>(ticker.waitNextTick());
+  }
+  stop = true;
+  tickStart.arrive_and_wait();
+  coreThreads.clear();   // (joins)
   std::cout << "END.\n";
+  ticker.report(std::cout);
+  sched.report(std::cout);
+  const std::chrono::duration<double, std::nano> elapsed {std::chrono::steady_clock::now() - startTime};
+  const SchedMetricsSnapshot snapshot {metrics.snapshot()};
+  reportDeadlines(std::cout, {&task1, &task2, &task3, &task4, &task5, &task6},
+                  snapshot, elapsed.count() * sched.numCores());
+  snapshot.report(std::cout);
+}
+
+
+// usage: cotask [tickMicroseconds [sleep|timerfd [numCores [dispatchPerTick [prio|edf]]]]]
+//  - tickMicroseconds: tick resolution (default: 1s)
+//  - sleep: use clock_nanosleep() instead of a timerfd
+//    (not on Linux, both use std::this_thread::sleep_until())
+//  - numCores: number of cores, each run by its own thread (default: 2)
+//  - dispatchPerTick: tasks a core can run per tick
+//    (default: 0, no limit: each core runs its tasks while the budget lasts)
+//  - prio: run the most important task first (default)
+//    edf: run the task with the earliest deadline first
+//  (e.g. "cotask 1000 timerfd 2 2 prio" misses deadlines
+//   that "cotask 1000 timerfd 2 2 edf" meets)
+int main(int argc, char* argv[])
+{
+  std::chrono::microseconds tickPeriod{argc > 1 ? std::stol(argv[1]) : 1'000'000};
+  TickDriver::Mode mode = argc > 2 && std::string{argv[2]} == "sleep"
+                            ? TickDriver::Mode::absoluteSleep
+                            : TickDriver::Mode::timerfd;
+  unsigned numCores = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 2;
+  unsigned dispatchPerTick = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : 0;
+  bool edf = argc > 5 && std::string{argv[5]} == "edf";
+
+  std::cout << "START" << (edf ? " (EDF)" : "") << ":\n";
+  TickDriver ticker{tickPeriod, mode};
+  if (edf)
+  {
+    EdfScheduler sched{numCores, dispatchPerTick};
+    runTasks(sched, ticker);
+  }
+  else
+  {
+    PriorityScheduler sched{numCores, dispatchPerTick};
+    runTasks(sched, ticker);
+  }
 }
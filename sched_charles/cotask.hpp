@@ -0,0 +1,195 @@
+// CoTask: coroutine task of the tick-driven scheduler demo (see cotask.cpp)
+//  - configured by a CoTaskInfo (priority, name, runs,
+//    and relative deadline and budget of each run)
+//  - co_yield <tick> asks the scheduler to let the task wait until that tick
+//  - a TimerNode, so that it can wait in the timing wheel,
+//    and a RunQueueNode, so that it can be queued as runnable
+//  - a CoreNode, so that it remembers the core it last ran on
+//  - a DeadlineNode, so that it can be queued by deadline (EDF)
+//    and its deadline misses are accounted (each run is a job)
+//  - waits can be cancelled (see setCancellationToken() and onCancel()):
+//    co_yield <tick> then returns false instead of true;
+//    the queues of a core are locked, so any thread can cancel
+// based on https://gitlab.com/charlest_uk/scheduler_demo/-/blob/main/CoTask.cpp
+
+#ifndef INCLUDED_COTASK_HPP
+#define INCLUDED_COTASK_HPP
+
+#include <iostream>
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <string>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include "../framepool/framepool.hpp"
+#include "../awaiter_lewis/cancellation.hpp"
+#include "../metrics/schedmetrics.hpp"
+#include "timingwheel.hpp"
+#include "runqueue.hpp"
+#include "edfrunqueue.hpp"
+#include "corescheduler.hpp"
+
+// CoTask configuration control structure
+struct CoTaskInfo
+{
+  int _priority{};
+  std::string _name;
+  int _numRuns{};
+  int _runCount{};
+  int _waitCount{};
+  int _deadline{};  // ticks from becoming runnable to the end of a run (0: none)
+  int _budget{};    // dispatches a run may take (0: unlimited)
+
+  void announce() const
+  {
+    std::cout
+      << "    " << _name << ":start:" << _numRuns
+      << " Run:" << _runCount << " Wait:" << _waitCount
+      << " Deadline:" << _deadline << " Budget:" << _budget
+      << '\n';
+  }
+};
+
+// The co routine task itself initialised from CoTaskInfo
+// (a TimerNode, so that it can wait in the timing wheel,
+//  a RunQueueNode, so that it can be queued as runnable by priority,
+//  a CoreNode, so that it can run on one of several cores,
+//  and a DeadlineNode, so that it can be queued by deadline)
+class CoTask : public TimerNode, public RunQueueNode, public CoreNode, public DeadlineNode
+{
+public:
+  struct promise_type
+  {
+    CoTaskInfo _info;
+    int _yieldValue{-1};
+    cancellation_token _cancelToken;
+    bool _cancelled{false};   // the last wait was cancelled
+
+    promise_type(CoTaskInfo const & info) : _info{info} {}
+
+    // allocate the coroutine frames from the thread-local frame pool:
+    static void* operator new(std::size_t sz) {
+      return FramePool::allocate(sz);
+    }
+    static void operator delete(void* p) noexcept {
+      FramePool::deallocate(p);
+    }
+
+    CoTask get_return_object() noexcept {
+      return CoTask{Handle::from_promise(*this)};
+    }
+
+    // co_yield returns false if the wait was cancelled
+    struct YieldAwaiter {
+      promise_type& _promise;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<>) const noexcept {}
+      bool await_resume() const noexcept {
+        return !std::exchange(_promise._cancelled, false);
+      }
+    };
+
+    auto yield_value(int value) {
+      _yieldValue = value;
+      return YieldAwaiter{*this};
+    }
+    void return_void() noexcept {}
+  
+    auto initial_suspend() const noexcept { return std::suspend_always{}; }
+    auto final_suspend() const noexcept { return std::suspend_always{}; }
+    void unhandled_exception() noexcept {
+      std::cerr << "CoTask: Unhandled exception caught...\n";
+      std::terminate();
+    }
+  };
+
+  using Handle = std::coroutine_handle<promise_type>;
+  Handle _handle;
+  std::optional<cancellation_registration> _waitRegistration;
+  SchedMetrics::Stamp _runnableSince{};   // for the wait time metrics
+
+  explicit CoTask(Handle h) : _handle{h} { }
+  ~CoTask() { if (_handle) _handle.destroy(); }
+  CoTask(const CoTask&) = delete;
+  CoTask& operator=(const CoTask&) = delete;
+  
+  bool resume() {
+    if (!_handle || _handle.done()) {
+      return false;
+    }
+    _handle.resume();
+    return !_handle.done();
+  }
+
+  int getYieldValue() const {
+    if (_handle) {
+      int const value {_handle.promise()._yieldValue};
+      _handle.promise()._yieldValue = -1;
+      return value;
+    }
+    return -1;
+  }
+
+  int getPriority() const {
+    if (_handle) {
+      return _handle.promise()._info._priority;
+    }
+    return 0;
+  }
+
+  int getDeadline() const {
+    if (_handle) {
+      return _handle.promise()._info._deadline;
+    }
+    return 0;
+  }
+
+  int getBudget() const {
+    if (_handle) {
+      return _handle.promise()._info._budget;
+    }
+    return 0;
+  }
+
+  // the task becomes runnable at tick now for a new run
+  void startJob(std::uint64_t now) {
+    int const deadline {getDeadline()};
+    releaseJob(now, deadline > 0 ? static_cast<std::uint64_t>(deadline) : 0,
+               std::max(getBudget(), 0));
+  }
+
+  std::string getName() const {
+    if (_handle) {
+      return _handle.promise()._info._name;
+    }
+    return "";
+  }
+
+  void setCancellationToken(cancellation_token token) {
+    _handle.promise()._cancelToken = std::move(token);
+  }
+
+  // fn() is called if the token is cancelled while the task waits
+  // (at once, if it already is)
+  template <typename FN>
+  void onCancel(FN&& fn) {
+    _waitRegistration.reset();
+    if (_handle.promise()._cancelToken.can_be_cancelled()) {
+      _waitRegistration.emplace(_handle.promise()._cancelToken, std::forward<FN>(fn));
+    }
+  }
+
+  // the wait is over: no callback anymore
+  void waitDone() {
+    _waitRegistration.reset();
+  }
+
+  // let co_yield of the waiting task return false
+  void markCancelled() {
+    _handle.promise()._cancelled = true;
+  }
+};
+
+#endif
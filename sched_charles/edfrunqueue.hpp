@@ -0,0 +1,188 @@
+// earliest-deadline-first run queue for the scheduler demo
+//  - binary min-heap of the runnable tasks ordered by the absolute
+//    deadline of their current job (T derives from DeadlineNode);
+//    FIFO among equal deadlines, so such tasks run round-robin
+//  - same interface as PriorityRunQueue, with the deadline as priority
+//    (so that MultiCoreScheduler can use either)
+//  - DeadlineNode also does the deadline accounting of a task:
+//    a job is released with a relative deadline and a budget of dispatches;
+//    completing it records the lateness (log2 histogram) and misses,
+//    using up the budget before completing postpones the deadline
+//    by the relative deadline (like a constant bandwidth server),
+//    so that a task overrunning its budget can't starve the others
+// see: Liu, Layland: Scheduling Algorithms for Multiprogramming
+//      in a Hard-Real-Time Environment (1973)
+
+#ifndef INCLUDED_EDF_RUN_QUEUE_HPP
+#define INCLUDED_EDF_RUN_QUEUE_HPP
+
+#include <vector>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <algorithm>
+
+struct DeadlineStats {
+  static constexpr unsigned numBuckets = 16;
+
+  std::uint64_t jobs = 0;            // jobs completed
+  std::uint64_t misses = 0;          // jobs completed after their deadline
+  std::uint64_t budgetOverruns = 0;  // jobs that used up their budget (deadline postponed)
+  std::uint64_t dispatches = 0;      // ticks the task ran
+  std::uint64_t maxLateness = 0;     // ticks
+  std::uint64_t latenessLog2[numBuckets] = {};  // bucket 0: in time, bucket i: late < 2^i ticks
+};
+
+// hook for tasks in an EdfRunQueue and with deadline accounting
+struct DeadlineNode {
+  static constexpr std::uint64_t noDeadline = std::numeric_limits<std::uint64_t>::max();
+
+  std::uint64_t deadline = noDeadline;  // absolute deadline of the current job (tick)
+  std::uint64_t relDeadline = 0;        // of the current job (0: none)
+  int budgetLeft = 0;                   // dispatches left for the current job
+  int budget = 0;                       // of each job (0: unlimited)
+  DeadlineStats deadlineStats;
+
+  // a new job arrives at tick now:
+  // it has to complete within relativeDeadline ticks (0: no deadline)
+  // and may be dispatched runBudget times (0: any number of times)
+  void releaseJob(std::uint64_t now, std::uint64_t relativeDeadline, int runBudget) noexcept {
+    relDeadline = relativeDeadline;
+    deadline = relativeDeadline == 0 ? noDeadline : now + relativeDeadline;
+    budget = budgetLeft = runBudget;
+  }
+
+  // the current job was dispatched but didn't complete:
+  // if this used up its budget, it gets a new one with a later deadline
+  // (returns true then)
+  bool chargeDispatch() noexcept {
+    ++deadlineStats.dispatches;
+    if (budget == 0 || --budgetLeft > 0) {
+      return false;
+    }
+    ++deadlineStats.budgetOverruns;
+    budgetLeft = budget;
+    if (deadline != noDeadline) {
+      deadline += relDeadline;
+    }
+    return true;
+  }
+
+  // the current job completed in tick now (i.e. at the end of it)
+  void completeJob(std::uint64_t now) noexcept {
+    ++deadlineStats.dispatches;
+    ++deadlineStats.jobs;
+    if (deadline == noDeadline) {
+      ++deadlineStats.latenessLog2[0];
+      return;
+    }
+    std::uint64_t late = now + 1 > deadline ? now + 1 - deadline : 0;
+    if (late > 0) {
+      ++deadlineStats.misses;
+      deadlineStats.maxLateness = std::max(deadlineStats.maxLateness, late);
+    }
+    unsigned bucket = static_cast<unsigned>(std::bit_width(late));
+    ++deadlineStats.latenessLog2[std::min(bucket, DeadlineStats::numBuckets - 1)];
+  }
+};
+
+template <typename T>
+class EdfRunQueue {
+ public:
+  using Priority = std::uint64_t;   // absolute deadline
+
+ private:
+  struct Entry {
+    std::uint64_t deadline;
+    std::uint64_t seq;   // FIFO among equal deadlines
+    T* task;
+
+    bool before(const Entry& e) const noexcept {
+      return deadline < e.deadline || (deadline == e.deadline && seq < e.seq);
+    }
+  };
+  std::vector<Entry> heap_;
+  std::uint64_t nextSeq_ = 0;
+
+  void siftUp(std::size_t i) noexcept {
+    Entry e = heap_[i];
+    while (i > 0) {
+      std::size_t parent = (i - 1) / 2;
+      if (!e.before(heap_[parent])) {
+        break;
+      }
+      heap_[i] = heap_[parent];
+      i = parent;
+    }
+    heap_[i] = e;
+  }
+
+  void siftDown(std::size_t i) noexcept {
+    Entry e = heap_[i];
+    std::size_t n = heap_.size();
+    while (true) {
+      std::size_t child = 2 * i + 1;
+      if (child >= n) {
+        break;
+      }
+      if (child + 1 < n && heap_[child + 1].before(heap_[child])) {
+        ++child;
+      }
+      if (!heap_[child].before(e)) {
+        break;
+      }
+      heap_[i] = heap_[child];
+      i = child;
+    }
+    heap_[i] = e;
+  }
+
+ public:
+  EdfRunQueue() {
+    static_assert(std::is_base_of_v<DeadlineNode, T>, "T has to derive from DeadlineNode");
+  }
+
+  EdfRunQueue(const EdfRunQueue&) = delete;
+  EdfRunQueue& operator=(const EdfRunQueue&) = delete;
+
+  std::size_t size() const noexcept {
+    return heap_.size();
+  }
+  bool empty() const noexcept {
+    return heap_.empty();
+  }
+
+  // the priority of t is the deadline of its current job
+  static Priority priorityOf(const T& t) noexcept {
+    const DeadlineNode& node = t;
+    return node.deadline;
+  }
+
+  void push(T& t, Priority deadline) {
+    heap_.push_back(Entry{deadline, nextSeq_++, &t});
+    siftUp(heap_.size() - 1);
+  }
+
+  // earliest deadline (DeadlineNode::noDeadline if empty)
+  Priority topPriority() const noexcept {
+    return heap_.empty() ? DeadlineNode::noDeadline : heap_.front().deadline;
+  }
+
+  // remove and return the task with the earliest deadline (nullptr if empty)
+  T* pop() noexcept {
+    if (heap_.empty()) {
+      return nullptr;
+    }
+    T* t = heap_.front().task;
+    heap_.front() = heap_.back();
+    heap_.pop_back();
+    if (!heap_.empty()) {
+      siftDown(0);
+    }
+    return t;
+  }
+};
+
+#endif
@@ -0,0 +1,139 @@
+// O(1) priority run queue for the scheduler demo
+//  (like the O(1) scheduler of Linux 2.6)
+//  - one intrusive FIFO list per priority (T derives from RunQueueNode)
+//  - a bitmap of non-empty priorities: the highest runnable priority
+//    is found with a find-first-set
+//  - priority 0 is highest
+//  - popping from the front and pushing back to the tail
+//    gives round-robin among tasks of the same priority
+//  - T provides int getPriority() (see priorityOf())
+
+#ifndef INCLUDED_RUN_QUEUE_HPP
+#define INCLUDED_RUN_QUEUE_HPP
+
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+// hook for tasks in a PriorityRunQueue
+struct RunQueueNode {
+  RunQueueNode* prev = nullptr;
+  RunQueueNode* next = nullptr;
+  unsigned queuedPriority = 0;
+  bool queued = false;
+};
+
+template <typename T, unsigned NumPriorities = 64>
+class PriorityRunQueue {
+ public:
+  using Priority = unsigned;
+  static constexpr unsigned numPriorities = NumPriorities;
+
+ private:
+  static constexpr std::size_t numWords = (NumPriorities + 63) / 64;
+
+  struct List {
+    RunQueueNode* head = nullptr;
+    RunQueueNode* tail = nullptr;
+  };
+  List lists[NumPriorities];
+  std::uint64_t bitmap[numWords] = {};
+  std::size_t size_ = 0;
+
+  void setBit(unsigned prio) noexcept {
+    bitmap[prio / 64] |= std::uint64_t{1} << (prio % 64);
+  }
+  void clearBit(unsigned prio) noexcept {
+    bitmap[prio / 64] &= ~(std::uint64_t{1} << (prio % 64));
+  }
+
+ public:
+  PriorityRunQueue() noexcept {
+    static_assert(std::is_base_of_v<RunQueueNode, T>, "T has to derive from RunQueueNode");
+  }
+
+  PriorityRunQueue(const PriorityRunQueue&) = delete;
+  PriorityRunQueue& operator=(const PriorityRunQueue&) = delete;
+
+  std::size_t size() const noexcept {
+    return size_;
+  }
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  // clamp any int priority into the range of the queue
+  static unsigned clampPriority(int prio) noexcept {
+    if (prio < 0) {
+      return 0;
+    }
+    return static_cast<unsigned>(prio) < NumPriorities ? static_cast<unsigned>(prio)
+                                                       : NumPriorities - 1;
+  }
+
+  // the priority of t in the range of the queue
+  static Priority priorityOf(const T& t) noexcept {
+    return clampPriority(t.getPriority());
+  }
+
+  // append t to the list of its priority
+  void push(T& t, unsigned prio) noexcept {
+    RunQueueNode& node = t;
+    List& list = lists[prio];
+    node.prev = list.tail;
+    node.next = nullptr;
+    node.queuedPriority = prio;
+    node.queued = true;
+    if (list.tail != nullptr) {
+      list.tail->next = &node;
+    }
+    else {
+      list.head = &node;
+      setBit(prio);
+    }
+    list.tail = &node;
+    ++size_;
+  }
+
+  // highest runnable priority (NumPriorities if empty)
+  unsigned topPriority() const noexcept {
+    for (std::size_t w = 0; w < numWords; ++w) {
+      if (bitmap[w] != 0) {
+        return static_cast<unsigned>(w * 64 + static_cast<std::size_t>(std::countr_zero(bitmap[w])));
+      }
+    }
+    return NumPriorities;
+  }
+
+  // remove t if it is queued (returns false if it isn't)
+  bool remove(T& t) noexcept {
+    RunQueueNode& node = t;
+    if (!node.queued) {
+      return false;
+    }
+    List& list = lists[node.queuedPriority];
+    (node.prev != nullptr ? node.prev->next : list.head) = node.next;
+    (node.next != nullptr ? node.next->prev : list.tail) = node.prev;
+    if (list.head == nullptr) {
+      clearBit(node.queuedPriority);
+    }
+    node.prev = node.next = nullptr;
+    node.queued = false;
+    --size_;
+    return true;
+  }
+
+  // remove and return the first task of the highest priority (nullptr if empty)
+  T* pop() noexcept {
+    unsigned prio = topPriority();
+    if (prio == NumPriorities) {
+      return nullptr;
+    }
+    T& t = static_cast<T&>(*lists[prio].head);
+    remove(t);
+    return &t;
+  }
+};
+
+#endif
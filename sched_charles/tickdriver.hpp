@@ -0,0 +1,198 @@
+// wall-clock tick driver for the scheduler demo
+//  - ticks with a configurable resolution (down to microseconds)
+//    on CLOCK_MONOTONIC (the clock of std::chrono::steady_clock)
+//  - waits for absolute deadlines, so that the ticks don't drift:
+//    on Linux either with a periodic timerfd or with clock_nanosleep(TIMER_ABSTIME),
+//    elsewhere (both modes) with std::this_thread::sleep_until()
+//  - each tick has a budget for the work done in it
+//  - records missed ticks (overruns), wake-up jitter, and budget overruns
+
+#ifndef INCLUDED_TICK_DRIVER_HPP
+#define INCLUDED_TICK_DRIVER_HPP
+
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <system_error>
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+#ifdef __linux__
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#endif
+
+class TickDriver {
+ public:
+  using Clock = std::chrono::steady_clock;
+  enum class Mode { timerfd, absoluteSleep };
+
+  struct Stats {
+    std::uint64_t ticks = 0;           // ticks processed
+    std::uint64_t missedTicks = 0;     // ticks passed without being processed
+    std::uint64_t budgetOverruns = 0;  // ticks whose work exceeded the budget
+    std::chrono::nanoseconds minJitter = std::chrono::nanoseconds::max();
+    std::chrono::nanoseconds maxJitter{0};
+    std::chrono::nanoseconds sumJitter{0};
+    std::uint64_t jitterLog2[64] = {};  // histogram of jitter (bucket i: < 2^i ns)
+
+    std::chrono::nanoseconds meanJitter() const {
+      return ticks == 0 ? std::chrono::nanoseconds{0}
+                        : sumJitter / static_cast<std::int64_t>(ticks);
+    }
+    // upper bound of the jitter of the given fraction (e.g. 0.99) of all ticks
+    std::chrono::nanoseconds jitterPercentile(double fraction) const {
+      auto limit = static_cast<std::uint64_t>(fraction * static_cast<double>(ticks));
+      std::uint64_t count = 0;
+      for (unsigned i = 0; i < 64; ++i) {
+        count += jitterLog2[i];
+        if (count >= limit) {
+          return std::chrono::nanoseconds{std::int64_t{1} << std::min(i, 62u)};
+        }
+      }
+      return maxJitter;
+    }
+  };
+
+ private:
+  std::chrono::nanoseconds resolution;
+  std::chrono::nanoseconds budget;
+  Mode mode;
+  int fd = -1;                         // timerfd (Linux and Mode::timerfd only)
+  Clock::time_point start;
+  std::uint64_t tickNum = 0;           // number of the current tick
+  Clock::time_point currentTickTime;   // when the current tick was due
+  Stats stats_;
+
+#ifdef __linux__
+  static timespec toTimespec(std::chrono::nanoseconds ns) {
+    timespec ts{};
+    ts.tv_sec = static_cast<time_t>(ns.count() / 1'000'000'000);
+    ts.tv_nsec = static_cast<long>(ns.count() % 1'000'000'000);
+    return ts;
+  }
+#endif
+
+  [[noreturn]] static void throwErrno(const char* what) {
+    throw std::system_error{errno, std::generic_category(), what};
+  }
+
+ public:
+  // budgetFraction: part of each tick available for the work of the tick
+  explicit TickDriver(std::chrono::nanoseconds res, Mode m = Mode::timerfd,
+                      double budgetFraction = 0.8)
+   : resolution{res},
+     budget{std::chrono::duration_cast<std::chrono::nanoseconds>(res * budgetFraction)},
+     mode{m},
+     start{Clock::now()},
+     currentTickTime{start} {
+#ifdef __linux__
+    if (mode == Mode::timerfd) {
+      fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+      if (fd < 0) {
+        throwErrno("timerfd_create()");
+      }
+      itimerspec spec{};
+      spec.it_interval = toTimespec(resolution);
+      spec.it_value = toTimespec(start.time_since_epoch() + resolution);
+      if (::timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+        ::close(fd);
+        throwErrno("timerfd_settime()");
+      }
+    }
+#endif
+  }
+
+  TickDriver(const TickDriver&) = delete;
+  TickDriver& operator=(const TickDriver&) = delete;
+
+  ~TickDriver() {
+#ifdef __linux__
+    if (fd >= 0) {
+      ::close(fd);
+    }
+#endif
+  }
+
+  // block until the next tick is due
+  // returns the number of ticks passed (more than 1 if ticks were missed)
+  std::uint64_t waitNextTick() {
+    std::uint64_t passed = 0;
+    if (fd >= 0) {
+#ifdef __linux__
+      std::uint64_t expirations = 0;
+      while (::read(fd, &expirations, sizeof(expirations)) < 0) {
+        if (errno != EINTR) {
+          throwErrno("read(timerfd)");
+        }
+      }
+      passed = expirations;
+#endif
+    }
+    else {
+      auto due = start + resolution * static_cast<std::int64_t>(tickNum + 1);
+#ifdef __linux__
+      timespec ts = toTimespec(due.time_since_epoch());
+      int rc;
+      while ((rc = ::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)) == EINTR) {
+      }
+      if (rc != 0) {
+        errno = rc;
+        throwErrno("clock_nanosleep()");
+      }
+#else
+      std::this_thread::sleep_until(due);
+#endif
+      // skip the ticks that are already over:
+      auto late = Clock::now() - due;
+      passed = 1 + static_cast<std::uint64_t>(late / resolution);
+    }
+
+    tickNum += passed;
+    currentTickTime = start + resolution * static_cast<std::int64_t>(tickNum);
+    auto jitter = std::max(std::chrono::nanoseconds{0},
+                           std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - currentTickTime));
+    ++stats_.ticks;
+    stats_.missedTicks += passed - 1;
+    stats_.minJitter = std::min(stats_.minJitter, jitter);
+    stats_.maxJitter = std::max(stats_.maxJitter, jitter);
+    stats_.sumJitter += jitter;
+    auto bucket = static_cast<unsigned>(std::bit_width(static_cast<std::uint64_t>(jitter.count())));
+    ++stats_.jitterLog2[std::min(bucket, 63u)];
+    return passed;
+  }
+
+  // end of the budget of the current tick
+  Clock::time_point budgetEnd() const {
+    return currentTickTime + budget;
+  }
+  bool budgetLeft() const {
+    return Clock::now() < budgetEnd();
+  }
+  // call when the work of the current tick had to be cut short
+  void recordBudgetOverrun() {
+    ++stats_.budgetOverruns;
+  }
+
+  std::chrono::nanoseconds tickResolution() const {
+    return resolution;
+  }
+  const Stats& stats() const {
+    return stats_;
+  }
+
+  void report(std::ostream& strm) const {
+    using std::chrono::nanoseconds;
+    strm << "ticks: " << stats_.ticks
+         << ", missed: " << stats_.missedTicks
+         << ", budget overruns: " << stats_.budgetOverruns << '\n'
+         << "jitter: min " << (stats_.ticks ? stats_.minJitter : nanoseconds{0}).count() << "ns"
+         << ", mean " << stats_.meanJitter().count() << "ns"
+         << ", p99 < " << stats_.jitterPercentile(0.99).count() << "ns"
+         << ", max " << stats_.maxJitter.count() << "ns\n";
+  }
+};
+
+#endif
@@ -0,0 +1,184 @@
+// hierarchical timing wheel for the scheduler demo
+//  - timers are intrusive (T derives from TimerNode), so there is no allocation
+//  - insert, cancel, and expiry are O(1); any number of timers per tick
+//  - level l has 64 slots of 64^l ticks each;
+//    a timer lives in the level of the highest 6-bit group in which its
+//    expiry differs from the current time, and cascades down
+//    when the current time reaches its slot
+//  - a bitmap of occupied slots per level lets advance() skip empty ticks
+// see: Varghese, Lauck: Hashed and Hierarchical Timing Wheels (1987)
+
+#ifndef INCLUDED_TIMING_WHEEL_HPP
+#define INCLUDED_TIMING_WHEEL_HPP
+
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+// hook for timers in a TimingWheel (circular doubly linked list)
+struct TimerNode {
+  TimerNode* prev = nullptr;
+  TimerNode* next = nullptr;
+  std::uint64_t expiry = 0;
+  std::uint16_t level = 0;   // position in the wheel (while linked)
+  std::uint16_t slot = 0;
+
+  bool isLinked() const noexcept {
+    return next != nullptr;
+  }
+  void unlink() noexcept {
+    prev->next = next;
+    next->prev = prev;
+    prev = next = nullptr;
+  }
+};
+
+template <typename T>
+class TimingWheel {
+ public:
+  static constexpr unsigned bitsPerLevel = 6;
+  static constexpr std::size_t slotsPerLevel = std::size_t{1} << bitsPerLevel;
+  static constexpr unsigned numLevels = (64 + bitsPerLevel - 1) / bitsPerLevel;  // all 64 bits
+
+ private:
+  // slot list heads (sentinels)
+  TimerNode slots[numLevels][slotsPerLevel];
+  std::uint64_t occupied[numLevels] = {};   // bit per non-empty slot
+  std::uint64_t now_ = 0;
+  std::size_t size_ = 0;
+
+  static void pushBack(TimerNode& head, TimerNode& node) noexcept {
+    node.prev = head.prev;
+    node.next = &head;
+    head.prev->next = &node;
+    head.prev = &node;
+  }
+
+  void link(TimerNode& node) noexcept {
+    std::uint64_t diff = node.expiry ^ now_;
+    unsigned level = diff == 0 ? 0 : static_cast<unsigned>(std::bit_width(diff) - 1) / bitsPerLevel;
+    std::size_t slot = (node.expiry >> (level * bitsPerLevel)) & (slotsPerLevel - 1);
+    node.level = static_cast<std::uint16_t>(level);
+    node.slot = static_cast<std::uint16_t>(slot);
+    pushBack(slots[level][slot], node);
+    occupied[level] |= std::uint64_t{1} << slot;
+  }
+
+  void unlink(TimerNode& node) noexcept {
+    TimerNode& head = slots[node.level][node.slot];
+    node.unlink();
+    if (head.next == &head) {
+      occupied[node.level] &= ~(std::uint64_t{1} << node.slot);
+    }
+  }
+
+  // next tick after now at which a slot has to be cascaded or expired
+  // (0 if the wheel is empty)
+  std::uint64_t nextEventTick() const noexcept {
+    std::uint64_t next = 0;
+    for (unsigned l = 0; l < numLevels; ++l) {
+      unsigned shift = l * bitsPerLevel;
+      std::uint64_t cur = (now_ >> shift) & (slotsPerLevel - 1);
+      // only slots after the current one can be occupied:
+      std::uint64_t later = cur + 1 < 64 ? occupied[l] & (~std::uint64_t{0} << (cur + 1)) : 0;
+      if (later != 0) {
+        std::uint64_t blockMask = shift + bitsPerLevel < 64
+                                    ? (std::uint64_t{1} << (shift + bitsPerLevel)) - 1
+                                    : ~std::uint64_t{0};
+        std::uint64_t tick = (now_ & ~blockMask)
+                             + (static_cast<std::uint64_t>(std::countr_zero(later)) << shift);
+        if (next == 0 || tick < next) {
+          next = tick;
+        }
+      }
+    }
+    return next;
+  }
+
+  // move all timers of the slot one or more levels down
+  void cascade(unsigned level, std::size_t slot) noexcept {
+    TimerNode& head = slots[level][slot];
+    TimerNode* n = head.next;
+    head.next = head.prev = &head;
+    occupied[level] &= ~(std::uint64_t{1} << slot);
+    while (n != &head) {
+      TimerNode* next = n->next;
+      link(*n);
+      n = next;
+    }
+  }
+
+ public:
+  explicit TimingWheel(std::uint64_t now = 0) noexcept
+   : now_{now} {
+    static_assert(std::is_base_of_v<TimerNode, T>, "T has to derive from TimerNode");
+    for (auto& level : slots) {
+      for (TimerNode& head : level) {
+        head.prev = head.next = &head;
+      }
+    }
+  }
+
+  TimingWheel(const TimingWheel&) = delete;
+  TimingWheel& operator=(const TimingWheel&) = delete;
+
+  std::uint64_t now() const noexcept {
+    return now_;
+  }
+  std::size_t size() const noexcept {
+    return size_;
+  }
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  // expire t at tick expiry (a tick not after now expires with the next tick)
+  void insert(T& t, std::uint64_t expiry) noexcept {
+    TimerNode& node = t;
+    node.expiry = expiry > now_ ? expiry : now_ + 1;
+    link(node);
+    ++size_;
+  }
+
+  // remove t if it is still waiting (returns false if it isn't)
+  bool cancel(T& t) noexcept {
+    TimerNode& node = t;
+    if (!node.isLinked()) {
+      return false;
+    }
+    unlink(node);
+    --size_;
+    return true;
+  }
+
+  // advance the current time to tick to and call onExpiry(T&)
+  // for each expired timer (timers of the same tick in insertion order)
+  template <typename FN>
+  void advance(std::uint64_t to, FN onExpiry) {
+    while (now_ < to) {
+      // skip ticks without anything to do:
+      std::uint64_t next = nextEventTick();
+      if (next == 0 || next > to) {
+        now_ = to;
+        break;
+      }
+      now_ = next;
+      // when entering a new slot of a higher level, cascade its timers
+      // (highest level first, as they may land in lower levels):
+      unsigned levels = static_cast<unsigned>(std::countr_zero(now_)) / bitsPerLevel;
+      for (unsigned l = levels < numLevels ? levels : numLevels - 1; l > 0; --l) {
+        cascade(l, (now_ >> (l * bitsPerLevel)) & (slotsPerLevel - 1));
+      }
+      TimerNode& head = slots[0][now_ & (slotsPerLevel - 1)];
+      while (head.next != &head) {
+        TimerNode* n = head.next;
+        unlink(*n);
+        --size_;
+        onExpiry(static_cast<T&>(*n));
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,108 @@
+// benchmark for the hierarchical timing wheel
+//  - inserts 1M timers with random expiries, cancels every 10th,
+//    and advances time until all others have expired
+//  - the same with std::multimap (the map keyed by wake time
+//    the scheduler demo used before can't even hold equal wake times)
+// usage: timingwheelbench [numTimers [maxTicks]]
+
+#include "timingwheel.hpp"
+#include <iostream>
+#include <map>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+struct Timer : TimerNode {
+  std::uint64_t id = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double nsPer(Clock::time_point start, std::size_t num)
+{
+  std::chrono::duration<double, std::nano> ns = Clock::now() - start;
+  return ns.count() / static_cast<double>(num);
+}
+
+int main(int argc, char* argv[])
+{
+  std::size_t numTimers = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+  std::uint64_t maxTicks = argc > 2 ? std::stoull(argv[2]) : 1'000'000;
+
+  std::mt19937_64 rng{42};
+  std::uniform_int_distribution<std::uint64_t> dist{1, maxTicks};
+  std::vector<std::uint64_t> expiries(numTimers);
+  for (auto& e : expiries) {
+    e = dist(rng);
+  }
+
+  // timing wheel:
+  {
+    std::vector<Timer> timers(numTimers);
+    TimingWheel<Timer> wheel;
+
+    auto start = Clock::now();
+    for (std::size_t i = 0; i < numTimers; ++i) {
+      timers[i].id = i;
+      wheel.insert(timers[i], expiries[i]);
+    }
+    double insertNs = nsPer(start, numTimers);
+
+    start = Clock::now();
+    std::size_t numCancelled = 0;
+    for (std::size_t i = 0; i < numTimers; i += 10) {
+      numCancelled += wheel.cancel(timers[i]);
+    }
+    double cancelNs = nsPer(start, numCancelled);
+
+    start = Clock::now();
+    std::uint64_t numExpired = 0, sum = 0;
+    wheel.advance(maxTicks, [&](Timer& t) {
+      ++numExpired;
+      sum += t.id;
+    });
+    double expireNs = nsPer(start, numExpired);
+
+    std::cout << "timing wheel:   insert " << insertNs << " ns, cancel " << cancelNs
+              << " ns, expire " << expireNs << " ns per timer ("
+              << numExpired << " expired, " << wheel.size() << " left)\n";
+  }
+
+  // std::multimap:
+  {
+    std::multimap<std::uint64_t, std::uint64_t> map;
+    std::vector<std::multimap<std::uint64_t, std::uint64_t>::iterator> handles(numTimers);
+
+    auto start = Clock::now();
+    for (std::size_t i = 0; i < numTimers; ++i) {
+      handles[i] = map.emplace(expiries[i], i);
+    }
+    double insertNs = nsPer(start, numTimers);
+
+    start = Clock::now();
+    std::size_t numCancelled = 0;
+    for (std::size_t i = 0; i < numTimers; i += 10) {
+      map.erase(handles[i]);
+      ++numCancelled;
+    }
+    double cancelNs = nsPer(start, numCancelled);
+
+    start = Clock::now();
+    std::uint64_t numExpired = 0, sum = 0;
+    for (std::uint64_t now = 1; now <= maxTicks; ++now) {
+      auto pos = map.begin();
+      while (pos != map.end() && pos->first <= now) {
+        ++numExpired;
+        sum += pos->second;
+        pos = map.erase(pos);
+      }
+    }
+    double expireNs = nsPer(start, numExpired);
+
+    std::cout << "std::multimap:  insert " << insertNs << " ns, cancel " << cancelNs
+              << " ns, expire " << expireNs << " ns per timer ("
+              << numExpired << " expired, " << map.size() << " left)\n";
+  }
+}
@@ -0,0 +1,93 @@
+// cost of tracing awaits with TracedAwaiter
+//  - each thread drives a coroutine that awaits in a loop
+//    (once plain, once wrapped into TracedAwaiter)
+//  - the trace of the last round is written to tracebench.bin
+//    (convert it with: traceexport tracebench.bin tracebench.json)
+// usage: tracebench [numThreads [numAwaits]]
+
+#include "tracedawaiter.hpp"
+#include <iostream>
+#include <fstream>
+#include <coroutine>
+#include <exception>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+
+// coroutine resumed by its caller until done
+class LoopTask {
+ public:
+  struct promise_type {
+    LoopTask get_return_object() noexcept {
+      return LoopTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+
+ private:
+  std::coroutine_handle<promise_type> hdl;
+  explicit LoopTask(std::coroutine_handle<promise_type> h) noexcept : hdl{h} {}
+
+ public:
+  LoopTask(LoopTask&& t) noexcept : hdl{std::exchange(t.hdl, {})} {}
+  ~LoopTask() {
+    if (hdl) hdl.destroy();
+  }
+  void run() {
+    while (!hdl.done()) {
+      hdl.resume();
+    }
+  }
+};
+
+LoopTask plainLoop(int numAwaits)
+{
+  for (int i = 0; i < numAwaits; ++i) {
+    co_await std::suspend_always{};
+  }
+}
+
+LoopTask tracedLoop(int numAwaits)
+{
+  for (int i = 0; i < numAwaits; ++i) {
+    co_await TracedAwaiter{"loop", std::suspend_always{}};
+  }
+}
+
+template <typename FN>
+double runThreads(int numThreads, int numAwaits, FN makeTask)
+{
+  auto start = std::chrono::steady_clock::now();
+  {
+    std::vector<std::jthread> threads;
+    for (int t = 0; t < numThreads; ++t) {
+      threads.emplace_back([&] {
+        makeTask(numAwaits).run();
+      });
+    }
+  }
+  std::chrono::duration<double, std::nano> ns = std::chrono::steady_clock::now() - start;
+  return ns.count() / numAwaits;
+}
+
+int main(int argc, char* argv[])
+{
+  int numThreads = argc > 1 ? std::stoi(argv[1]) : 4;
+  int numAwaits = argc > 2 ? std::stoi(argv[2]) : 10'000;
+
+  double plain = runThreads(numThreads, numAwaits, plainLoop);
+  double traced = runThreads(numThreads, numAwaits, tracedLoop);
+  std::cout << numThreads << " threads, " << numAwaits << " awaits each:\n"
+            << "  plain:  " << plain << " ns/await\n"
+            << "  traced: " << traced << " ns/await ("
+            << 3 * numThreads * 1000.0 / traced << " M events/s)\n";
+
+  std::ofstream out{"tracebench.bin", std::ios::binary};
+  TraceRecorder::writeTo(out);
+  std::cout << "trace written to tracebench.bin (" << TraceRecorder::dropped()
+            << " records dropped)\n";
+}
@@ -1,54 +1,60 @@
 // Based on Frank Birbacher:
 //  https://github.com/birbacher/isocpp-corotask/blob/main/src/traced.hpp
+// Instead of printing, each call is recorded as binary record
+// in lock-free chunks of the calling thread, which are queued per thread
+// and taken by TraceRecorder::collect() (see tracerecorder.hpp).
+// Use TraceRecorder::writeTo() to save the trace and traceexport
+// to convert it into Chrome trace JSON.
 
 #ifndef INCLUDED_TRACED_AWAITER_HPP
 #define INCLUDED_TRACED_AWAITER_HPP
 
-#include <iostream>
+#include "tracerecorder.hpp"
+#include <coroutine>
 #include <string_view>
+#include <cstdint>
+#include <utility>
 
 template <typename Awaiter>
 class TracedAwaiter {
   private:
-    const std::string_view name;
+    const std::uint32_t nameId;
+    void* coroAddress = nullptr;   // set by await_suspend()
   public:
     Awaiter wrappedAwaiter;
 
   private:
     template <typename FN>
     void dispatchSuspension(void*, FN fn) noexcept {
-        std::cout << "                       dispatchSuspension(): return void"
-                  << '\n';
         fn();
     }
 
     template <typename Handle, typename FN>
     Handle dispatchSuspension(Handle*, FN fn) noexcept {
-        Handle h = fn();
-        std::cout << "                       dispatchSuspension(): resume to "
-                  << h.address() << '\n';
-        return h;
+        return fn();
     }
 
     template <typename FN>
     bool dispatchSuspension(bool*, FN fn) {
         const bool result = fn();
-        std::cout << "                       dispatchSuspension(): resume conditionally: "
-                  << result << '\n';
+        if (!result) {
+            TraceRecorder::record(TraceEventKind::awaitSuspendDeclined, nameId, coroAddress);
+        }
         return result;
     }
 
   public:
-    template <std::size_t LEN_NAME>
-    TracedAwaiter(const char (&name)[LEN_NAME], Awaiter wrapped)
-        : name(name, LEN_NAME)
+    // name: string literal (a char array on the stack doesn't compile)
+    TracedAwaiter(TraceName name, Awaiter wrapped)
+        : nameId(TraceRecorder::nameId(name.str))
         , wrappedAwaiter(std::move(wrapped))
     {}
 
     auto await_ready() noexcept {
         auto result = wrappedAwaiter.await_ready();
-        std::cout << "            TRACE \"" << name
-                  << "\" await_ready, result " << result << '\n';
+        TraceRecorder::record(result ? TraceEventKind::awaitReadyTrue
+                                     : TraceEventKind::awaitReady,
+                              nameId, nullptr);
         return result;
     }
     auto await_suspend(auto arg) noexcept
@@ -56,17 +62,16 @@ class TracedAwaiter {
     {
         const auto action = [&] { return wrappedAwaiter.await_suspend(arg); };
         decltype(action()) *p = nullptr;
-        std::cout << "            TRACE \"" << name
-                  << "\" await_suspend, on " << arg.address()
-                  << ", " /*...details later*/
-                  << '\n';
+        coroAddress = arg.address();
+        // record before calling the wrapped awaiter:
+        // afterwards, the coroutine might already run (or be destroyed) elsewhere
+        TraceRecorder::record(TraceEventKind::awaitSuspend, nameId, coroAddress);
         return dispatchSuspension(p, action);
     }
     auto await_resume() noexcept
         //-> decltype(wrappedAwaiter.await_resume())
     {
-        std::cout << "            TRACE \"" << name
-                  << "\" await_resume\n";
+        TraceRecorder::record(TraceEventKind::awaitResume, nameId, coroAddress);
         return wrappedAwaiter.await_resume();
     }
 };
@@ -0,0 +1,115 @@
+// offline exporter for binary traces written by TraceRecorder::writeTo()
+//  - converts them into the Chrome trace event JSON format,
+//    which chrome://tracing and https://ui.perfetto.dev can open
+//  - suspensions become async slices (from await_suspend to await_resume,
+//    keyed by the coroutine address, as they may end on another thread)
+//  - await_ready and declined suspensions become instant events
+// usage: traceexport trace.bin [trace.json]
+
+#include "tracerecorder.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <set>
+#include <string>
+#include <string_view>
+#include <cstdio>
+
+std::string jsonEscape(std::string_view s)
+{
+  std::string result;
+  for (char c : s) {
+    switch (c) {
+      case '"':  result += "\\\""; break;
+      case '\\': result += "\\\\"; break;
+      case '\n': result += "\\n"; break;
+      case '\t': result += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+          result += buf;
+        }
+        else {
+          result += c;
+        }
+    }
+  }
+  return result;
+}
+
+void writeChromeTrace(const TraceFile& trace, std::ostream& out)
+{
+  std::vector<TraceRecord> records = trace.records;
+  std::stable_sort(records.begin(), records.end(),
+                   [](const TraceRecord& a, const TraceRecord& b) {
+                     return a.timestampNs < b.timestampNs;
+                   });
+  std::uint64_t start = records.empty() ? 0 : records.front().timestampNs;
+
+  auto nameOf = [&](std::uint32_t id) -> std::string {
+    auto pos = trace.names.find(id);
+    return jsonEscape(pos != trace.names.end() ? pos->second : "?");
+  };
+
+  out << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":" << trace.dropped << "},\n"
+      << "\"traceEvents\":[\n";
+  const char* sep = "";
+  std::set<std::uint16_t> threads;
+  for (const TraceRecord& r : records) {
+    threads.insert(r.threadIndex);
+    out << sep << "{\"name\":\"" << nameOf(r.nameId) << "\",\"cat\":\"await\""
+        << ",\"pid\":1,\"tid\":" << r.threadIndex
+        << ",\"ts\":" << static_cast<double>(r.timestampNs - start) / 1000.0;
+    switch (r.kind) {
+      case TraceEventKind::awaitSuspend:
+        out << ",\"ph\":\"b\",\"id\":\"0x" << std::hex << r.coroAddress << std::dec << "\"";
+        break;
+      case TraceEventKind::awaitResume:
+        out << ",\"ph\":\"e\",\"id\":\"0x" << std::hex << r.coroAddress << std::dec << "\"";
+        break;
+      case TraceEventKind::awaitReady:
+        out << ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"await_ready\":false}";
+        break;
+      case TraceEventKind::awaitReadyTrue:
+        out << ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"await_ready\":true}";
+        break;
+      case TraceEventKind::awaitSuspendDeclined:
+        out << ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"await_suspend\":false}";
+        break;
+    }
+    out << "}";
+    sep = ",\n";
+  }
+  for (std::uint16_t t : threads) {
+    out << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+        << ",\"args\":{\"name\":\"thread " << t << "\"}}";
+    sep = ",\n";
+  }
+  out << "\n]}\n";
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " trace.bin [trace.json]\n";
+    return 2;
+  }
+
+  std::ifstream in{argv[1], std::ios::binary};
+  TraceFile trace;
+  if (!in || !trace.readFrom(in)) {
+    std::cerr << argv[1] << ": no valid trace file\n";
+    return 1;
+  }
+
+  if (argc > 2) {
+    std::ofstream out{argv[2]};
+    writeChromeTrace(trace, out);
+  }
+  else {
+    writeChromeTrace(trace, std::cout);
+  }
+  std::cerr << trace.records.size() << " records exported ("
+            << trace.dropped << " dropped while recording)\n";
+}
@@ -0,0 +1,337 @@
+// Lock-free binary trace recorder for TracedAwaiter
+//  - each thread writes fixed-size records into chunks of its own
+//    (single producer/single consumer, no locks, no formatting, no I/O)
+//  - when a chunk is full, the thread appends a new chunk and continues there,
+//    so records are only dropped (and counted) if a thread has
+//    maxChunksPerThread chunks not collected yet
+//  - TraceRecorder::collect() takes the records of all threads
+//    (and frees the chunks of threads that ended once they are collected);
+//    TraceRecorder::writeTo() collects them into a binary trace file,
+//    which traceexport converts to Chrome trace JSON (also read by Perfetto)
+
+#ifndef INCLUDED_TRACE_RECORDER_HPP
+#define INCLUDED_TRACE_RECORDER_HPP
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <ostream>
+#include <istream>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+enum class TraceEventKind : std::uint16_t {
+  awaitReady,           // await_ready() returned false
+  awaitReadyTrue,       // await_ready() returned true (no suspension)
+  awaitSuspend,         // coroutine suspended
+  awaitSuspendDeclined, // await_suspend() returned false (resumed immediately)
+  awaitResume,          // coroutine resumed
+};
+
+struct TraceRecord {
+  std::uint64_t timestampNs;   // steady_clock
+  std::uint64_t coroAddress;   // 0 if unknown (await_ready() has no handle)
+  std::uint32_t nameId;        // see TraceRecorder::nameId()
+  TraceEventKind kind;
+  std::uint16_t threadIndex;
+};
+static_assert(sizeof(TraceRecord) == 24);
+
+// binary trace file:
+//  - "CTRC0001"
+//  - uint64 number of dropped records
+//  - uint32 number of names, for each: uint32 id, uint32 length, characters
+//  - uint64 number of records, followed by the raw records
+inline constexpr char traceFileMagic[8] = {'C', 'T', 'R', 'C', '0', '0', '0', '1'};
+
+// name of traced awaits: only string literals (and other constants),
+// whose characters never change (checked at compile time)
+struct TraceName {
+  std::string_view str;
+
+  template <std::size_t LEN>
+  consteval TraceName(const char (&name)[LEN]) : str{name, LEN - 1} {
+  }
+};
+
+class TraceRecorder {
+ public:
+  static constexpr std::size_t chunkCapacity = 1 << 12;        // records per chunk
+  static constexpr std::size_t maxChunksPerThread = 1 << 10;   // not collected yet (96 MB)
+
+ private:
+  struct Chunk {
+    TraceRecord records[chunkCapacity];
+    std::atomic<std::size_t> size{0};         // written by the owning thread
+    std::atomic<Chunk*> successor{nullptr};   // set by the owning thread when full
+    std::size_t taken = 0;                    // records collected so far
+  };
+
+  // queue of chunks: the owning thread appends, the collector frees collected chunks
+  struct ThreadBuffer {
+    Chunk* current;                               // used by the owning thread
+    Chunk* oldest;                                // used by the collector
+    std::atomic<std::size_t> numChunks{1};        // allocated and not freed by the collector
+    std::atomic<std::uint64_t> dropped{0};        // written by the owning thread
+    std::atomic<bool> exited{false};              // owning thread ended
+    std::uint16_t threadIndex;
+
+    explicit ThreadBuffer(std::uint16_t idx)
+     : current{new Chunk}, oldest{current}, threadIndex{idx} {
+    }
+
+    ThreadBuffer(const ThreadBuffer&) = delete;
+    ThreadBuffer& operator=(const ThreadBuffer&) = delete;
+
+    ~ThreadBuffer() {
+      while (oldest != nullptr) {
+        delete std::exchange(oldest, oldest->successor.load(std::memory_order_relaxed));
+      }
+    }
+
+    void push(const TraceRecord& rec) noexcept {
+      std::size_t n = current->size.load(std::memory_order_relaxed);
+      if (n == chunkCapacity) {
+        if (!spill()) {
+          dropped.store(dropped.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+          return;
+        }
+        n = 0;
+      }
+      current->records[n] = rec;
+      current->size.store(n + 1, std::memory_order_release);
+    }
+
+    // continue with a new chunk after the full current one
+    // (false if there are too many chunks or no memory)
+    bool spill() noexcept {
+      if (numChunks.load(std::memory_order_relaxed) >= maxChunksPerThread) {
+        return false;
+      }
+      Chunk* fresh = new (std::nothrow) Chunk;
+      if (fresh == nullptr) {
+        return false;
+      }
+      numChunks.fetch_add(1, std::memory_order_relaxed);
+      current->successor.store(fresh, std::memory_order_release);   // (owner is done with it)
+      current = fresh;
+      return true;
+    }
+
+    // move the records not collected yet into out (one collector at a time)
+    // and free the chunks the owning thread is done with
+    void drain(std::vector<TraceRecord>& out) {
+      while (true) {
+        std::size_t end = oldest->size.load(std::memory_order_acquire);
+        out.insert(out.end(), oldest->records + oldest->taken, oldest->records + end);
+        oldest->taken = end;
+        Chunk* next = oldest->successor.load(std::memory_order_acquire);
+        if (next == nullptr) {
+          return;
+        }
+        if (end == chunkCapacity) {   // (else: read the rest first)
+          delete std::exchange(oldest, next);
+          numChunks.fetch_sub(1, std::memory_order_relaxed);
+        }
+      }
+    }
+  };
+
+  struct Registry {
+    std::mutex mx;   // guards registration, names, and collecting
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;  // freed after threads end
+    std::uint16_t nextThreadIndex = 0;
+    std::uint64_t droppedOfFreed = 0;                    // by threads whose buffer is freed
+    std::unordered_map<std::string, std::uint32_t> names;
+  };
+
+  static Registry& registry() {
+    static Registry reg;
+    return reg;
+  }
+
+  // buffer of the calling thread (nullptr: not registered yet or thread ends)
+  // - trivially destructible, so it can be read in thread_local destructors
+  static inline thread_local ThreadBuffer* boundBuffer = nullptr;
+  static inline thread_local bool threadEnds = false;
+
+  // marks the buffer of a thread as exited when the thread ends
+  struct Binding {
+    ThreadBuffer* buffer;
+    Binding() {
+      Registry& reg = registry();
+      std::lock_guard lock{reg.mx};
+      reg.buffers.push_back(std::make_unique<ThreadBuffer>(reg.nextThreadIndex++));
+      buffer = reg.buffers.back().get();
+      boundBuffer = buffer;
+    }
+    ~Binding() {
+      boundBuffer = nullptr;
+      threadEnds = true;
+      buffer->exited.store(true, std::memory_order_release);
+    }
+  };
+
+  // buffer of the calling thread (nullptr while the thread ends)
+  static ThreadBuffer* localBuffer() {
+    ThreadBuffer* buf = boundBuffer;
+    if (buf == nullptr && !threadEnds) {
+      thread_local Binding binding;
+      buf = binding.buffer;
+    }
+    return buf;
+  }
+
+  static std::uint64_t now() noexcept {
+    auto d = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+  }
+
+  // key of the nameId() cache (a prefix of a name has the same address)
+  struct NameKey {
+    const char* data;
+    std::size_t size;
+    bool operator== (const NameKey&) const = default;
+  };
+  struct NameKeyHash {
+    std::size_t operator() (const NameKey& k) const noexcept {
+      return std::hash<const char*>{}(k.data) ^ (std::hash<std::size_t>{}(k.size) << 1);
+    }
+  };
+
+ public:
+  // id for a name (same string => same id)
+  // - the name must not change while its characters are in use
+  //   (e.g. a string literal, see TraceName), because a thread-local cache
+  //   keyed by address and length makes the lookup cheap after the first use
+  static std::uint32_t nameId(std::string_view name) {
+    thread_local std::unordered_map<NameKey, std::uint32_t, NameKeyHash> cache;
+    NameKey key{name.data(), name.size()};
+    if (auto pos = cache.find(key); pos != cache.end()) {
+      return pos->second;
+    }
+    Registry& reg = registry();
+    std::lock_guard lock{reg.mx};
+    auto [pos, isNew] = reg.names.try_emplace(std::string{name},
+                                              static_cast<std::uint32_t>(reg.names.size()));
+    cache.emplace(key, pos->second);
+    return pos->second;
+  }
+
+  static void record(TraceEventKind kind, std::uint32_t nameId, void* coroAddress) noexcept {
+    ThreadBuffer* buf = localBuffer();
+    if (buf == nullptr) {
+      return;   // (thread ends)
+    }
+    buf->push(TraceRecord{now(),
+                          reinterpret_cast<std::uint64_t>(coroAddress),
+                          nameId, kind, buf->threadIndex});
+  }
+
+  // move all records recorded so far into out
+  // (the buffers of threads that ended are freed afterwards)
+  static void collect(std::vector<TraceRecord>& out) {
+    Registry& reg = registry();
+    std::lock_guard lock{reg.mx};
+    std::erase_if(reg.buffers, [&](std::unique_ptr<ThreadBuffer>& b) {
+      bool exited = b->exited.load(std::memory_order_acquire);
+      b->drain(out);
+      if (!exited) {
+        return false;
+      }
+      reg.droppedOfFreed += b->dropped.load(std::memory_order_relaxed);
+      return true;
+    });
+  }
+
+  static std::uint64_t dropped() {
+    Registry& reg = registry();
+    std::lock_guard lock{reg.mx};
+    std::uint64_t sum = reg.droppedOfFreed;
+    for (auto& b : reg.buffers) {
+      sum += b->dropped.load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+  // collect all records and write them as binary trace file
+  static void writeTo(std::ostream& strm) {
+    std::vector<TraceRecord> records;
+    collect(records);
+    std::uint64_t numDropped = dropped();
+
+    Registry& reg = registry();
+    std::lock_guard lock{reg.mx};
+    strm.write(traceFileMagic, sizeof(traceFileMagic));
+    writeRaw(strm, numDropped);
+    writeRaw(strm, static_cast<std::uint32_t>(reg.names.size()));
+    for (const auto& [name, id] : reg.names) {
+      writeRaw(strm, id);
+      writeRaw(strm, static_cast<std::uint32_t>(name.size()));
+      strm.write(name.data(), static_cast<std::streamsize>(name.size()));
+    }
+    writeRaw(strm, static_cast<std::uint64_t>(records.size()));
+    strm.write(reinterpret_cast<const char*>(records.data()),
+               static_cast<std::streamsize>(records.size() * sizeof(TraceRecord)));
+  }
+
+ private:
+  template <typename T>
+  static void writeRaw(std::ostream& strm, T value) {
+    strm.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+};
+
+// contents of a binary trace file
+struct TraceFile {
+  std::uint64_t dropped = 0;
+  std::unordered_map<std::uint32_t, std::string> names;
+  std::vector<TraceRecord> records;
+
+  // returns false if strm doesn't contain a valid trace
+  bool readFrom(std::istream& strm) {
+    char magic[sizeof(traceFileMagic)];
+    if (!strm.read(magic, sizeof(magic))
+        || std::memcmp(magic, traceFileMagic, sizeof(magic)) != 0) {
+      return false;
+    }
+    std::uint32_t numNames = 0;
+    if (!readRaw(strm, dropped) || !readRaw(strm, numNames)) {
+      return false;
+    }
+    for (std::uint32_t i = 0; i < numNames; ++i) {
+      std::uint32_t id = 0, len = 0;
+      if (!readRaw(strm, id) || !readRaw(strm, len)) {
+        return false;
+      }
+      std::string name(len, '\0');
+      if (!strm.read(name.data(), len)) {
+        return false;
+      }
+      names.emplace(id, std::move(name));
+    }
+    std::uint64_t numRecords = 0;
+    if (!readRaw(strm, numRecords)) {
+      return false;
+    }
+    records.resize(numRecords);
+    return static_cast<bool>(strm.read(reinterpret_cast<char*>(records.data()),
+                                       static_cast<std::streamsize>(numRecords * sizeof(TraceRecord))));
+  }
+
+ private:
+  template <typename T>
+  static bool readRaw(std::istream& strm, T& value) {
+    return static_cast<bool>(strm.read(reinterpret_cast<char*>(&value), sizeof(value)));
+  }
+};
+
+#endif